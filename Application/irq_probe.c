@@ -0,0 +1,67 @@
+#include "irq_probe.h"
+
+#include "freertos.h"
+#include "gd32f4xx.h"
+#include "task.h"
+
+static volatile uint32_t probe_count;
+static volatile uint32_t probe_min = UINT32_MAX;
+static volatile uint32_t probe_max;
+static volatile uint64_t probe_sum;
+static uint32_t probe_scale;    // core cycles per timer tick
+
+void irq_probe_start(void) {
+    timer_parameter_struct init;
+    uint32_t clk = rcu_clock_freq_get(CK_APB2);
+
+    // APB2 分频不为 1 时定时器时钟为 APB2 的两倍
+    if (clk != rcu_clock_freq_get(CK_AHB)) {
+        clk *= 2;
+    }
+    probe_scale = SystemCoreClock / clk;
+
+    rcu_periph_clock_enable(RCU_TIMER9);
+    timer_deinit(TIMER9);
+    timer_struct_para_init(&init);
+    init.prescaler = 0;
+    init.alignedmode = TIMER_COUNTER_EDGE;
+    init.counterdirection = TIMER_COUNTER_UP;
+    init.period = IRQ_PROBE_PERIOD - 1;
+    init.clockdivision = TIMER_CKDIV_DIV1;
+    timer_init(TIMER9, &init);
+
+    timer_interrupt_flag_clear(TIMER9, TIMER_INT_FLAG_UP);
+    timer_interrupt_enable(TIMER9, TIMER_INT_UP);
+    nvic_irq_enable(TIMER0_UP_TIMER9_IRQn, IRQ_PROBE_PRIORITY, 0);
+    timer_enable(TIMER9);
+}
+
+void TIMER0_UP_TIMER9_IRQHandler(void) {
+    // 计数器在更新事件时归零, 此刻的计数值就是进入中断的延迟
+    uint32_t cycles = timer_counter_read(TIMER9) * probe_scale;
+
+    timer_interrupt_flag_clear(TIMER9, TIMER_INT_FLAG_UP);
+    probe_count++;
+    probe_sum += cycles;
+    if (cycles < probe_min) {
+        probe_min = cycles;
+    }
+    if (cycles > probe_max) {
+        probe_max = cycles;
+    }
+}
+
+void irq_probe_get_stats(irq_probe_stats_t *stats, int reset) {
+    taskENTER_CRITICAL();
+    stats->count = probe_count;
+    stats->min = probe_count ? probe_min : 0;
+    stats->avg = probe_count ? (uint32_t)(probe_sum / probe_count) : 0;
+    stats->max = probe_max;
+    if (reset) {
+        probe_count = 0;
+        probe_min = UINT32_MAX;
+        probe_max = 0;
+        probe_sum = 0;
+    }
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,25 @@
+#ifndef IRQ_PROBE_H
+#define IRQ_PROBE_H
+
+#include <stdint.h>
+
+#define IRQ_PROBE_PRIORITY 5        // = configMAX_SYSCALL_INTERRUPT_PRIORITY: held off only by critical sections
+#define IRQ_PROBE_PERIOD   50000    // timer ticks between samples, not a divisor of the 1 ms RTOS tick
+
+typedef struct {
+    uint32_t count;    // samples taken
+    uint32_t min;      // core cycles from the timer update event to the counter read in the ISR
+    uint32_t avg;
+    uint32_t max;      // worst case seen, the figure to compare before/after a change
+} irq_probe_stats_t;
+
+/* Start TIMER9 as an interrupt latency probe: on every update event the ISR
+ * reads how far the counter has run since the event. min is the hardware
+ * entry cost; anything above it is time the interrupt was held off by
+ * critical sections or higher priority ISRs. Delays longer than the period
+ * (about 208 us at 240 MHz) wrap and are not caught. */
+void irq_probe_start(void);
+
+void irq_probe_get_stats(irq_probe_stats_t *stats, int reset);
+
+#endif /* IRQ_PROBE_H */
@@ -0,0 +1,169 @@
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "gd32f4xx.h"
+#include "task.h"
+#include "uwb_telemetry.h"
+
+#define LOG_RING_MASK    (LOG_RING_LEN - 1)
+#define LOG_STACK_WORDS  256
+#define LOG_IDLE_PERIOD  pdMS_TO_TICKS(10)
+
+#if (LOG_RING_LEN & LOG_RING_MASK) != 0
+#error "LOG_RING_LEN must be a power of two"
+#endif
+
+typedef struct {
+    volatile uint32_t seq;    // slot state, see log_record()
+    uint32_t stamp;
+    const char *fmt;
+    uint32_t args[LOG_ARGS_MAX];
+} log_slot_t;
+
+/* Bounded ring, many producers (tasks and interrupts) and one consumer (the
+ * LogTask). Slot n starts with seq == n. A producer claims position pos with
+ * LDREX/STREX on log_head when seq == pos, fills it and publishes it with
+ * seq = pos + 1. The consumer reads it once seq == pos + 1 and frees it for the
+ * next lap with seq = pos + LOG_RING_LEN. No lock and no interrupt masking. */
+static log_slot_t log_ring[LOG_RING_LEN];
+static volatile uint32_t log_head;
+static uint32_t log_tail;
+static volatile uint32_t log_dropped;
+static uint32_t log_emitted;
+
+void log_record(uint32_t nargs, const char *fmt, ...) {
+    log_slot_t *slot;
+    uint32_t pos;
+    uint32_t d;
+    va_list ap;
+
+    for (;;) {
+        pos = __LDREXW(&log_head);
+        slot = &log_ring[pos & LOG_RING_MASK];
+        if (slot->seq == pos) {
+            if (__STREXW(pos + 1, &log_head) == 0) {
+                break;
+            }
+            continue;
+        }
+        __CLREX();
+        if ((int32_t)(slot->seq - pos) > 0) {
+            continue;    // claimed by an interrupting producer, retry
+        }
+        // ring full, the consumer has not freed this slot yet
+        do {
+            d = __LDREXW(&log_dropped);
+        } while (__STREXW(d + 1, &log_dropped) != 0);
+        return;
+    }
+
+    slot->stamp = DWT->CYCCNT;
+    slot->fmt = fmt;
+    va_start(ap, fmt);
+    for (uint32_t i = 0; i < nargs && i < LOG_ARGS_MAX; i++) {
+        slot->args[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    __DMB();
+    slot->seq = pos + 1;
+}
+
+static uint16_t log_format(const log_slot_t *slot, char *buf, uint16_t size) {
+    int n = snprintf(buf, size, slot->fmt, slot->args[0], slot->args[1],
+                     slot->args[2], slot->args[3]);
+
+    if (n < 0) {
+        return 0;
+    }
+    return (n < size) ? (uint16_t)n : (uint16_t)(size - 1);
+}
+
+/* Take the oldest published record, returns 0 if there is none. */
+static int log_take(log_slot_t *out) {
+    log_slot_t *slot = &log_ring[log_tail & LOG_RING_MASK];
+
+    if (slot->seq != log_tail + 1) {
+        return 0;
+    }
+    __DMB();
+    *out = *slot;
+    __DMB();
+    slot->seq = log_tail + LOG_RING_LEN;
+    log_tail++;
+    return 1;
+}
+
+static void log_task(void *pvParameters) {
+    static char line[UWB_TLM_LOG_MAX + 1];
+    log_slot_t rec;
+    uint16_t len;
+
+    (void)pvParameters;
+
+    while (1) {
+        while (log_take(&rec)) {
+            len = log_format(&rec, line, sizeof(line));
+            uwb_telemetry_send_log(rec.stamp, line, len);
+            log_emitted++;
+        }
+        // polling keeps log_record() free of any kernel call
+        vTaskDelay(LOG_IDLE_PERIOD);
+    }
+}
+
+int log_start(UBaseType_t priority) {
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    for (uint32_t i = 0; i < LOG_RING_LEN; i++) {
+        log_ring[i].seq = i;
+    }
+    if (xTaskCreate(log_task, "LogTask", LOG_STACK_WORDS, NULL, priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+void log_get_stats(log_stats_t *stats) {
+    stats->records = log_emitted;
+    stats->dropped = log_dropped;
+}
+
+static void log_poll_write(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        usart_data_transmit(UART3, data[i]);
+        while (RESET == usart_flag_get(UART3, USART_FLAG_TBE));
+    }
+}
+
+void vAssertCalled(const char *file, int line) {
+    static uint8_t record[UART_TX_STAGE_SIZE];
+    static char text[UWB_TLM_LOG_MAX + 1];
+    log_slot_t rec;
+    uint16_t len;
+
+    taskDISABLE_INTERRUPTS();
+
+    // 等待正在进行的 DMA 发送结束, 之后改为查询发送
+    while (DMA_CHCTL(DMA0, DMA_CH4) & DMA_CHXCTL_CHEN);
+
+    while (log_take(&rec)) {
+        len = log_format(&rec, text, sizeof(text));
+        log_poll_write(record,
+                       uwb_telemetry_build_log(record, rec.stamp, text, len));
+    }
+    len = (uint16_t)snprintf(text, sizeof(text), "OS Error:%s,%d", file, line);
+    if (len >= sizeof(text)) {
+        len = sizeof(text) - 1;
+    }
+    log_poll_write(record,
+                   uwb_telemetry_build_log(record, DWT->CYCCNT, text, len));
+
+    for (;;)
+        ;
+}
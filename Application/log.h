@@ -0,0 +1,39 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+
+#define LOG_RING_LEN  64     // records, must be a power of two
+#define LOG_ARGS_MAX  4
+
+typedef struct {
+    uint32_t records;    // records emitted
+    uint32_t dropped;    // records lost because the ring was full
+} log_stats_t;
+
+/* Deferred logging. LOG() only stores the format pointer, up to four 32-bit
+ * arguments and the core cycle count; the LogTask formats and emits them later
+ * as telemetry records. Usable from tasks and interrupts, never blocks.
+ *
+ * Because formatting happens later, the format must be a string literal and
+ * every argument must be an integer, a pointer, or a pointer to a string that
+ * stays valid (a literal). Floating point arguments are not supported. */
+#define LOG(...) log_record(LOG_NARGS(__VA_ARGS__), __VA_ARGS__)
+
+#define LOG_NARGS(...)                        LOG_NARGS_(__VA_ARGS__, 4, 3, 2, 1, 0, 0)
+#define LOG_NARGS_(fmt, _1, _2, _3, _4, N, ...) N
+
+void log_record(uint32_t nargs, const char *fmt, ...);
+
+/* Start the emitter task; uwb_telemetry_init() must have run first. */
+int log_start(UBaseType_t priority);
+
+void log_get_stats(log_stats_t *stats);
+
+/* Fatal assertion handler used by configASSERT(). Emits pending records and
+ * the failing location by polling UART3, then halts. */
+void vAssertCalled(const char *file, int line);
+
+#endif /* LOG_H */
@@ -1,11 +1,31 @@
 #include <stdint.h>
-#include <stdio.h>
 
 #include "deca_device_api.h"
 #include "deca_regs.h"
+#include "deca_spi.h"
 #include "freertos.h"
+#include "deca_irq.h"
 #include "gd32f4xx.h"
+#include "irq_probe.h"
+#include "log.h"
 #include "task.h"
+#include "uart_tx.h"
+#include "uwb_rx.h"
+#include "uwb_tdoa.h"
+#include "uwb_telemetry.h"
+
+/* 1: run as a TDoA anchor, batching tag blinks (uwb_tdoa.h); 0: report every
+ * received frame. */
+#define APP_TDOA_ANCHOR 0
+
+/* 1: time dwt_read32bitreg() at both SPI rates during start up and log the
+ * results (spibench() in deca_spi.h). */
+#define APP_SPI_BENCH 0
+#define APP_SPI_BENCH_READS 1000
+
+/* 1: sample the interrupt latency of an unrelated ISR (irq_probe.h) and log
+ * it with the decamutexon() critical section counters once a second. */
+#define APP_IRQ_PROBE 0
 
 static dwt_config_t config = {
     5,               /* Channel number. */
@@ -21,21 +41,10 @@ static dwt_config_t config = {
                         size). Used in RX only. */
 };
 
-/* Buffer to store received frame. See NOTE 1 below. */
-#define FRAME_LEN_MAX 127
-static uint8_t rx_buffer[FRAME_LEN_MAX];
-
-/* Hold copy of status register state here for reference so that it can be
- * examined at a debug breakpoint. */
-static uint32_t status_reg = 0;
-
 /* Hold copy of frame length of frame received (if good) so that it can be
  * examined at a debug breakpoint. */
 static uint16_t frame_len = 0;
 
-/* Buffer to store received frame. See NOTE 1 below. */
-#define FRAME_LEN_MAX 127
-
 void uart3_init() {
     rcu_periph_clock_enable(RCU_GPIOA);
     rcu_periph_clock_enable(RCU_UART3);
@@ -93,6 +102,7 @@ void spi3_init() {
 
     spi_nss_output_disable(SPI3);
     spi_enable(SPI3);
+    spisetrate(SPI_PSC_128);
 }
 
 void port_set_dw1000_fastrate_spi3(void) {
@@ -110,6 +120,7 @@ void port_set_dw1000_fastrate_spi3(void) {
     spi_init(SPI3, &spi_init_struct);
 
     spi_enable(SPI3);
+    spisetrate(SPI_PSC_32);
 }
 
 void reset_DW1000(void) {
@@ -118,6 +129,38 @@ void reset_DW1000(void) {
     gpio_bit_set(GPIOE, GPIO_PIN_3);
 }
 
+#if APP_SPI_BENCH
+static void app_spi_bench(const char *rate) {
+    deca_spi_bench_t now;
+    deca_spi_bench_t before;
+
+    spibench(APP_SPI_BENCH_READS, &now, &before);
+    LOG("spi %s cs setup %u: read32 min %u avg %u", rate, now.setup, now.min,
+        now.avg);
+    LOG("spi %s cs loop %u: read32 min %u avg %u", rate, before.setup,
+        before.min, before.avg);
+    LOG("spi %s max %u / %u", rate, now.max, before.max);
+}
+#endif
+
+#if APP_IRQ_PROBE
+static void IrqProbe_Task(void *pvParameters) {
+    irq_probe_stats_t lat;
+    deca_mutex_stats_t mutex;
+
+    irq_probe_start();
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        irq_probe_get_stats(&lat, 1);
+        decamutexgetstats(&mutex, 1);
+        LOG("irq latency min %u avg %u max %u, %u samples", lat.min, lat.avg,
+            lat.max, lat.count);
+        LOG("decamutexon critical %u max %u", mutex.critical_count,
+            mutex.critical_max);
+    }
+}
+#endif
+
 static void Slave_Task(void *pvParameters) {
     // init running led
     rcu_periph_clock_enable(RCU_GPIOC);
@@ -128,63 +171,57 @@ static void Slave_Task(void *pvParameters) {
 
     // init uart3
     uart3_init();
+    uart_tx_init();
+    uwb_telemetry_init();
+    log_start(1);
+#if APP_IRQ_PROBE
+    xTaskCreate(IrqProbe_Task, "IrqProbe", 256, NULL, 1, NULL);
+#endif
 
     spi3_init();
+    openspi();
     reset_DW1000();
 
     if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR) {
-        printf("dw1000 init failed");
-        while (1) {
-        };
+        // fatal: the assertion polls the pending records out as framed
+        // telemetry before halting
+        LOG("dw1000 init failed");
+        configASSERT(0);
     }
+#if APP_SPI_BENCH
+    app_spi_bench("psc128");
+#endif
     port_set_dw1000_fastrate_spi3();
+#if APP_SPI_BENCH
+    app_spi_bench("psc32");
+#endif
 
     /* Configure DW1000. See NOTE 7 below. */
     dwt_configure(&config);
-    int i;
 
+    /* Reception is driven by the DW1000 IRQ from here on. */
+    if (uwb_rx_start(configMAX_PRIORITIES - 2) != 0) {
+        LOG("uwb rx start failed");
+        configASSERT(0);
+    }
+
+#if APP_TDOA_ANCHOR
+    uwb_tdoa_anchor_run();
+#endif
+
+    /* From here on this task only reports frames. It runs below the UwbRx
+     * engine, which re-arms the receiver as soon as each frame is read, so a
+     * slow UART never keeps the radio off. */
     while (1) {
-        for (i = 0; i < FRAME_LEN_MAX; i++) {
-            rx_buffer[i] = 0;
-        }
+        uwb_frame_t *rx_frame = uwb_rx_receive(portMAX_DELAY);
 
-        /* Activate reception immediately. See NOTE 3 below. */
-        dwt_rxenable(DWT_START_RX_IMMEDIATE);
-
-        while (!((status_reg = dwt_read32bitreg(SYS_STATUS_ID)) &
-                 (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_ERR))) {
-        };
-
-        if (status_reg & SYS_STATUS_RXFCG) {
-            /* A frame has been received, copy it to our local buffer. */
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023;
-            printf("recv len: %d\n", frame_len);
-
-            if (frame_len <= FRAME_LEN_MAX) {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-            }
-
-            /* Clear good RX frame event in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG);
-
-            for (i = 0; i < frame_len; i++) {
-                // printf("%x", rx_buffer[i]);
-                usart_data_transmit(UART3, rx_buffer[i]);
-                while (usart_flag_get(UART3, USART_FLAG_TBE) == RESET);
-            }
-        } else if (status_reg & SYS_STATUS_ALL_RX_TO) {
-            printf("timeout");
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO);
-            dwt_rxreset();
-        } else if (status_reg & SYS_STATUS_ALL_RX_ERR) {
-            printf("error");
-            dwt_write32bitreg(SYS_STATUS_ID,
-                              SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
-            dwt_rxreset();
+        if (rx_frame == NULL) {
+            continue;
         }
+        frame_len = rx_frame->length;
+        uwb_telemetry_send_frame(rx_frame);
 
         gpio_bit_toggle(GPIOC, GPIO_PIN_13);
-        vTaskDelay(pdMS_TO_TICKS(300));
     }
 }
 
@@ -200,10 +237,3 @@ int main(void) {
     };
     return 0;
 }
-
-/* retarget the C library printf function to the USART */
-int fputc(int ch, FILE *f) {
-    usart_data_transmit(UART3, (uint8_t)ch);
-    while (RESET == usart_flag_get(UART3, USART_FLAG_TBE));
-    return ch;
-}
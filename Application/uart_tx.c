@@ -0,0 +1,301 @@
+#include "uart_tx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos.h"
+#include "gd32f4xx.h"
+#include "task.h"
+
+// UART3_TX 请求映射: DMA0 CH4 (子外设 4)
+#define UART_TX_DMA      DMA0
+#define UART_TX_DMA_CH   DMA_CH4
+#define UART_TX_DMA_IRQn DMA0_Channel4_IRQn
+#define UART_TX_SEG_MASK (UART_TX_SEG_MAX - 1)
+
+#if (UART_TX_SEG_MAX & UART_TX_SEG_MASK) != 0
+#error "UART_TX_SEG_MAX must be a power of two"
+#endif
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+    int8_t stage;    // staging buffer index, -1 for zero-copy segments
+    uart_tx_done_t done;
+    void *arg;
+} uart_tx_seg_t;
+
+static uint8_t uart_tx_stage[2][UART_TX_STAGE_SIZE];
+static uint8_t uart_tx_stage_busy[2];    // a queued segment points into it
+static uint8_t uart_tx_fill;             // buffer new bytes are appended to
+
+static uart_tx_seg_t uart_tx_seg[UART_TX_SEG_MAX];
+static uint32_t uart_tx_head;    // next free entry
+static uint32_t uart_tx_tail;    // oldest entry, in flight when active
+static uint8_t uart_tx_active;
+static uint8_t uart_tx_ready;
+
+static uart_tx_stats_t uart_tx_stats;
+
+// 调用者需在临界区或 DMA 中断中
+static void uart_tx_kick(void) {
+    uart_tx_seg_t *seg;
+
+    if (uart_tx_active || uart_tx_head == uart_tx_tail) {
+        return;
+    }
+    seg = &uart_tx_seg[uart_tx_tail & UART_TX_SEG_MASK];
+    uart_tx_active = 1;
+    uart_tx_stats.bytes += seg->len;
+
+    dma_flag_clear(UART_TX_DMA, UART_TX_DMA_CH, DMA_FLAG_FTF);
+    dma_memory_address_config(UART_TX_DMA, UART_TX_DMA_CH, DMA_MEMORY_0,
+                              (uint32_t)seg->data);
+    dma_transfer_number_config(UART_TX_DMA, UART_TX_DMA_CH, seg->len);
+    dma_channel_enable(UART_TX_DMA, UART_TX_DMA_CH);
+}
+
+void uart_tx_init(void) {
+    dma_single_data_parameter_struct dma_init_struct;
+
+    rcu_periph_clock_enable(RCU_DMA0);
+    dma_deinit(UART_TX_DMA, UART_TX_DMA_CH);
+    dma_single_data_para_struct_init(&dma_init_struct);
+    dma_init_struct.periph_addr = (uint32_t)&USART_DATA(UART3);
+    dma_init_struct.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
+    dma_init_struct.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
+    dma_init_struct.periph_memory_width = DMA_PERIPH_WIDTH_8BIT;
+    dma_init_struct.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
+    dma_init_struct.direction = DMA_MEMORY_TO_PERIPH;
+    dma_init_struct.priority = DMA_PRIORITY_MEDIUM;
+    dma_single_data_mode_init(UART_TX_DMA, UART_TX_DMA_CH, &dma_init_struct);
+    dma_channel_subperipheral_select(UART_TX_DMA, UART_TX_DMA_CH,
+                                     DMA_SUBPERI4);
+
+    dma_interrupt_enable(UART_TX_DMA, UART_TX_DMA_CH, DMA_INT_FTF);
+    nvic_irq_enable(UART_TX_DMA_IRQn, 7, 0);
+    usart_dma_transmit_config(UART3, USART_TRANSMIT_DMA_ENABLE);
+
+    uart_tx_ready = 1;
+}
+
+void DMA0_Channel4_IRQHandler(void) {
+    uart_tx_seg_t *seg;
+    UBaseType_t mask;
+
+    if (dma_interrupt_flag_get(UART_TX_DMA, UART_TX_DMA_CH,
+                               DMA_INT_FLAG_FTF)) {
+        dma_interrupt_flag_clear(UART_TX_DMA, UART_TX_DMA_CH,
+                                 DMA_INT_FLAG_FTF);
+
+        mask = taskENTER_CRITICAL_FROM_ISR();
+        seg = &uart_tx_seg[uart_tx_tail & UART_TX_SEG_MASK];
+        if (seg->stage >= 0) {
+            uart_tx_stage_busy[seg->stage] = 0;
+        }
+        uart_tx_tail++;
+        uart_tx_active = 0;
+        uart_tx_kick();
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+
+        if (seg->done != NULL) {
+            seg->done(seg->arg);
+        }
+    }
+}
+
+// 调用者需在临界区中. 最后一个排队段尚未开始发送且属于当前缓冲区时返回它,
+// 新数据可以直接追加在其后
+static uart_tx_seg_t *uart_tx_open_seg(void) {
+    uart_tx_seg_t *seg = &uart_tx_seg[(uart_tx_head - 1) & UART_TX_SEG_MASK];
+
+    if (uart_tx_head != uart_tx_tail &&
+        !(uart_tx_active && uart_tx_head - uart_tx_tail == 1) &&
+        seg->stage == uart_tx_fill) {
+        return seg;
+    }
+    return NULL;
+}
+
+// 调用者需在临界区中. 立即可以复制进暂存缓冲区的字节数
+static uint32_t uart_tx_space(void) {
+    uart_tx_seg_t *seg = uart_tx_open_seg();
+    uint32_t slots = UART_TX_SEG_MAX - (uart_tx_head - uart_tx_tail);
+    uint32_t idle = (uint32_t)!uart_tx_stage_busy[0] + !uart_tx_stage_busy[1];
+    uint32_t space = (seg != NULL) ? UART_TX_STAGE_SIZE - seg->len : 0;
+
+    return space + ((idle < slots) ? idle : slots) * UART_TX_STAGE_SIZE;
+}
+
+// 调用者需在临界区中. 先追加到最后一个段, 剩余部分依次放入空闲的缓冲区,
+// 返回复制的字节数
+static uint16_t uart_tx_put(const uint8_t *data, uint16_t len) {
+    uart_tx_seg_t *seg = uart_tx_open_seg();
+    uint16_t n = 0;
+    uint16_t chunk;
+
+    if (seg != NULL) {
+        chunk = UART_TX_STAGE_SIZE - seg->len;
+        chunk = (chunk < len) ? chunk : len;
+        memcpy(&uart_tx_stage[uart_tx_fill][seg->len], data, chunk);
+        seg->len += chunk;
+        n = chunk;
+    }
+    while (n < len && uart_tx_head - uart_tx_tail < UART_TX_SEG_MAX &&
+           !(uart_tx_stage_busy[0] && uart_tx_stage_busy[1])) {
+        // 当前缓冲区已发送完毕则重新从头使用, 否则换到另一个缓冲区
+        if (uart_tx_stage_busy[uart_tx_fill]) {
+            uart_tx_fill ^= 1;
+        }
+        uart_tx_stage_busy[uart_tx_fill] = 1;
+        chunk = len - n;
+        chunk = (chunk < UART_TX_STAGE_SIZE) ? chunk : UART_TX_STAGE_SIZE;
+        memcpy(uart_tx_stage[uart_tx_fill], &data[n], chunk);
+
+        seg = &uart_tx_seg[uart_tx_head & UART_TX_SEG_MASK];
+        seg->data = uart_tx_stage[uart_tx_fill];
+        seg->len = chunk;
+        seg->stage = (int8_t)uart_tx_fill;
+        seg->done = NULL;
+        seg->arg = NULL;
+        uart_tx_head++;
+        n += chunk;
+    }
+    return n;
+}
+
+uint16_t uart_tx_write(const void *data, uint16_t len) {
+    uint16_t n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    n = uart_tx_put((const uint8_t *)data, len);
+    uart_tx_stats.dropped += len - n;
+    uart_tx_kick();
+    taskEXIT_CRITICAL();
+
+    return n;
+}
+
+int uart_tx_write_all(const void *data, uint16_t len) {
+    int ret = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    if (uart_tx_space() < len) {
+        uart_tx_stats.dropped += len;
+        ret = -1;
+    } else {
+        uart_tx_put((const uint8_t *)data, len);
+        uart_tx_kick();
+    }
+    taskEXIT_CRITICAL();
+
+    return ret;
+}
+
+// 调用者需在临界区中且已确认队列有空位
+static void uart_tx_put_zc(const void *data, uint16_t len, uart_tx_done_t done,
+                           void *arg) {
+    uart_tx_seg_t *seg = &uart_tx_seg[uart_tx_head & UART_TX_SEG_MASK];
+
+    seg->data = (const uint8_t *)data;
+    seg->len = len;
+    seg->stage = -1;
+    seg->done = done;
+    seg->arg = arg;
+    uart_tx_head++;
+}
+
+int uart_tx_write_zc(const void *data, uint16_t len, uart_tx_done_t done,
+                     void *arg) {
+    if (len == 0) {
+        if (done != NULL) {
+            done(arg);
+        }
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    if (uart_tx_head - uart_tx_tail >= UART_TX_SEG_MAX) {
+        uart_tx_stats.seg_full++;
+        taskEXIT_CRITICAL();
+        return -1;
+    }
+    uart_tx_put_zc(data, len, done, arg);
+    uart_tx_kick();
+    taskEXIT_CRITICAL();
+
+    return 0;
+}
+
+int uart_tx_write_wrapped(const void *head, uint16_t head_len,
+                          const void *body, uint16_t body_len,
+                          uart_tx_done_t done, void *arg, const void *tail,
+                          uint16_t tail_len) {
+    uart_tx_seg_t *seg;
+    uint32_t space;
+    uint32_t bufs;
+    uint32_t idle;
+    int ret = 0;
+
+    taskENTER_CRITICAL();
+    // 先确认整条记录放得下: 头部放不进最后一个段时需要一个新缓冲区,
+    // 尾部跟在零拷贝段之后, 不能追加, 也需要一个
+    seg = uart_tx_open_seg();
+    space = (seg != NULL) ? UART_TX_STAGE_SIZE - seg->len : 0;
+    bufs = (head_len > space) + (tail_len > 0);
+    idle = (uint32_t)!uart_tx_stage_busy[0] + !uart_tx_stage_busy[1];
+    if (uart_tx_head - uart_tx_tail + bufs + (body_len > 0) >
+        UART_TX_SEG_MAX) {
+        uart_tx_stats.seg_full++;
+        ret = -1;
+    } else if (idle < bufs || head_len > space + UART_TX_STAGE_SIZE ||
+               tail_len > UART_TX_STAGE_SIZE) {
+        ret = -1;
+    }
+
+    if (ret != 0) {
+        uart_tx_stats.dropped += (uint32_t)head_len + body_len + tail_len;
+    } else {
+        uart_tx_put((const uint8_t *)head, head_len);
+        if (body_len > 0) {
+            uart_tx_put_zc(body, body_len, done, arg);
+        }
+        uart_tx_put((const uint8_t *)tail, tail_len);
+        uart_tx_kick();
+    }
+    taskEXIT_CRITICAL();
+
+    if (ret == 0 && body_len == 0 && done != NULL) {
+        done(arg);
+    }
+    return ret;
+}
+
+void uart_tx_get_stats(uart_tx_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uart_tx_stats;
+    taskEXIT_CRITICAL();
+}
+
+/* retarget the C library printf function to the USART */
+int fputc(int ch, FILE *f) {
+    uint8_t c = (uint8_t)ch;
+
+    (void)f;
+    // DMA 未就绪或在中断中时退回到查询发送
+    if (!uart_tx_ready || __get_IPSR() != 0) {
+        usart_data_transmit(UART3, c);
+        while (RESET == usart_flag_get(UART3, USART_FLAG_TBE));
+        return ch;
+    }
+    uart_tx_write(&c, 1);
+    return ch;
+}
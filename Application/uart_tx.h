@@ -0,0 +1,46 @@
+#ifndef UART_TX_H
+#define UART_TX_H
+
+#include <stdint.h>
+
+#define UART_TX_STAGE_SIZE 256    // bytes per staging buffer (two of them)
+#define UART_TX_SEG_MAX    16     // queued segments, must be a power of two
+
+typedef void (*uart_tx_done_t)(void *arg);
+
+typedef struct {
+    uint32_t bytes;      // bytes handed to the DMA
+    uint32_t dropped;    // bytes refused because the staging buffers were full
+    uint32_t seg_full;   // zero-copy segments refused because the queue was full
+} uart_tx_stats_t;
+
+/* Set up DMA0 CH4 for UART3 transmit. uart3_init() must have run first. */
+void uart_tx_init(void);
+
+/* Copy data into the staging buffers and queue it, spilling into the other
+ * buffer when the current one fills up. Never blocks; returns the number of
+ * bytes accepted, the rest is counted as dropped. Task context only. */
+uint16_t uart_tx_write(const void *data, uint16_t len);
+
+/* Like uart_tx_write(), but queues either all of data or nothing. Returns 0,
+ * or -1 if it did not fit (all of it is counted as dropped). Task context only. */
+int uart_tx_write_all(const void *data, uint16_t len);
+
+/* Queue data for transmission without copying it. The buffer must stay valid
+ * until done(arg) is called, from the DMA interrupt. Returns 0, or -1 if the
+ * segment queue is full (done is not called in that case). Task context only. */
+int uart_tx_write_zc(const void *data, uint16_t len, uart_tx_done_t done,
+                     void *arg);
+
+/* Queue head and tail (copied) around body (zero-copy, as uart_tx_write_zc())
+ * as one unit: the staging space and segment slots of all three are checked
+ * first and either all of them are queued or none. Returns 0, or -1 if the
+ * record did not fit (done is not called in that case). Task context only. */
+int uart_tx_write_wrapped(const void *head, uint16_t head_len,
+                          const void *body, uint16_t body_len,
+                          uart_tx_done_t done, void *arg, const void *tail,
+                          uint16_t tail_len);
+
+void uart_tx_get_stats(uart_tx_stats_t *stats);
+
+#endif /* UART_TX_H */
@@ -0,0 +1,180 @@
+#include "uwb_cir.h"
+
+#include "deca_device_api.h"
+#include "queue.h"
+#include "task.h"
+#include "uwb_telemetry.h"
+
+#define UWB_CIR_PAYLOAD_MAX (UWB_TLM_CIR_HEADER_LEN + 4 * UWB_CIR_TAPS_MAX)
+
+/* The accumulator read starts with a dummy octet, so it is read into the
+ * byte before the samples and the payload header is written afterwards by
+ * the sender. busy is set by the engine task and cleared by the UART DMA
+ * completion. frame holds a reference from capture until the record header
+ * has been built. */
+typedef struct {
+    uint8_t payload[UWB_CIR_PAYLOAD_MAX];
+    uwb_frame_t *frame;
+    uint32_t seq;
+    uint16_t first;
+    uint16_t taps;
+    volatile uint8_t busy;
+} uwb_cir_block_t;
+
+static uwb_cir_block_t uwb_cir_blocks[UWB_CIR_POOL_LEN];
+static QueueHandle_t uwb_cir_queue;    // captured blocks, engine -> sender
+static uwb_cir_config_t uwb_cir_config;
+static volatile uint8_t uwb_cir_enabled;
+static uint8_t uwb_cir_skip;
+static uint32_t uwb_cir_seq;
+static uwb_cir_stats_t uwb_cir_stats;
+
+static void uwb_cir_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void uwb_cir_sent(void *arg) {
+    ((uwb_cir_block_t *)arg)->busy = 0;
+}
+
+static void uwb_cir_task(void *pvParameters) {
+    uwb_cir_block_t *block;
+    uint8_t *p;
+    int ret;
+
+    (void)pvParameters;
+    while (1) {
+        xQueueReceive(uwb_cir_queue, &block, portMAX_DELAY);
+
+        p = block->payload;
+        p[0] = (uint8_t)block->seq;
+        p[1] = (uint8_t)(block->seq >> 8);
+        p[2] = (uint8_t)(block->seq >> 16);
+        p[3] = (uint8_t)(block->seq >> 24);
+        uwb_cir_put16(&p[4], block->first);
+        uwb_cir_put16(&p[6], block->taps);
+
+        // busy is cleared by uwb_cir_sent() in every case; the frame fields
+        // are copied into the record header before this returns
+        ret = uwb_telemetry_send_cir(block->frame, p,
+                                     UWB_TLM_CIR_HEADER_LEN + 4 * block->taps,
+                                     uwb_cir_sent, block);
+        uwb_frame_unref(block->frame);
+
+        if (ret != 0) {
+            uwb_cir_stats.uart_full++;
+        } else {
+            uwb_cir_stats.captured++;
+        }
+    }
+}
+
+int uwb_cir_start(const uwb_cir_config_t *cfg, UBaseType_t priority) {
+    if (cfg != NULL && (cfg->taps == 0 || cfg->taps > UWB_CIR_TAPS_MAX)) {
+        return -1;
+    }
+    if (cfg != NULL && uwb_cir_queue == NULL) {
+        // one entry per block, so queueing a free block never fails
+        uwb_cir_queue = xQueueCreate(UWB_CIR_POOL_LEN, sizeof(uwb_cir_block_t *));
+        if (uwb_cir_queue == NULL) {
+            return -1;
+        }
+        if (xTaskCreate(uwb_cir_task, "UwbCir", UWB_CIR_STACK_WORDS, NULL,
+                        priority, NULL) != pdPASS) {
+            vQueueDelete(uwb_cir_queue);
+            uwb_cir_queue = NULL;
+            return -1;
+        }
+    }
+    taskENTER_CRITICAL();
+    if (cfg != NULL) {
+        uwb_cir_config = *cfg;
+        uwb_cir_skip = 0;
+    }
+    uwb_cir_enabled = (cfg != NULL);
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+int uwb_cir_select(void) {
+    uint8_t every;
+
+    if (!uwb_cir_enabled) {
+        return 0;
+    }
+    taskENTER_CRITICAL();
+    every = uwb_cir_config.every;
+    taskEXIT_CRITICAL();
+
+    if (every > 1) {
+        if (uwb_cir_skip != 0) {
+            uwb_cir_skip--;
+            return 0;
+        }
+        uwb_cir_skip = every - 1;
+    }
+
+    // blocks are only taken by the engine, so one free now is still free
+    // when uwb_cir_capture() runs
+    for (int i = 0; i < UWB_CIR_POOL_LEN; i++) {
+        if (!uwb_cir_blocks[i].busy) {
+            return 1;
+        }
+    }
+    uwb_cir_seq++;
+    uwb_cir_stats.skipped++;
+    return 0;
+}
+
+void uwb_cir_capture(uwb_frame_t *frame) {
+    uwb_cir_config_t cfg;
+    uwb_cir_block_t *block = NULL;
+    uint16_t acc_taps;
+    int32_t first;
+
+    taskENTER_CRITICAL();
+    cfg = uwb_cir_config;
+    taskEXIT_CRITICAL();
+
+    for (int i = 0; i < UWB_CIR_POOL_LEN; i++) {
+        if (!uwb_cir_blocks[i].busy) {
+            block = &uwb_cir_blocks[i];
+            break;
+        }
+    }
+    if (block == NULL) {
+        return;    // not selected by uwb_cir_select()
+    }
+    block->busy = 1;
+
+    // first path index is 10.6 fixed point, keep the window inside the
+    // accumulator
+    acc_taps = (cfg.prf == DWT_PRF_16M) ? UWB_CIR_ACC_TAPS_16M
+                                        : UWB_CIR_ACC_TAPS_64M;
+    first = ((frame->diag.firstPath + 32) >> 6) - cfg.pre_taps;
+    if (first > acc_taps - cfg.taps) {
+        first = acc_taps - cfg.taps;
+    }
+    if (first < 0) {
+        first = 0;
+    }
+
+    dwt_readaccdata(&block->payload[UWB_TLM_CIR_HEADER_LEN - 1],
+                    4 * cfg.taps + 1, (uint16_t)(4 * first));
+    block->seq = uwb_cir_seq++;
+    block->first = (uint16_t)first;
+    block->taps = cfg.taps;
+    block->frame = frame;
+    uwb_frame_ref(frame);
+
+    // the engine keeps running: record header, CRC and the telemetry lock
+    // are the sender's
+    xQueueSend(uwb_cir_queue, &block, 0);
+}
+
+void uwb_cir_get_stats(uwb_cir_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uwb_cir_stats;
+    taskEXIT_CRITICAL();
+}
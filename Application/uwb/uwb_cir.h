@@ -0,0 +1,65 @@
+#ifndef UWB_CIR_H
+#define UWB_CIR_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "uwb_frame_pool.h"
+
+/* Channel impulse response capture. For each good frame the engine reads a
+ * window of the accumulator around the first path index reported by
+ * dwt_readdiagnostics() into one of UWB_CIR_POOL_LEN static blocks and
+ * queues it, with a reference to the frame, to a sender task running below
+ * the engine. The sender builds the UWB_TLM_TYPE_CIR telemetry record and
+ * streams the block zero-copy. A window of 64 taps is 300 bytes on the wire,
+ * so 50 CIR/s takes about 15 kB/s of the 92 kB/s UART. When every block is
+ * still queued or on the UART the CIR is skipped and counted; reception is
+ * never held up by the telemetry lock or the CRC.
+ *
+ * The accumulator is not double buffered: the receiver overwrites it as soon
+ * as it starts on the next preamble. For a frame picked by uwb_cir_select()
+ * the engine therefore re-enables the receiver only after the window has been
+ * read. The radio is off for that read, about 0.55 ms for 64 taps at
+ * SPI_PSC_32 (3.75 MHz); other frames are re-armed at once. */
+#define UWB_CIR_TAPS_MAX       64      // window length limit, 4 bytes per tap
+#define UWB_CIR_POOL_LEN       4       // blocks in flight on the UART
+#define UWB_CIR_ACC_TAPS_16M   992     // accumulator length at 16 MHz PRF
+#define UWB_CIR_ACC_TAPS_64M   1016    // accumulator length at 64 MHz PRF
+
+typedef struct {
+    uint16_t pre_taps;    // taps captured before the first path
+    uint16_t taps;        // window length, at most UWB_CIR_TAPS_MAX
+    uint8_t prf;          // as configured, DWT_PRF_16M or DWT_PRF_64M
+    uint8_t every;        // capture one frame in this many, 0 or 1 for all
+} uwb_cir_config_t;
+
+#define UWB_CIR_STACK_WORDS    256
+
+typedef struct {
+    uint32_t captured;    // records queued on the UART
+    uint32_t skipped;     // frames not captured because no block was free
+    uint32_t uart_full;   // records the UART queue refused
+} uwb_cir_stats_t;
+
+/* Enable capture with the given window, or disable it with NULL. May be
+ * called while the receive engine is running. The first enabling call
+ * creates the sender task at priority, which should be below the receive
+ * engine; later calls ignore it. */
+int uwb_cir_start(const uwb_cir_config_t *cfg, UBaseType_t priority);
+
+/* Decide whether the CIR of the good frame being handled is captured: capture
+ * is enabled, the frame is due (see every) and a block is free. Called by the
+ * receive engine before it re-enables the receiver; a frame that is due but
+ * finds no block is counted as skipped. */
+int uwb_cir_select(void);
+
+/* Capture the CIR of a frame for which uwb_cir_select() returned 1. Called
+ * from the engine task after dwt_readdiagnostics() and uwb_nlos_estimate(),
+ * with the receiver still off so the accumulator holds this frame. Only reads
+ * the window and queues it; the frame is referenced until the sender has
+ * built the record. */
+void uwb_cir_capture(uwb_frame_t *frame);
+
+void uwb_cir_get_stats(uwb_cir_stats_t *stats);
+
+#endif /* UWB_CIR_H */
@@ -0,0 +1,53 @@
+#ifndef UWB_CLKOFFSET_H
+#define UWB_CLKOFFSET_H
+
+#include <stdint.h>
+
+#include "deca_device_api.h"
+
+/* Clock offset of the sender of a frame, from the receiver's carrier
+ * integrator (dwt_rxdiag_t.carrierIntegrator, read by dwt_readdiagnostics()).
+ * One integrator unit is 998.4 MHz / 2 / 1024 / 2^17 Hz of carrier offset
+ * (8 times less at 110 kbps); divided by the channel centre frequency that
+ * gives the clock offset, both sides deriving carrier and timebase from the
+ * same crystal. Integer only, like uwb_timestamp.h. */
+
+// ppb per integrator unit at 850 kbps / 6.8 Mbps, 16.16 fixed point, negated
+#define UWB_CLKOFFSET_K_CH1  69754    // 3494.4 MHz
+#define UWB_CLKOFFSET_K_CH2  61035    // 3993.6 MHz, also channel 4
+#define UWB_CLKOFFSET_K_CH3  54253    // 4492.8 MHz
+#define UWB_CLKOFFSET_K_CH5  37560    // 6489.6 MHz, also channel 7
+
+/* Frequency offset of the remote clock relative to ours in parts per billion,
+ * positive when the remote clock runs fast. chan and data_rate are the
+ * configured channel and DWT_BR_x. */
+static inline int32_t uwb_clkoffset_ppb(int32_t carrier, uint8_t chan,
+                                        uint8_t data_rate) {
+    int32_t k;
+
+    switch (chan) {
+    case 1:
+        k = UWB_CLKOFFSET_K_CH1;
+        break;
+    case 2:
+    case 4:
+        k = UWB_CLKOFFSET_K_CH2;
+        break;
+    case 3:
+        k = UWB_CLKOFFSET_K_CH3;
+        break;
+    default:
+        k = UWB_CLKOFFSET_K_CH5;
+        break;
+    }
+    return (int32_t)(((int64_t)carrier * -k) >>
+                     ((data_rate == DWT_BR_110K) ? 19 : 16));
+}
+
+/* Convert an interval timed by the remote clock into our clock, given the
+ * remote offset in ppb: dtu * (1 - ppb / 1e9), to first order. */
+static inline int64_t uwb_clkoffset_to_local(int64_t dtu, int32_t ppb) {
+    return dtu - dtu * ppb / 1000000000;
+}
+
+#endif /* UWB_CLKOFFSET_H */
@@ -0,0 +1,334 @@
+#include "uwb_clksync.h"
+
+#include "deca_device_api.h"
+#include "deca_irq.h"
+#include "task.h"
+#include "uwb_tempcomp.h"
+
+#define UWB_CLKSYNC_STACK_WORDS 256
+#define UWB_CLKSYNC_TX_DLY_UUS  500    // system time read to sync frame TX
+#define UWB_CLKSYNC_TX_TIMEOUT  pdMS_TO_TICKS(5)
+
+/* Filter gains, 16.16 fixed point: alpha for the offset, beta = alpha^2 /
+ * (2 - alpha) for the drift (critically damped alpha-beta filter). */
+#define UWB_CLKSYNC_ALPHA       8192    // 1/8
+#define UWB_CLKSYNC_BETA        546
+
+// drift limit, 32.32 fixed point (100 ppm), keeps the conversion in 64 bits
+#define UWB_CLKSYNC_DRIFT_MAX   429497
+#define UWB_CLKSYNC_RATE_DIV    10000    // the same 100 ppm as 1 / interval
+
+#define MSG_SEQ       2
+#define MSG_PAN       3
+#define MSG_DST       5
+#define MSG_SRC       7
+#define MSG_FUNC      9
+#define MSG_TS        10
+
+typedef enum {
+    CLKSYNC_EMPTY,     // no sync yet
+    CLKSYNC_OFFSET,    // one sync, drift unknown
+    CLKSYNC_LOCKED,
+} uwb_clksync_phase_t;
+
+/* ref(local) = ref_at + d + d * drift / 2^32, d = local - local_at. ref_frac
+ * holds the sub-dtu part of ref_at, 16.16, drift_rem what the last drift
+ * correction lost to the division (times the sync interval). */
+typedef struct {
+    uint16_t ref;
+    int32_t tof;
+    uwb_clksync_phase_t phase;
+    uwb_ts_t local_at;
+    uwb_ts_t ref_at;
+    int32_t ref_frac;
+    int32_t drift;
+    int64_t drift_rem;
+    TickType_t last_tick;
+    uint8_t outlier_run;
+    uwb_clksync_state_t st;
+} uwb_clksync_model_t;
+
+static uwb_clksync_model_t uwb_clksync_models[UWB_CLKSYNC_REF_MAX];
+static uint8_t uwb_clksync_nmodels;
+static uwb_clksync_stats_t uwb_clksync_stats;
+
+static uwb_clksync_ref_config_t uwb_clksync_cfg;
+static uint8_t uwb_clksync_tx[UWB_CLKSYNC_FRAME_LEN];
+static uint8_t uwb_clksync_seq;
+
+static void msg_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t msg_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/* ---- reference ---- */
+
+static void clksync_tx_done_cb(const dwt_cb_data_t *cb) {
+    (void)cb;
+    uwb_clksync_stats.sent++;
+}
+
+static void clksync_send(void) {
+    uwb_ts_t at;
+    uwb_ts_t tx_ts;
+
+    // the frame carries the time it will leave at, so it is scheduled ahead
+    at = uwb_ts_add(uwb_ts_from_hi32(dwt_readsystimestamphi32()),
+                    uwb_uus_to_dtu(UWB_CLKSYNC_TX_DLY_UUS));
+    tx_ts = uwb_ts_delayed_tx_stamp(at, uwb_clksync_cfg.ant_dly);
+
+    uwb_clksync_tx[0] = 0x41;    // data frame, PAN ID compression
+    uwb_clksync_tx[1] = 0x88;    // short destination and source addresses
+    uwb_clksync_tx[MSG_SEQ] = uwb_clksync_seq++;
+    msg_put16(&uwb_clksync_tx[MSG_PAN], uwb_clksync_cfg.pan_id);
+    msg_put16(&uwb_clksync_tx[MSG_DST], 0xFFFF);
+    msg_put16(&uwb_clksync_tx[MSG_SRC], uwb_clksync_cfg.addr);
+    uwb_clksync_tx[MSG_FUNC] = UWB_CLKSYNC_FUNC;
+    uwb_ts_to_bytes(tx_ts, &uwb_clksync_tx[MSG_TS]);
+
+    dwt_writetxdata(UWB_CLKSYNC_FRAME_LEN, uwb_clksync_tx, 0);
+    dwt_writetxfctrl(UWB_CLKSYNC_FRAME_LEN, 0, 1);
+    dwt_setdelayedtrxtime(uwb_ts_dly_reg(at));
+    if (dwt_starttx(DWT_START_TX_DELAYED) != DWT_SUCCESS) {
+        uwb_clksync_stats.tx_late++;
+        return;
+    }
+
+    if (ulTaskNotifyTake(pdTRUE, UWB_CLKSYNC_TX_TIMEOUT) == 0) {
+        dwt_forcetrxoff();
+        return;
+    }
+    // the IRQ line stays high until every enabled event is cleared
+    do {
+        dwt_isr();
+    } while (deca_irq_active());
+}
+
+static void clksync_ref_task(void *pvParameters) {
+    TickType_t last = xTaskGetTickCount();
+
+    decaselectdevice((unsigned int)(uintptr_t)pvParameters);
+
+    dwt_settxantennadelay(uwb_clksync_cfg.ant_dly);
+    dwt_setcallbacks(clksync_tx_done_cb, NULL, NULL, NULL);
+    dwt_setinterrupt(DWT_INT_TFRS, 1);
+    deca_irq_init(xTaskGetCurrentTaskHandle());
+
+    while (1) {
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(uwb_clksync_cfg.period_ms));
+        uwb_tempcomp_apply();
+        clksync_send();
+    }
+}
+
+int uwb_clksync_ref_start(const uwb_clksync_ref_config_t *cfg,
+                          UBaseType_t priority) {
+    uwb_clksync_cfg = *cfg;
+    if (uwb_clksync_cfg.period_ms == 0) {
+        uwb_clksync_cfg.period_ms = 1;
+    }
+    // the engine works with the DW1000 selected by the caller
+    if (xTaskCreate(clksync_ref_task, "UwbSync", UWB_CLKSYNC_STACK_WORDS,
+                    (void *)(uintptr_t)decadeviceindex(), priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- follower ---- */
+
+static uwb_clksync_model_t *clksync_find(uint16_t ref) {
+    for (int i = 0; i < uwb_clksync_nmodels; i++) {
+        if (uwb_clksync_models[i].ref == ref) {
+            return &uwb_clksync_models[i];
+        }
+    }
+    return NULL;
+}
+
+static uwb_ts_t clksync_predict(const uwb_clksync_model_t *m, uwb_ts_t local) {
+    int64_t d = uwb_ts_diff(local, m->local_at);
+
+    return uwb_ts_add(m->ref_at, d + ((d * m->drift) >> 32));
+}
+
+static int32_t clksync_clamp_drift(int64_t drift) {
+    if (drift > UWB_CLKSYNC_DRIFT_MAX) {
+        return UWB_CLKSYNC_DRIFT_MAX;
+    }
+    if (drift < -UWB_CLKSYNC_DRIFT_MAX) {
+        return -UWB_CLKSYNC_DRIFT_MAX;
+    }
+    return (int32_t)drift;
+}
+
+// first sync of a (re)started model
+static void clksync_restart(uwb_clksync_model_t *m, uwb_ts_t ref,
+                            uwb_ts_t local) {
+    if (m->phase != CLKSYNC_EMPTY) {
+        m->st.resets++;
+    }
+    m->phase = CLKSYNC_OFFSET;
+    m->local_at = local;
+    m->ref_at = ref;
+    m->ref_frac = 0;
+    m->drift = 0;
+    m->drift_rem = 0;
+    m->outlier_run = 0;
+    m->st.residual = 0;
+}
+
+static void clksync_update(uwb_clksync_model_t *m, uwb_ts_t ref,
+                           uwb_ts_t local, TickType_t now) {
+    int64_t dt;
+    int64_t r;
+    int64_t corr;
+    uwb_ts_t predicted;
+
+    dt = uwb_ts_diff(local, m->local_at);
+    if (m->phase == CLKSYNC_EMPTY || dt <= 0 ||
+        now - m->last_tick > pdMS_TO_TICKS(UWB_CLKSYNC_GAP_MS)) {
+        clksync_restart(m, ref, local);
+        return;
+    }
+
+    if (m->phase == CLKSYNC_OFFSET) {
+        // two syncs: drift straight from the two intervals. A pair more than
+        // 100 ppm apart is no clock (rebooted reference, garbled frame); it
+        // would also overflow the 32.32 drift, so start over from this sync
+        r = uwb_ts_diff(ref, m->ref_at) - dt;
+        if (r > dt / UWB_CLKSYNC_RATE_DIV || r < -(dt / UWB_CLKSYNC_RATE_DIV)) {
+            clksync_restart(m, ref, local);
+            return;
+        }
+        m->drift = clksync_clamp_drift(r * 4294967296LL / dt);
+        m->local_at = local;
+        m->ref_at = ref;
+        m->phase = CLKSYNC_LOCKED;
+        m->st.updates++;
+        return;
+    }
+
+    predicted = clksync_predict(m, local);
+    r = uwb_ts_diff(ref, predicted);
+    if (r > UWB_CLKSYNC_OUTLIER_DTU || r < -UWB_CLKSYNC_OUTLIER_DTU) {
+        m->st.outliers++;
+        if (++m->outlier_run >= UWB_CLKSYNC_OUTLIER_MAX) {
+            clksync_restart(m, ref, local);
+        }
+        return;
+    }
+    m->outlier_run = 0;
+
+    // offset: keep the sub-dtu part so small corrections are not lost
+    corr = UWB_CLKSYNC_ALPHA * r + m->ref_frac;
+    m->ref_at = uwb_ts_add(predicted, corr >> 16);
+    m->ref_frac = (int32_t)(corr - (corr >> 16) * 65536);
+    m->local_at = local;
+    // drift: one dtu of residual is below one step of it at 100 ms syncs, so
+    // the remainder is carried too or small residuals would never correct it
+    corr = UWB_CLKSYNC_BETA * r * 65536 + m->drift_rem;
+    m->drift = clksync_clamp_drift(m->drift + corr / dt);
+    m->drift_rem = corr % dt;
+    m->st.residual = (int32_t)r;
+    m->st.updates++;
+}
+
+int uwb_clksync_follow(uint16_t ref, int32_t tof_dtu) {
+    uwb_clksync_model_t *m;
+
+    if (clksync_find(ref) != NULL) {
+        return 0;
+    }
+    if (uwb_clksync_nmodels >= UWB_CLKSYNC_REF_MAX) {
+        return -1;
+    }
+    m = &uwb_clksync_models[uwb_clksync_nmodels];
+    m->ref = ref;
+    m->tof = tof_dtu;
+    m->phase = CLKSYNC_EMPTY;
+    taskENTER_CRITICAL();
+    uwb_clksync_nmodels++;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+int uwb_clksync_rx(const uwb_frame_t *frame) {
+    const uint8_t *p = frame->data;
+    uwb_clksync_model_t *m;
+    uwb_ts_t ref;
+    TickType_t now;
+
+    if (frame->length != UWB_CLKSYNC_FRAME_LEN || p[0] != 0x41 ||
+        p[MSG_FUNC] != UWB_CLKSYNC_FUNC ||
+        msg_get16(&p[MSG_DST]) != 0xFFFF ||
+        (m = clksync_find(msg_get16(&p[MSG_SRC]))) == NULL) {
+        return 0;
+    }
+    uwb_clksync_stats.received++;
+
+    // reference time at which the frame reached us
+    ref = uwb_ts_add(uwb_ts_from_bytes(&p[MSG_TS]), m->tof);
+    now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    clksync_update(m, ref, uwb_ts_from_bytes(frame->rx_stamp), now);
+    m->last_tick = now;
+    taskEXIT_CRITICAL();
+    return 1;
+}
+
+static int clksync_convert(uwb_clksync_model_t *m, uwb_ts_t local,
+                           uwb_ts_t *out) {
+    int ret = -1;
+
+    taskENTER_CRITICAL();
+    if (m->phase == CLKSYNC_LOCKED &&
+        xTaskGetTickCount() - m->last_tick <=
+            pdMS_TO_TICKS(UWB_CLKSYNC_GAP_MS)) {
+        *out = clksync_predict(m, local);
+        ret = 0;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+int uwb_clksync_convert(uint16_t ref, uwb_ts_t local, uwb_ts_t *out) {
+    uwb_clksync_model_t *m = clksync_find(ref);
+
+    return (m != NULL) ? clksync_convert(m, local, out) : -1;
+}
+
+uint16_t uwb_clksync_convert_primary(uwb_ts_t local, uwb_ts_t *out) {
+    if (uwb_clksync_nmodels == 0 ||
+        clksync_convert(&uwb_clksync_models[0], local, out) != 0) {
+        return UWB_CLKSYNC_NONE;
+    }
+    return uwb_clksync_models[0].ref;
+}
+
+int uwb_clksync_get_state(uint16_t ref, uwb_clksync_state_t *state) {
+    uwb_clksync_model_t *m = clksync_find(ref);
+
+    if (m == NULL) {
+        return -1;
+    }
+    taskENTER_CRITICAL();
+    *state = m->st;
+    state->locked = (m->phase == CLKSYNC_LOCKED);
+    // 32.32 to parts per billion
+    state->drift_ppb = (int32_t)(((int64_t)m->drift * 1000000000) >> 32);
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+void uwb_clksync_get_stats(uwb_clksync_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uwb_clksync_stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,88 @@
+#ifndef UWB_CLKSYNC_H
+#define UWB_CLKSYNC_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "uwb_frame_pool.h"
+#include "uwb_timestamp.h"
+
+/* Wireless clock synchronisation for TDoA anchor networks.
+ *
+ * The reference anchor runs a transmit-only engine that sends a broadcast
+ * sync frame every period_ms with a delayed TX, so the frame carries its own
+ * 40-bit TX timestamp (antenna delay included):
+ *
+ *   fctrl(2) seq(1) pan(2) dst 0xFFFF(2) src(2) func 0x30(1) tx_ts(5) fcs(2)
+ *
+ * Followers keep a linear model per reference, ref = a + (local - b) * (1 +
+ * drift), fed with the sync frames their receive engine delivers. Each sync
+ * gives the reference time of its arrival (TX timestamp plus the known time
+ * of flight from the reference); the model is corrected by a fixed-point
+ * steady-state Kalman (alpha-beta) filter. Converting a timestamp is one
+ * 40-bit difference and one 64-bit multiply, whatever the history, so it runs
+ * for every blink. The model stays valid while syncs arrive less than
+ * UWB_CLKSYNC_GAP_MS apart; two syncs whose intervals differ by more than
+ * 100 ppm restart it. Tools/uwb_clksync simulates a follower: at 100 ms
+ * syncs and 6 dtu RX noise the drift stays within 1 ppb of the true one and
+ * a stamp 50 ms after a sync converts to within 15 dtu. */
+#define UWB_CLKSYNC_FUNC        0x30
+#define UWB_CLKSYNC_FRAME_LEN   17      // including the FCS
+#define UWB_CLKSYNC_REF_MAX     4       // references a follower can track
+#define UWB_CLKSYNC_NONE        0xFFFF  // no reference / local timebase
+#define UWB_CLKSYNC_GAP_MS      2000    // longest sync interval before a reset
+#define UWB_CLKSYNC_OUTLIER_DTU 640     // 10 ns, larger residuals are dropped
+#define UWB_CLKSYNC_OUTLIER_MAX 4       // consecutive outliers before a reset
+
+typedef struct {
+    uint16_t pan_id;
+    uint16_t addr;         // own short address, carried as source
+    uint16_t period_ms;    // time between sync frames
+    uint16_t ant_dly;      // TX antenna delay, device time units
+} uwb_clksync_ref_config_t;
+
+typedef struct {
+    uint8_t locked;        // two or more syncs, conversions are valid
+    int32_t drift_ppb;     // reference clock rate relative to ours, ppb
+    int32_t residual;      // last prediction error, device time units
+    uint32_t updates;      // syncs used
+    uint32_t outliers;     // syncs dropped
+    uint32_t resets;       // times the model was restarted
+} uwb_clksync_state_t;
+
+typedef struct {
+    uint32_t sent;         // reference: sync frames sent
+    uint32_t tx_late;      // reference: delayed TX missed its slot
+    uint32_t received;     // follower: sync frames from a tracked reference
+} uwb_clksync_stats_t;
+
+/* Reference anchor: start the sync engine. Like uwb_rx_start() and
+ * uwb_twr_start() it takes over the DW1000 IRQ and callbacks, so the
+ * reference does not receive blinks itself. The engine drives the device
+ * selected by the caller (decaselectdevice()). */
+int uwb_clksync_ref_start(const uwb_clksync_ref_config_t *cfg,
+                          UBaseType_t priority);
+
+/* Follower: track the reference with short address ref, tof_dtu device time
+ * units away (surveyed distance). The first reference added is the primary
+ * one. Returns -1 if UWB_CLKSYNC_REF_MAX references are already tracked. */
+int uwb_clksync_follow(uint16_t ref, int32_t tof_dtu);
+
+/* Follower: feed a frame from the receive engine. Returns 1 if it was a sync
+ * frame from a tracked reference (and so not a frame for the caller), 0
+ * otherwise. Call from one task only. */
+int uwb_clksync_rx(const uwb_frame_t *frame);
+
+/* Convert a local timestamp into the timebase of ref. Returns 0, or -1 if the
+ * model of ref is not locked. */
+int uwb_clksync_convert(uint16_t ref, uwb_ts_t local, uwb_ts_t *out);
+
+/* Same for the primary reference. Returns its address, or UWB_CLKSYNC_NONE
+ * (out untouched) if there is none or it is not locked. */
+uint16_t uwb_clksync_convert_primary(uwb_ts_t local, uwb_ts_t *out);
+
+int uwb_clksync_get_state(uint16_t ref, uwb_clksync_state_t *state);
+
+void uwb_clksync_get_stats(uwb_clksync_stats_t *stats);
+
+#endif /* UWB_CLKSYNC_H */
@@ -0,0 +1,70 @@
+#include "uwb_frame_pool.h"
+
+#include "gd32f4xx.h"
+
+#if UWB_FRAME_POOL_LEN > 32
+#error "UWB_FRAME_POOL_LEN must fit the 32-bit free map"
+#endif
+
+static uwb_frame_t uwb_frame_pool[UWB_FRAME_POOL_LEN];
+
+// bit n set = block n free
+static volatile uint32_t uwb_frame_free =
+    (UWB_FRAME_POOL_LEN == 32) ? 0xFFFFFFFFU
+                               : ((1U << UWB_FRAME_POOL_LEN) - 1U);
+
+uwb_frame_t *uwb_frame_alloc(void) {
+    uint32_t map;
+    uint32_t n;
+
+    do {
+        map = __LDREXW(&uwb_frame_free);
+        if (map == 0) {
+            __CLREX();
+            return NULL;
+        }
+        n = __CLZ(__RBIT(map));    // lowest free block
+    } while (__STREXW(map & ~(1U << n), &uwb_frame_free) != 0);
+    __DMB();
+
+    uwb_frame_pool[n].refs = 1;
+    return &uwb_frame_pool[n];
+}
+
+void uwb_frame_ref(uwb_frame_t *frame) {
+    uint32_t refs;
+
+    do {
+        refs = __LDREXW(&frame->refs);
+    } while (__STREXW(refs + 1, &frame->refs) != 0);
+}
+
+void uwb_frame_unref(uwb_frame_t *frame) {
+    uint32_t n = (uint32_t)(frame - uwb_frame_pool);
+    uint32_t refs;
+    uint32_t map;
+
+    do {
+        refs = __LDREXW(&frame->refs);
+    } while (__STREXW(refs - 1, &frame->refs) != 0);
+
+    if (refs != 1) {
+        return;
+    }
+    // last reference, make the contents visible before the block is reused
+    __DMB();
+    do {
+        map = __LDREXW(&uwb_frame_free);
+    } while (__STREXW(map | (1U << n), &uwb_frame_free) != 0);
+}
+
+uint32_t uwb_frame_free_count(void) {
+    uint32_t map = uwb_frame_free;
+    uint32_t count = 0;
+
+    while (map) {
+        map &= map - 1;
+        count++;
+    }
+    return count;
+}
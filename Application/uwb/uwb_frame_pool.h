@@ -0,0 +1,39 @@
+#ifndef UWB_FRAME_POOL_H
+#define UWB_FRAME_POOL_H
+
+#include <stdint.h>
+
+#include "deca_device_api.h"
+#include "uwb_nlos.h"
+
+#define UWB_FRAME_LEN_MAX   127    // standard PHR mode
+#define UWB_FRAME_POOL_LEN  16     // blocks, at most 32
+
+/* Fixed size frame block. A block is owned through references: the holder of
+ * each reference may read it, and it returns to the pool when the last one is
+ * dropped, so a frame can be handed to several output stages without a copy.
+ * All blocks are static SRAM, so they are valid DMA sources and targets. */
+typedef struct {
+    uint16_t length;         // including the two FCS bytes
+    uint8_t rx_stamp[5];     // adjusted RX timestamp, device time units
+    dwt_rxdiag_t diag;
+    uwb_nlos_t nlos;         // powers and NLOS likelihood from diag
+    uint8_t data[UWB_FRAME_LEN_MAX];
+    volatile uint32_t refs;
+} uwb_frame_t;
+
+/* Take a free block with one reference, or NULL if the pool is exhausted.
+ * Lock free, may be called from tasks and interrupts. */
+uwb_frame_t *uwb_frame_alloc(void);
+
+/* Add a reference for another consumer. */
+void uwb_frame_ref(uwb_frame_t *frame);
+
+/* Drop a reference; the last one returns the block to the pool. Lock free,
+ * may be called from interrupts (e.g. a DMA completion). */
+void uwb_frame_unref(uwb_frame_t *frame);
+
+/* Number of blocks currently free. */
+uint32_t uwb_frame_free_count(void);
+
+#endif /* UWB_FRAME_POOL_H */
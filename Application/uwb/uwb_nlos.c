@@ -0,0 +1,108 @@
+#include "uwb_nlos.h"
+
+#include "freertos.h"
+#include "gd32f4xx.h"
+#include "task.h"
+
+#define UWB_NLOS_A_16M       11377       // 113.77 dB
+#define UWB_NLOS_A_64M       12174       // 121.74 dB
+#define UWB_NLOS_DB100_LOG2  19728302    // 301.03 (0.01 dB per octave), 16.16
+
+// log2(1 + i / 32), 16.16 fixed point
+static const uint32_t uwb_nlos_log2_tab[33] = {
+    0,     2909,  5732,  8473,  11136, 13727, 16248, 18704,
+    21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+    38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+    52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+    65536,
+};
+
+static uwb_nlos_stats_t uwb_nlos_stats;
+
+int32_t uwb_nlos_db100(uint64_t x) {
+    uint32_t hi = (uint32_t)(x >> 32);
+    uint32_t n;
+    uint32_t t;
+    uint32_t i;
+    uint32_t frac;
+    uint32_t log2;
+
+    // n = position of the leading one, t = x normalised to 1.31
+    if (hi != 0) {
+        n = 63 - __CLZ(hi);
+    } else {
+        n = 31 - __CLZ((uint32_t)x);
+    }
+    t = (n >= 31) ? (uint32_t)(x >> (n - 31)) : ((uint32_t)x << (31 - n));
+
+    // 32 segment table, linear in between
+    i = (t >> 26) & 31;
+    frac = (t >> 10) & 0xFFFF;
+    log2 = (n << 16) + uwb_nlos_log2_tab[i] +
+           (((uwb_nlos_log2_tab[i + 1] - uwb_nlos_log2_tab[i]) * frac) >> 16);
+
+    return (int32_t)(((uint64_t)log2 * UWB_NLOS_DB100_LOG2 + (1ULL << 31)) >>
+                     32);
+}
+
+static int16_t uwb_nlos_clamp16(int32_t v) {
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+void uwb_nlos_estimate(const dwt_rxdiag_t *diag, uint8_t prf, uwb_nlos_t *out) {
+    uint32_t start = DWT->CYCCNT;
+    uint64_t fp;
+    int32_t base;
+    int32_t fp_db;
+    int32_t rx_db;
+    int32_t gap;
+
+    fp = (uint64_t)diag->firstPathAmp1 * diag->firstPathAmp1 +
+         (uint64_t)diag->firstPathAmp2 * diag->firstPathAmp2 +
+         (uint64_t)diag->firstPathAmp3 * diag->firstPathAmp3;
+    if (fp == 0 || diag->maxGrowthCIR == 0 || diag->rxPreamCount == 0) {
+        out->fp_power = INT16_MIN;
+        out->rx_power = INT16_MIN;
+        out->likelihood = UWB_NLOS_UNKNOWN;
+        return;
+    }
+
+    // common term: -20 log10(N) - A
+    base = -2 * uwb_nlos_db100(diag->rxPreamCount) -
+           ((prf == DWT_PRF_16M) ? UWB_NLOS_A_16M : UWB_NLOS_A_64M);
+    fp_db = uwb_nlos_db100(fp) + base;
+    rx_db = uwb_nlos_db100((uint64_t)diag->maxGrowthCIR << 17) + base;
+    out->fp_power = uwb_nlos_clamp16(fp_db);
+    out->rx_power = uwb_nlos_clamp16(rx_db);
+
+    gap = rx_db - fp_db;
+    if (gap <= UWB_NLOS_LOS_DB100) {
+        out->likelihood = 0;
+    } else if (gap >= UWB_NLOS_NLOS_DB100) {
+        out->likelihood = 100;
+    } else {
+        out->likelihood = (uint8_t)((gap - UWB_NLOS_LOS_DB100) * 100 /
+                                    (UWB_NLOS_NLOS_DB100 - UWB_NLOS_LOS_DB100));
+    }
+
+    uwb_nlos_stats.count++;
+    if (out->likelihood >= 50) {
+        uwb_nlos_stats.nlos++;
+    }
+    start = DWT->CYCCNT - start;
+    if (start > uwb_nlos_stats.cycles_max) {
+        uwb_nlos_stats.cycles_max = start;
+    }
+}
+
+void uwb_nlos_get_stats(uwb_nlos_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uwb_nlos_stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,49 @@
+#ifndef UWB_NLOS_H
+#define UWB_NLOS_H
+
+#include <stdint.h>
+
+#include "deca_device_api.h"
+
+/* Signal power estimates and NLOS likelihood from the RX diagnostics of one
+ * frame, integer only (about 27 ns per call on an x86 host, Tools/uwb_nlos;
+ * on the target uwb_nlos_get_stats() reports the longest call in cycles):
+ *
+ *   first path power = 10 log10((F1^2 + F2^2 + F3^2) / N^2) - A
+ *   RX power         = 10 log10(C * 2^17 / N^2) - A
+ *
+ * with F1..F3 the first path amplitudes, C the CIR power (maxGrowthCIR), N
+ * the preamble accumulation count and A = 113.77 dB at 16 MHz PRF, 121.74 dB
+ * at 64 MHz. Both are in 0.01 dBm. N is used as read; the RXPACC correction
+ * for the non-standard SFD is not applied, it shifts both by the same amount.
+ *
+ * In line of sight nearly all the received energy is in the first path. A gap
+ * between RX and first path power below UWB_NLOS_LOS_DB100 is taken as LOS, a
+ * gap above UWB_NLOS_NLOS_DB100 as NLOS and the likelihood rises linearly in
+ * between. */
+#define UWB_NLOS_LOS_DB100   600     // 6 dB
+#define UWB_NLOS_NLOS_DB100  1000    // 10 dB
+#define UWB_NLOS_UNKNOWN     0xFF    // likelihood of a frame without diagnostics
+
+typedef struct {
+    int16_t fp_power;      // first path power, 0.01 dBm
+    int16_t rx_power;      // total RX power, 0.01 dBm
+    uint8_t likelihood;    // NLOS likelihood, 0 (LOS) to 100 (NLOS) percent
+} uwb_nlos_t;
+
+typedef struct {
+    uint32_t count;        // frames estimated
+    uint32_t nlos;         // of which likelihood >= 50
+    uint32_t cycles_max;   // longest uwb_nlos_estimate() in core cycles
+} uwb_nlos_stats_t;
+
+/* Estimate the powers and the NLOS likelihood of a frame. prf is the RX PRF,
+ * see dwt_getrxprf(). */
+void uwb_nlos_estimate(const dwt_rxdiag_t *diag, uint8_t prf, uwb_nlos_t *out);
+
+/* 10 log10(x) in 0.01 dB, x > 0. Within 0.01 dB of the exact value. */
+int32_t uwb_nlos_db100(uint64_t x);
+
+void uwb_nlos_get_stats(uwb_nlos_stats_t *stats);
+
+#endif /* UWB_NLOS_H */
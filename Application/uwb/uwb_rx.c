@@ -0,0 +1,156 @@
+#include "uwb_rx.h"
+
+#include "deca_irq.h"
+#include "gd32f4xx.h"
+#include "log.h"
+#include "task.h"
+#include "uwb_cir.h"
+
+#define UWB_RX_STACK_WORDS 256
+#define UWB_RX_RING_MASK   (UWB_RX_RING_LEN - 1)
+
+#define UWB_RX_INT_MASK                                                  \
+    (DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL |         \
+     DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_SFDT | DWT_INT_ARFE |        \
+     DWT_INT_RXOVRR)
+
+#if (UWB_RX_RING_LEN & UWB_RX_RING_MASK) != 0
+#error "UWB_RX_RING_LEN must be a power of two"
+#endif
+
+/* Single producer (engine task) / single consumer ring of pool blocks. head is
+ * only written by the producer and tail only by the consumer, so no lock is
+ * needed; the barriers order the entries against the index updates. */
+static uwb_frame_t *uwb_rx_ring[UWB_RX_RING_LEN];
+static volatile uint32_t uwb_rx_head;
+static volatile uint32_t uwb_rx_tail;
+static TaskHandle_t volatile uwb_rx_consumer;
+
+static uwb_rx_stats_t uwb_rx_stats;
+
+/* dwt_isr() does not re-enable the receiver. It is turned on again without
+ * syncing the buffer pointers: the next frame lands in the other device
+ * buffer while the current one is read, and dwt_isr() hands that buffer to the
+ * host once the callback returns. */
+static void uwb_rx_rearm(void) {
+    dwt_rxenable(DWT_START_RX_IMMEDIATE | DWT_NO_SYNC_PTRS);
+}
+
+static void uwb_rx_ok_cb(const dwt_cb_data_t *cb) {
+    uint32_t head = uwb_rx_head;
+    uwb_frame_t *frame;
+    TaskHandle_t consumer;
+    int cir;
+
+    if (cb->datalength > UWB_FRAME_LEN_MAX) {
+        uwb_rx_rearm();
+        uwb_rx_stats.error++;
+        return;
+    }
+    if (head - uwb_rx_tail >= UWB_RX_RING_LEN ||
+        (frame = uwb_frame_alloc()) == NULL) {
+        uwb_rx_rearm();
+        uwb_rx_stats.dropped++;
+        return;
+    }
+
+    // the accumulator is not double buffered, a frame picked for CIR capture
+    // keeps the receiver off until its window has been read
+    cir = uwb_cir_select();
+    if (!cir) {
+        uwb_rx_rearm();
+    }
+
+    frame->length = cb->datalength;
+    for (int i = 0; i < 5; i++) {
+        frame->rx_stamp[i] = cb->rx_stamp[i];
+    }
+    dwt_readdiagnostics(&frame->diag);
+    uwb_nlos_estimate(&frame->diag, dwt_getrxprf(), &frame->nlos);
+    if (cir) {
+        uwb_cir_capture(frame);
+        uwb_rx_rearm();
+    }
+    // the frame body is DMA'd by the SPI port directly into the pool block
+    dwt_readrxdata(frame->data, frame->length, 0);
+
+    uwb_rx_ring[head & UWB_RX_RING_MASK] = frame;
+    __DMB();
+    uwb_rx_head = head + 1;
+    uwb_rx_stats.good++;
+
+    consumer = uwb_rx_consumer;
+    if (consumer != NULL) {
+        xTaskNotifyGive(consumer);
+    }
+}
+
+static void uwb_rx_to_cb(const dwt_cb_data_t *cb) {
+    (void)cb;
+    uwb_rx_stats.timeout++;
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+static void uwb_rx_err_cb(const dwt_cb_data_t *cb) {
+    if (cb->status & DWT_INT_RXOVRR) {
+        uwb_rx_stats.overrun++;
+        LOG("uwb rx overrun, status %08x", cb->status);
+    } else {
+        uwb_rx_stats.error++;
+    }
+    // dwt_isr() has reset the receiver, restart it with the buffer pointers
+    // resynchronised
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+static void uwb_rx_task(void *pvParameters) {
+    decaselectdevice((unsigned int)(uintptr_t)pvParameters);
+
+    dwt_setcallbacks(NULL, uwb_rx_ok_cb, uwb_rx_to_cb, uwb_rx_err_cb);
+    dwt_setdblrxbuffmode(1);
+    dwt_setinterrupt(UWB_RX_INT_MASK, 1);
+    deca_irq_init(xTaskGetCurrentTaskHandle());
+
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // the IRQ line stays high until every enabled event is cleared
+        do {
+            dwt_isr();
+        } while (deca_irq_active());
+    }
+}
+
+int uwb_rx_start(UBaseType_t priority) {
+    // the engine works with the DW1000 selected by the caller
+    if (xTaskCreate(uwb_rx_task, "UwbRx", UWB_RX_STACK_WORDS,
+                    (void *)(uintptr_t)decadeviceindex(), priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+uwb_frame_t *uwb_rx_receive(TickType_t timeout) {
+    uwb_frame_t *frame;
+
+    uwb_rx_consumer = xTaskGetCurrentTaskHandle();
+
+    while (uwb_rx_head == uwb_rx_tail) {
+        if (ulTaskNotifyTake(pdTRUE, timeout) == 0) {
+            return NULL;
+        }
+    }
+    __DMB();
+    frame = uwb_rx_ring[uwb_rx_tail & UWB_RX_RING_MASK];
+    __DMB();
+    uwb_rx_tail = uwb_rx_tail + 1;
+    return frame;
+}
+
+void uwb_rx_get_stats(uwb_rx_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uwb_rx_stats;
+    taskEXIT_CRITICAL();
+}
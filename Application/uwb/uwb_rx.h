@@ -0,0 +1,36 @@
+#ifndef UWB_RX_H
+#define UWB_RX_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "uwb_frame_pool.h"
+
+#define UWB_RX_RING_LEN 8    // frames, must be a power of two
+
+typedef struct {
+    uint32_t good;       // frames received with good CRC
+    uint32_t timeout;    // RX timeouts
+    uint32_t error;      // PHY header / CRC / sync loss / rejected frames
+    uint32_t overrun;    // DW1000 RX overruns, both device buffers full
+    uint32_t dropped;    // good frames lost because the ring or pool was full
+} uwb_rx_stats_t;
+
+/* Start the interrupt driven receive engine. The DW1000 must already be
+ * initialised and configured; the engine task works with the device selected
+ * by the caller (decaselectdevice()). It runs the receiver in double buffered
+ * mode, re-enabling it at the start of each good frame callback so the next
+ * frame can arrive in the other device buffer, and reads every good frame
+ * straight into a pool block, queued in a ring of UWB_RX_RING_LEN entries. When enabled with uwb_cir_start(), the
+ * frame's CIR window is captured and streamed as well. */
+int uwb_rx_start(UBaseType_t priority);
+
+/* Wait for the next frame, or NULL on timeout. The caller receives the ring's
+ * reference and must drop it with uwb_frame_unref() (possibly after passing
+ * extra references to other stages). The ring is single consumer: only one
+ * task may call this. */
+uwb_frame_t *uwb_rx_receive(TickType_t timeout);
+
+void uwb_rx_get_stats(uwb_rx_stats_t *stats);
+
+#endif /* UWB_RX_H */
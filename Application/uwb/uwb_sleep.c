@@ -0,0 +1,92 @@
+#include "uwb_sleep.h"
+
+#include "deca_device_api.h"
+#include "gd32f4xx.h"
+#include "task.h"
+
+static uwb_sleep_config_t uwb_sleep_cfg;
+static uint16_t uwb_sleep_cs_len;
+static uint16_t uwb_sleep_max_polls;
+static uint8_t uwb_sleep_cs_buf[UWB_SLEEP_CS_BUF_LEN];
+static uwb_sleep_stats_t uwb_sleep_stats;
+
+void uwb_sleep_init(const uwb_sleep_config_t *cfg) {
+    uint32_t len;
+    uint32_t polls;
+
+    uwb_sleep_cfg = *cfg;
+
+    // bytes go back to back: 8 SPI clocks each, 25% margin on the pulse
+    len = (uwb_sleep_cfg.wake_spi_hz / 8) * UWB_SLEEP_CS_US / 1000000;
+    len += len / 4 + 1;
+    uwb_sleep_cs_len = (len > UWB_SLEEP_CS_BUF_LEN) ? UWB_SLEEP_CS_BUF_LEN
+                                                    : (uint16_t)len;
+    // a SYS_STATUS read is 5 bytes
+    polls = (uwb_sleep_cfg.wake_spi_hz / 40) * (UWB_SLEEP_PLL_US / 1000) /
+            1000;
+    uwb_sleep_max_polls = (polls > 0xFFFF) ? 0xFFFF
+                                           : (uint16_t)((polls > 0) ? polls : 1);
+
+    // the device keeps its sleep enable across wake ups, so this is done once
+    dwt_configuresleep(DWT_PRESRV_SLEEP | DWT_CONFIG | uwb_sleep_cfg.mode,
+                       DWT_WAKE_CS | DWT_SLP_EN | uwb_sleep_cfg.wake);
+}
+
+void uwb_sleep_enter(void) {
+    dwt_entersleep();
+
+    taskENTER_CRITICAL();
+    uwb_sleep_stats.sleeps++;
+    taskEXIT_CRITICAL();
+}
+
+int uwb_sleep_wake(void) {
+    uint32_t start = DWT->CYCCNT;
+    decaIrqStatus_t s;
+    int polls;
+    int writes = DWT_ERROR;
+
+    // nobody else may use the bus while it runs slow, nor see the device
+    // before its configuration is back
+    s = decamutexon();
+    if (uwb_sleep_cfg.spi_slow != NULL) {
+        uwb_sleep_cfg.spi_slow(1);
+    }
+    polls = dwt_spicswakeuppoll(uwb_sleep_cs_buf, uwb_sleep_cs_len,
+                                uwb_sleep_max_polls);
+    if (uwb_sleep_cfg.spi_slow != NULL) {
+        uwb_sleep_cfg.spi_slow(0);
+    }
+    if (polls != DWT_ERROR) {
+        writes = dwt_restoreconfig();
+    }
+    decamutexoff(s);
+    start = DWT->CYCCNT - start;
+
+    taskENTER_CRITICAL();
+    if (writes == DWT_ERROR) {
+        uwb_sleep_stats.wake_errors++;
+    } else {
+        uwb_sleep_stats.wakes++;
+        uwb_sleep_stats.restore_writes = (uint32_t)writes;
+        if ((uint32_t)polls > uwb_sleep_stats.polls_max) {
+            uwb_sleep_stats.polls_max = (uint32_t)polls;
+        }
+        uwb_sleep_stats.ready_cycles = start;
+        if (start > uwb_sleep_stats.ready_cycles_max) {
+            uwb_sleep_stats.ready_cycles_max = start;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return (writes == DWT_ERROR) ? -1 : 0;
+}
+
+void uwb_sleep_get_stats(uwb_sleep_stats_t *stats, int reset) {
+    taskENTER_CRITICAL();
+    *stats = uwb_sleep_stats;
+    if (reset) {
+        uwb_sleep_stats.polls_max = 0;
+        uwb_sleep_stats.ready_cycles_max = 0;
+    }
+    taskEXIT_CRITICAL();
+}
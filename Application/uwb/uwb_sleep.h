@@ -0,0 +1,53 @@
+#ifndef UWB_SLEEP_H
+#define UWB_SLEEP_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+
+/* DW1000 sleep/wake for duty cycled tags. The device is woken with the chip
+ * select, the clock PLL lock is polled instead of waiting a fixed 5 ms and
+ * everything the device held before sleeping is written back from the driver
+ * shadows in one SPI burst. dwt_initialise() is not called on wake: its state
+ * and the OTP words it read stay in MCU RAM. Only if the MCU lost its RAM,
+ * hand the words saved with dwt_getotpcache() to dwt_setotpcache() and call
+ * dwt_initialise(DWT_DW_WAKE_UP | ...), which then reads no OTP either. */
+#define UWB_SLEEP_CS_US       500    // chip select low time that wakes the device
+#define UWB_SLEEP_PLL_US      5000   // give up waiting for the PLL lock after that
+#define UWB_SLEEP_CS_BUF_LEN  320    // dummy read holding the chip select low
+
+typedef struct {
+    uint16_t mode;             // extra on-wake flags (DWT_TANDV, DWT_LOADOPSET...),
+                               // DWT_PRESRV_SLEEP and DWT_CONFIG are always set
+    uint8_t wake;              // extra wake sources (DWT_WAKE_SLPCNT, DWT_WAKE_WK),
+                               // DWT_WAKE_CS and DWT_SLP_EN are always set
+    uint32_t wake_spi_hz;      // SPI clock while waking, sizes the chip select pulse
+    void (*spi_slow)(int slow);    // bus below 3 MHz while waking and back,
+                                   // NULL if it always is
+} uwb_sleep_config_t;
+
+typedef struct {
+    uint32_t sleeps;
+    uint32_t wakes;
+    uint32_t wake_errors;      // PLL did not lock or the restore failed
+    uint32_t polls_max;        // SYS_STATUS reads until the PLL locked
+    uint32_t restore_writes;   // register writes of the last restore burst
+    uint32_t ready_cycles;     // core cycles from the wake up to TX ready, last
+    uint32_t ready_cycles_max;
+} uwb_sleep_stats_t;
+
+/* Set up the sleep configuration of the DW1000 selected by the caller. Call
+ * once after dwt_initialise(), dwt_configure() and the TX settings. */
+void uwb_sleep_init(const uwb_sleep_config_t *cfg);
+
+/* Put the device to sleep. The transceiver must be idle. */
+void uwb_sleep_enter(void);
+
+/* Wake the device up and restore its configuration. Returns 0 when it is
+ * ready to load and send a frame, -1 on failure (the device then needs a
+ * dwt_initialise() and dwt_configure()). */
+int uwb_sleep_wake(void);
+
+void uwb_sleep_get_stats(uwb_sleep_stats_t *stats, int reset);
+
+#endif /* UWB_SLEEP_H */
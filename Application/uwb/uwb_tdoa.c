@@ -0,0 +1,159 @@
+#include "uwb_tdoa.h"
+
+#include "task.h"
+#include "uwb_clksync.h"
+#include "uwb_rx.h"
+#include "uwb_telemetry.h"
+#include "uwb_xtaltrim.h"
+
+#define UWB_TDOA_PAYLOAD_MAX \
+    (UWB_TLM_TDOA_HEADER_LEN + UWB_TDOA_BATCH_LEN * UWB_TDOA_REC_LEN)
+
+#define BLINK_FCTRL   0xC5
+#define BLINK_SEQ     1
+#define BLINK_ID      2
+#define BLINK_LEN_MIN 12    // fctrl(1) seq(1) id(8) fcs(2)
+
+#if UWB_TDOA_BATCH_LEN > 255
+#error "UWB_TDOA_BATCH_LEN must fit the 8-bit count field"
+#endif
+
+/* busy is set by the anchor task and cleared by the UART DMA completion. */
+typedef struct {
+    uint8_t payload[UWB_TDOA_PAYLOAD_MAX];
+    volatile uint8_t busy;
+} uwb_tdoa_batch_t;
+
+static uwb_tdoa_batch_t uwb_tdoa_batches[UWB_TDOA_BATCH_POOL];
+static uwb_tdoa_batch_t *uwb_tdoa_cur;    // batch being filled, or NULL
+static uint8_t uwb_tdoa_count;
+static uint16_t uwb_tdoa_timebase;        // of the current batch
+static TickType_t uwb_tdoa_first_tick;    // first blink of the current batch
+static uint16_t uwb_tdoa_batch_seq;
+static uwb_tdoa_stats_t uwb_tdoa_stats;
+
+static void uwb_tdoa_sent(void *arg) {
+    ((uwb_tdoa_batch_t *)arg)->busy = 0;
+}
+
+static uwb_tdoa_batch_t *uwb_tdoa_batch_alloc(void) {
+    for (int i = 0; i < UWB_TDOA_BATCH_POOL; i++) {
+        if (!uwb_tdoa_batches[i].busy) {
+            uwb_tdoa_batches[i].busy = 1;
+            return &uwb_tdoa_batches[i];
+        }
+    }
+    return NULL;
+}
+
+static void uwb_tdoa_flush(void) {
+    uint8_t *p;
+
+    if (uwb_tdoa_cur == NULL || uwb_tdoa_count == 0) {
+        return;
+    }
+    p = uwb_tdoa_cur->payload;
+    p[0] = (uint8_t)uwb_tdoa_batch_seq;
+    p[1] = (uint8_t)(uwb_tdoa_batch_seq >> 8);
+    p[2] = uwb_tdoa_count;
+    p[3] = UWB_TDOA_REC_LEN;
+    p[4] = (uint8_t)uwb_tdoa_timebase;
+    p[5] = (uint8_t)(uwb_tdoa_timebase >> 8);
+    p[6] = 0;
+    p[7] = 0;
+    uwb_tdoa_batch_seq++;
+
+    // busy is cleared by uwb_tdoa_sent() in every case
+    if (uwb_telemetry_send_tdoa(p, UWB_TLM_TDOA_HEADER_LEN +
+                                       uwb_tdoa_count * UWB_TDOA_REC_LEN,
+                                uwb_tdoa_sent, uwb_tdoa_cur) != 0) {
+        uwb_tdoa_stats.uart_full++;
+    } else {
+        uwb_tdoa_stats.batches++;
+    }
+    uwb_tdoa_cur = NULL;
+    uwb_tdoa_count = 0;
+}
+
+static void uwb_tdoa_record(const uwb_frame_t *frame) {
+    uint8_t *rec;
+    int32_t level;
+    uwb_ts_t stamp = uwb_ts_from_bytes(frame->rx_stamp);
+    uint16_t timebase;
+
+    if (frame->length < BLINK_LEN_MIN || frame->data[0] != BLINK_FCTRL) {
+        if (uwb_clksync_rx(frame)) {
+            // the reference's carrier also drives crystal trim tuning
+            uwb_xtaltrim_feed_carrier(frame->diag.carrierIntegrator);
+        } else {
+            uwb_tdoa_stats.other++;
+        }
+        return;
+    }
+
+    // a batch holds stamps of one timebase, close it when the lock changes
+    timebase = uwb_clksync_convert_primary(stamp, &stamp);
+    if (uwb_tdoa_count > 0 && timebase != uwb_tdoa_timebase) {
+        uwb_tdoa_flush();
+    }
+    if (uwb_tdoa_cur == NULL) {
+        uwb_tdoa_cur = uwb_tdoa_batch_alloc();
+        if (uwb_tdoa_cur == NULL) {
+            uwb_tdoa_stats.dropped++;
+            return;
+        }
+        uwb_tdoa_first_tick = xTaskGetTickCount();
+        uwb_tdoa_timebase = timebase;
+    }
+
+    rec = &uwb_tdoa_cur->payload[UWB_TLM_TDOA_HEADER_LEN +
+                                 uwb_tdoa_count * UWB_TDOA_REC_LEN];
+    for (int i = 0; i < 8; i++) {
+        rec[i] = frame->data[BLINK_ID + i];
+    }
+    uwb_ts_to_bytes(stamp, &rec[8]);
+    rec[13] = frame->data[BLINK_SEQ];
+    rec[14] = frame->nlos.likelihood;
+
+    // 0.01 dBm to whole -dBm, rounded
+    level = (frame->nlos.likelihood == UWB_NLOS_UNKNOWN)
+                ? 0
+                : (50 - frame->nlos.rx_power) / 100;
+    rec[15] = (uint8_t)((level > 255) ? 255 : (level < 0) ? 0 : level);
+
+    uwb_tdoa_stats.blinks++;
+    if (++uwb_tdoa_count == UWB_TDOA_BATCH_LEN) {
+        uwb_tdoa_flush();
+    }
+}
+
+void uwb_tdoa_anchor_run(void) {
+    const TickType_t flush = pdMS_TO_TICKS(UWB_TDOA_FLUSH_MS);
+    TickType_t wait;
+    TickType_t age;
+    uwb_frame_t *frame;
+
+    while (1) {
+        wait = portMAX_DELAY;
+        if (uwb_tdoa_count > 0) {
+            age = xTaskGetTickCount() - uwb_tdoa_first_tick;
+            if (age >= flush) {
+                uwb_tdoa_flush();
+                continue;
+            }
+            wait = flush - age;
+        }
+
+        frame = uwb_rx_receive(wait);
+        if (frame != NULL) {
+            uwb_tdoa_record(frame);
+            uwb_frame_unref(frame);
+        }
+    }
+}
+
+void uwb_tdoa_get_stats(uwb_tdoa_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = uwb_tdoa_stats;
+    taskEXIT_CRITICAL();
+}
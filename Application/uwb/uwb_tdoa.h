@@ -0,0 +1,52 @@
+#ifndef UWB_TDOA_H
+#define UWB_TDOA_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+
+/* TDoA anchor. Tag blinks (IEEE 802.15.4 blink frames, frame control 0xC5,
+ * sequence number, 64-bit tag ID) delivered by the receive engine are reduced
+ * to fixed size records and batched into UWB_TLM_TYPE_TDOA telemetry records
+ * of up to UWB_TDOA_BATCH_LEN blinks. A full batch is 552 bytes on the wire,
+ * about 17 bytes per blink, so the 921600 baud UART carries some 5000
+ * blinks/s. Batches go out zero-copy from UWB_TDOA_BATCH_POOL buffers; a
+ * partial batch is sent once its first blink is UWB_TDOA_FLUSH_MS old.
+ *
+ * Clock sync frames are passed to uwb_clksync_rx(), and their carrier
+ * integrator to uwb_xtaltrim_feed_carrier() (ignored unless
+ * uwb_xtaltrim_start() was called). While the model of the primary reference
+ * (the first one given to uwb_clksync_follow()) is locked, blink stamps are
+ * converted to its timebase; every stamp in a batch is in the timebase named
+ * in the batch header.
+ *
+ * Blink record, 16 bytes, little endian:
+ *
+ *   0  tag_id      64-bit tag ID as carried in the blink
+ *   8  rx_stamp    40-bit RX timestamp, device time units, in the timebase
+ *                  of the batch
+ *  13  seq         blink sequence number
+ *  14  nlos        NLOS likelihood 0..100 %, 0xFF if unknown (uwb_nlos.h)
+ *  15  rx_level    RX power as -dBm, 0 if unknown */
+#define UWB_TDOA_REC_LEN     16
+#define UWB_TDOA_BATCH_LEN   32      // blinks per batch, at most 255
+#define UWB_TDOA_BATCH_POOL  3       // batches in flight on the UART
+#define UWB_TDOA_FLUSH_MS    20
+
+typedef struct {
+    uint32_t blinks;       // blinks recorded
+    uint32_t other;        // frames that were neither blinks nor clock syncs
+    uint32_t dropped;      // blinks lost because every batch buffer was busy
+    uint32_t batches;      // batches queued on the UART
+    uint32_t uart_full;    // batches the UART queue refused
+} uwb_tdoa_stats_t;
+
+/* Run the anchor in the calling task, consuming the frames of the receive
+ * engine (uwb_rx_receive() is single consumer, so nothing else may read
+ * them). uwb_rx_start() and uwb_telemetry_init() must have been called.
+ * Never returns. */
+void uwb_tdoa_anchor_run(void);
+
+void uwb_tdoa_get_stats(uwb_tdoa_stats_t *stats);
+
+#endif /* UWB_TDOA_H */
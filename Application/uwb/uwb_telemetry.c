@@ -0,0 +1,183 @@
+#include "uwb_telemetry.h"
+
+#include "freertos.h"
+#include "gd32f4xx.h"
+#include "semphr.h"
+#include "task.h"
+
+static uint8_t uwb_tlm_seq;
+static SemaphoreHandle_t uwb_tlm_lock;
+
+static void uwb_tlm_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/* Feed bytes to the CRC unit as little endian words, zero padding the last
+ * one. Must run with the unit reset and inside the caller's critical section. */
+static void uwb_tlm_crc_feed(const uint8_t *data, uint32_t len) {
+    uint32_t word;
+
+    while (len >= 4) {
+        word = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+               ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        CRC_DATA = word;
+        data += 4;
+        len -= 4;
+    }
+    if (len > 0) {
+        word = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            word |= (uint32_t)data[i] << (8 * i);
+        }
+        CRC_DATA = word;
+    }
+}
+
+static void uwb_tlm_frame_sent(void *arg) {
+    uwb_frame_unref((uwb_frame_t *)arg);
+}
+
+void uwb_telemetry_init(void) {
+    rcu_periph_clock_enable(RCU_CRC);
+    if (uwb_tlm_lock == NULL) {
+        uwb_tlm_lock = xSemaphoreCreateMutex();
+    }
+}
+
+/* Queue a record with a zero-copy payload. frame fills the stamp, nlos and
+ * diagnostic fields, which stay zero when it is NULL. done(arg) is always
+ * called, by the DMA completion once the payload has been sent or right here
+ * if it could not be queued. */
+static int uwb_tlm_send_zc(uint8_t type, const uwb_frame_t *frame,
+                           const uint8_t *payload, uint16_t len,
+                           uart_tx_done_t done, void *arg) {
+    uint8_t header[UWB_TLM_HEADER_LEN];
+    uint8_t trailer[3 + UWB_TLM_CRC_LEN];
+    uint32_t pad = (4 - (len & 3)) & 3;
+    uint32_t crc;
+    int ret;
+
+    xSemaphoreTake(uwb_tlm_lock, portMAX_DELAY);
+    header[0] = UWB_TLM_SYNC0;
+    header[1] = UWB_TLM_SYNC1;
+    header[2] = type;
+    header[3] = uwb_tlm_seq++;
+    uwb_tlm_put16(&header[4], len);
+    for (int i = 6; i < UWB_TLM_HEADER_LEN; i++) {
+        header[i] = 0;
+    }
+    if (frame != NULL) {
+        for (int i = 0; i < 5; i++) {
+            header[6 + i] = frame->rx_stamp[i];
+        }
+        header[11] = frame->nlos.likelihood;
+        uwb_tlm_put16(&header[12], frame->diag.firstPath);
+        uwb_tlm_put16(&header[14], frame->diag.firstPathAmp1);
+        uwb_tlm_put16(&header[16], frame->diag.firstPathAmp2);
+        uwb_tlm_put16(&header[18], frame->diag.firstPathAmp3);
+        uwb_tlm_put16(&header[20], frame->diag.stdNoise);
+        uwb_tlm_put16(&header[22], frame->diag.maxGrowthCIR);
+        uwb_tlm_put16(&header[24], frame->diag.rxPreamCount);
+        uwb_tlm_put16(&header[26], frame->diag.maxNoise);
+    }
+
+    // the CRC unit is shared, keep reset..read atomic
+    taskENTER_CRITICAL();
+    crc_data_register_reset();
+    uwb_tlm_crc_feed(header, UWB_TLM_HEADER_LEN);
+    uwb_tlm_crc_feed(payload, len);
+    crc = CRC_DATA;
+    taskEXIT_CRITICAL();
+
+    for (uint32_t i = 0; i < pad; i++) {
+        trailer[i] = 0;
+    }
+    trailer[pad + 0] = (uint8_t)crc;
+    trailer[pad + 1] = (uint8_t)(crc >> 8);
+    trailer[pad + 2] = (uint8_t)(crc >> 16);
+    trailer[pad + 3] = (uint8_t)(crc >> 24);
+
+    // all or nothing, a header without its payload and CRC would desync the
+    // reader
+    ret = uart_tx_write_wrapped(header, UWB_TLM_HEADER_LEN, payload, len, done,
+                                arg, trailer, pad + UWB_TLM_CRC_LEN);
+    xSemaphoreGive(uwb_tlm_lock);
+
+    if (ret != 0) {
+        done(arg);
+    }
+    return ret;
+}
+
+int uwb_telemetry_send_frame(uwb_frame_t *frame) {
+    return uwb_tlm_send_zc(UWB_TLM_TYPE_RX_FRAME, frame, frame->data,
+                           frame->length, uwb_tlm_frame_sent, frame);
+}
+
+int uwb_telemetry_send_cir(const uwb_frame_t *frame, const uint8_t *payload,
+                           uint16_t len, uart_tx_done_t done, void *arg) {
+    return uwb_tlm_send_zc(UWB_TLM_TYPE_CIR, frame, payload, len, done, arg);
+}
+
+int uwb_telemetry_send_tdoa(const uint8_t *payload, uint16_t len,
+                            uart_tx_done_t done, void *arg) {
+    return uwb_tlm_send_zc(UWB_TLM_TYPE_TDOA, NULL, payload, len, done, arg);
+}
+
+uint16_t uwb_telemetry_build_log(uint8_t *buf, uint32_t stamp,
+                                 const char *text, uint16_t len) {
+    uint32_t pad;
+    uint32_t crc;
+    uint16_t total;
+    UBaseType_t mask;
+
+    if (len > UWB_TLM_LOG_MAX) {
+        len = UWB_TLM_LOG_MAX;
+    }
+    pad = (4 - (len & 3)) & 3;
+
+    for (int i = 0; i < UWB_TLM_HEADER_LEN; i++) {
+        buf[i] = 0;
+    }
+    buf[0] = UWB_TLM_SYNC0;
+    buf[1] = UWB_TLM_SYNC1;
+    buf[2] = UWB_TLM_TYPE_LOG;
+    buf[3] = uwb_tlm_seq++;
+    uwb_tlm_put16(&buf[4], len);
+    buf[6] = (uint8_t)stamp;
+    buf[7] = (uint8_t)(stamp >> 8);
+    buf[8] = (uint8_t)(stamp >> 16);
+    buf[9] = (uint8_t)(stamp >> 24);
+    for (uint16_t i = 0; i < len; i++) {
+        buf[UWB_TLM_HEADER_LEN + i] = (uint8_t)text[i];
+    }
+    total = UWB_TLM_HEADER_LEN + len;
+    for (uint32_t i = 0; i < pad; i++) {
+        buf[total++] = 0;
+    }
+
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    crc_data_register_reset();
+    uwb_tlm_crc_feed(buf, total);
+    crc = CRC_DATA;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    buf[total++] = (uint8_t)crc;
+    buf[total++] = (uint8_t)(crc >> 8);
+    buf[total++] = (uint8_t)(crc >> 16);
+    buf[total++] = (uint8_t)(crc >> 24);
+    return total;
+}
+
+int uwb_telemetry_send_log(uint32_t stamp, const char *text, uint16_t len) {
+    static uint8_t record[UART_TX_STAGE_SIZE];    // guarded by uwb_tlm_lock
+    uint16_t total;
+    int ret;
+
+    xSemaphoreTake(uwb_tlm_lock, portMAX_DELAY);
+    total = uwb_telemetry_build_log(record, stamp, text, len);
+    ret = uart_tx_write_all(record, total);
+    xSemaphoreGive(uwb_tlm_lock);
+    return ret;
+}
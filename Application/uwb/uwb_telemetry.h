@@ -0,0 +1,95 @@
+#ifndef UWB_TELEMETRY_H
+#define UWB_TELEMETRY_H
+
+#include <stdint.h>
+
+#include "uart_tx.h"
+#include "uwb_frame_pool.h"
+
+/* Binary telemetry record, all fields little endian:
+ *
+ *   0  sync        0xA5 0x5A
+ *   2  type        UWB_TLM_TYPE_x
+ *   3  seq         record counter, wraps at 256
+ *   4  length      payload length in bytes
+ *   6  rx_stamp    40-bit RX timestamp, device time units
+ *  11  nlos        NLOS likelihood 0..100 %, 0xFF if unknown (uwb_nlos.h)
+ *  12  fp_index    first path index, 10.6 fixed point
+ *  14  fp_amp1     first path amplitudes 1..3
+ *  16  fp_amp2
+ *  18  fp_amp3
+ *  20  std_noise
+ *  22  cir_power   maxGrowthCIR
+ *  24  rx_pacc     preamble symbols accumulated
+ *  26  max_noise
+ *  28  payload     length bytes, zero padded to a multiple of 4
+ *   n  crc         CRC-32 over everything before it
+ *
+ * UWB_TLM_TYPE_LOG records carry a formatted log line as payload; their
+ * stamp field holds the 32-bit core cycle count at the log call and the
+ * nlos and diagnostic fields are zero.
+ *
+ * UWB_TLM_TYPE_CIR records carry the stamp and diagnostics of the frame and a
+ * window of its channel impulse response (see uwb_cir.h) as payload:
+ *
+ *   0  cir_seq     32-bit CIR counter, gaps show skipped captures
+ *   4  first_tap   accumulator index of the first tap in the window
+ *   6  taps        number of taps
+ *   8  samples     taps x (int16 real, int16 imaginary)
+ *
+ * UWB_TLM_TYPE_TDOA records batch tag blinks received by a TDoA anchor (see
+ * uwb_tdoa.h); stamp, nlos and diagnostic fields are zero and the payload is:
+ *
+ *   0  batch_seq   16-bit batch counter, gaps show lost batches
+ *   2  count       number of blink records
+ *   3  rec_len     bytes per blink record (UWB_TDOA_REC_LEN)
+ *   4  timebase    short address of the clock sync reference the stamps
+ *                  are converted to, 0xFFFF for the anchor's own clock
+ *   6  reserved    0
+ *   8  records     count x blink record
+ *
+ * The CRC is the one computed by the GD32 CRC unit: polynomial 0x04C11DB7,
+ * initial value 0xFFFFFFFF, no reflection and no final XOR. Each group of four
+ * bytes is fed as a little endian 32-bit word, most significant bit first. */
+#define UWB_TLM_SYNC0           0xA5
+#define UWB_TLM_SYNC1           0x5A
+#define UWB_TLM_HEADER_LEN      28
+#define UWB_TLM_CRC_LEN         4
+#define UWB_TLM_TYPE_RX_FRAME   0x01
+#define UWB_TLM_TYPE_LOG        0x02
+#define UWB_TLM_TYPE_CIR        0x03
+#define UWB_TLM_TYPE_TDOA       0x04
+#define UWB_TLM_CIR_HEADER_LEN  8
+#define UWB_TLM_TDOA_HEADER_LEN 8
+#define UWB_TLM_LOG_MAX         (UART_TX_STAGE_SIZE - UWB_TLM_HEADER_LEN - 3 - UWB_TLM_CRC_LEN)
+
+/* Records from different tasks are serialised, so they never interleave on
+ * the wire. */
+void uwb_telemetry_init(void);
+
+/* Queue one RX frame record on UART3. The payload goes out zero-copy from the
+ * frame block. Takes over the caller's reference to the frame in all cases.
+ * Returns 0, or -1 if the UART queue could not take the whole record. */
+int uwb_telemetry_send_frame(uwb_frame_t *frame);
+
+/* Queue one CIR record for a frame. The payload (UWB_TLM_CIR_HEADER_LEN bytes
+ * followed by the samples) goes out zero-copy and done(arg) is called once
+ * the UART no longer needs it, also when the record is refused. Returns 0, or
+ * -1 if the UART queue could not take the whole record. Task context only. */
+int uwb_telemetry_send_cir(const uwb_frame_t *frame, const uint8_t *payload,
+                           uint16_t len, uart_tx_done_t done, void *arg);
+
+/* Queue one TDoA blink batch record, zero-copy like uwb_telemetry_send_cir(). */
+int uwb_telemetry_send_tdoa(const uint8_t *payload, uint16_t len,
+                            uart_tx_done_t done, void *arg);
+
+/* Queue one log record. text is truncated to UWB_TLM_LOG_MAX bytes. Returns 0,
+ * or -1 if the UART could not take it. Task context only. */
+int uwb_telemetry_send_log(uint32_t stamp, const char *text, uint16_t len);
+
+/* Build a log record into buf (UART_TX_STAGE_SIZE bytes) and return its
+ * length. Used directly by fatal paths that write the UART by polling. */
+uint16_t uwb_telemetry_build_log(uint8_t *buf, uint32_t stamp,
+                                 const char *text, uint16_t len);
+
+#endif /* UWB_TELEMETRY_H */
@@ -0,0 +1,154 @@
+#include "uwb_tempcomp.h"
+
+#include "deca_device_api.h"
+#include "task.h"
+
+#define UWB_TEMPCOMP_STACK_WORDS 128
+#define UWB_TEMPCOMP_CONV_TICKS  (pdMS_TO_TICKS(1) + 1)    // SAR conversion, at least 1 ms
+
+static uwb_tempcomp_config_t uwb_tempcomp_cfg;
+static unsigned int uwb_tempcomp_dev;
+static volatile uint8_t uwb_tempcomp_pending;
+static uint8_t uwb_tempcomp_pend_temp;
+static uint32_t uwb_tempcomp_pend_power;
+static uwb_tempcomp_state_t uwb_tempcomp_st;
+
+static void tempcomp_task(void *pvParameters) {
+    TickType_t last = xTaskGetTickCount();
+    uint8_t target = 0;    // temperature of the newest settings, applied or not
+    int started = 0;
+    uint16_t sample;
+    uint8_t temp;
+    int delta;
+    uint32_t power;
+
+    decaselectdevice((unsigned int)(uintptr_t)pvParameters);
+
+    while (1) {
+        // fast SPI path: the bus is free while the SAR converts
+        dwt_starttempvbat();
+        vTaskDelay(UWB_TEMPCOMP_CONV_TICKS);
+        sample = dwt_finishtempvbat();
+        temp = (uint8_t)(sample >> 8);
+
+        taskENTER_CRITICAL();
+        uwb_tempcomp_st.temp_raw = temp;
+        uwb_tempcomp_st.vbat_raw = (uint8_t)sample;
+        uwb_tempcomp_st.samples++;
+        taskEXIT_CRITICAL();
+
+        if (!started) {
+            if (uwb_tempcomp_cfg.ref_temp == 0) {
+                uwb_tempcomp_cfg.ref_temp = temp;
+            }
+            target = uwb_tempcomp_cfg.ref_temp;
+            uwb_tempcomp_st.applied_temp = target;
+            uwb_tempcomp_pend_temp = target;
+            uwb_tempcomp_pend_power = uwb_tempcomp_cfg.ref_power;
+            // the PG count reference is taken at the first idle point
+            uwb_tempcomp_pending = uwb_tempcomp_cfg.track_pgdly &&
+                                   uwb_tempcomp_cfg.ref_pgcount == 0;
+            started = 1;
+        }
+
+        delta = (int)temp - (int)target;
+        if (delta >= uwb_tempcomp_cfg.threshold ||
+            -delta >= uwb_tempcomp_cfg.threshold) {
+            // always from the reference, so errors do not add up over steps
+            power = dwt_calcpowertempadj(
+                uwb_tempcomp_cfg.chan, uwb_tempcomp_cfg.ref_power,
+                (int)temp - (int)uwb_tempcomp_cfg.ref_temp);
+            target = temp;
+
+            taskENTER_CRITICAL();
+            uwb_tempcomp_pend_temp = temp;
+            uwb_tempcomp_pend_power = power;
+            uwb_tempcomp_pending = 1;
+            uwb_tempcomp_st.updates++;
+            taskEXIT_CRITICAL();
+        }
+
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(uwb_tempcomp_cfg.period_ms));
+    }
+}
+
+int uwb_tempcomp_apply(void) {
+    dwt_txconfig_t tx;
+    decaIrqStatus_t s;
+    uint8_t temp;
+    uint16_t ref_pgcount = uwb_tempcomp_cfg.ref_pgcount;
+    int changed;
+
+    if (!uwb_tempcomp_pending ||
+        (unsigned int)decadeviceindex() != uwb_tempcomp_dev) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    temp = uwb_tempcomp_pend_temp;
+    tx.power = uwb_tempcomp_pend_power;
+    uwb_tempcomp_pending = 0;
+    taskEXIT_CRITICAL();
+    tx.PGdly = uwb_tempcomp_st.pgdly;
+
+    // nobody else may use the bus while it runs slow or the clocks are moved
+    s = decamutexon();
+    if (uwb_tempcomp_cfg.track_pgdly) {
+        if (uwb_tempcomp_cfg.spi_slow != NULL) {
+            uwb_tempcomp_cfg.spi_slow(1);
+        }
+        if (ref_pgcount == 0) {
+            ref_pgcount = dwt_calcpgcount(uwb_tempcomp_cfg.ref_pgdly);
+        } else {
+            tx.PGdly = dwt_trackbandwidthtempadj(ref_pgcount, tx.PGdly,
+                                                 UWB_TEMPCOMP_PG_STEPS);
+        }
+        if (uwb_tempcomp_cfg.spi_slow != NULL) {
+            uwb_tempcomp_cfg.spi_slow(0);
+        }
+    }
+    // the PG count leaves its last trial in PG_DELAY, so always write both
+    dwt_configuretxrf(&tx);
+    decamutexoff(s);
+
+    uwb_tempcomp_cfg.ref_pgcount = ref_pgcount;
+    changed = (tx.PGdly != uwb_tempcomp_st.pgdly) ||
+              (tx.power != uwb_tempcomp_st.power);
+
+    taskENTER_CRITICAL();
+    uwb_tempcomp_st.applied_temp = temp;
+    uwb_tempcomp_st.pgdly = tx.PGdly;
+    uwb_tempcomp_st.power = tx.power;
+    uwb_tempcomp_st.ref_pgcount = ref_pgcount;
+    uwb_tempcomp_st.applied++;
+    taskEXIT_CRITICAL();
+    return changed;
+}
+
+int uwb_tempcomp_start(const uwb_tempcomp_config_t *cfg, UBaseType_t priority) {
+    uwb_tempcomp_cfg = *cfg;
+    if (uwb_tempcomp_cfg.period_ms == 0) {
+        uwb_tempcomp_cfg.period_ms = 1000;
+    }
+    if (uwb_tempcomp_cfg.threshold == 0) {
+        uwb_tempcomp_cfg.threshold = 1;
+    }
+    uwb_tempcomp_st.pgdly = uwb_tempcomp_cfg.ref_pgdly;
+    uwb_tempcomp_st.power = uwb_tempcomp_cfg.ref_power;
+    uwb_tempcomp_st.ref_pgcount = uwb_tempcomp_cfg.ref_pgcount;
+
+    // the task works with the DW1000 selected by the caller
+    uwb_tempcomp_dev = (unsigned int)decadeviceindex();
+    if (xTaskCreate(tempcomp_task, "UwbTemp", UWB_TEMPCOMP_STACK_WORDS,
+                    (void *)(uintptr_t)uwb_tempcomp_dev, priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+void uwb_tempcomp_get_state(uwb_tempcomp_state_t *state) {
+    taskENTER_CRITICAL();
+    *state = uwb_tempcomp_st;
+    taskEXIT_CRITICAL();
+}
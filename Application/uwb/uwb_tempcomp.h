@@ -0,0 +1,56 @@
+#ifndef UWB_TEMPCOMP_H
+#define UWB_TEMPCOMP_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+
+/* Temperature compensation of the TX spectrum. A task samples the DW1000
+ * temperature and battery voltage every period on the fast SPI path (two SPI
+ * batches, the bus is free during the 1 ms conversion). Once the temperature
+ * has moved by the threshold from the one the current settings were made
+ * for, TX_POWER is recomputed from the reference and an update is left
+ * pending. The engine owning the device applies it through
+ * uwb_tempcomp_apply() at a point where it neither transmits nor receives,
+ * so no frame sees a half written setting or a PG calibration. */
+#define UWB_TEMPCOMP_PG_STEPS 4    // PG_DELAY codes moved per update at most
+
+typedef struct {
+    uint16_t period_ms;        // sampling period
+    uint8_t threshold;         // raw temperature units (1.14 C) that trigger an update
+    uint8_t chan;              // 2 or 5, others keep the reference TX_POWER
+    uint8_t ref_pgdly;         // TX settings calibrated at the reference temperature,
+    uint32_t ref_power;        // programmed by the application before the start
+    uint8_t ref_temp;          // raw reference temperature, 0 for the first sample
+    uint16_t ref_pgcount;      // dwt_calcpgcount(ref_pgdly) at the reference temperature,
+                               // 0 to measure it at the first uwb_tempcomp_apply()
+    uint8_t track_pgdly;       // 0 to compensate TX_POWER only
+    void (*spi_slow)(int slow);    // bus below 3 MHz for the PG count and back,
+                                   // NULL if it always is
+} uwb_tempcomp_config_t;
+
+typedef struct {
+    uint8_t temp_raw;          // last sample, see dwt_convertrawtemperature()
+    uint8_t vbat_raw;          // see dwt_convertrawvoltage()
+    uint8_t applied_temp;      // raw temperature of the settings in use
+    uint8_t pgdly;             // settings in use
+    uint32_t power;
+    uint16_t ref_pgcount;
+    uint32_t samples;
+    uint32_t updates;          // settings recomputed
+    uint32_t applied;          // settings written to the device
+} uwb_tempcomp_state_t;
+
+/* Start the sampling task on the DW1000 selected by the caller. */
+int uwb_tempcomp_start(const uwb_tempcomp_config_t *cfg, UBaseType_t priority);
+
+/* Called by the engine driving the device between frames, with the
+ * transceiver idle. Writes a pending update in one SPI batch, after the
+ * PG_DELAY search when it is tracked (a few ms with the bus held). Returns 1
+ * if the settings changed. Cheap and a no-op when nothing is pending, when
+ * the service is not running or for another device. */
+int uwb_tempcomp_apply(void);
+
+void uwb_tempcomp_get_state(uwb_tempcomp_state_t *state);
+
+#endif /* UWB_TEMPCOMP_H */
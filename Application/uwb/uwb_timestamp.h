@@ -0,0 +1,104 @@
+#ifndef UWB_TIMESTAMP_H
+#define UWB_TIMESTAMP_H
+
+#include <stdint.h>
+
+/* DW1000 system time and timestamps are 40-bit counters of device time units
+ * (1 dtu = 1 / (128 * 499.2 MHz) ~ 15.65 ps), wrapping every ~17.2 s.
+ * uwb_ts_t keeps one in the low 40 bits of a uint64_t; differences are signed
+ * 64-bit dtu counts. Everything here is integer only, so it inlines to a few
+ * instructions on the Cortex-M4 and builds unchanged on a host. */
+typedef uint64_t uwb_ts_t;
+
+#define UWB_TS_BITS      40
+#define UWB_TS_MASK      ((uwb_ts_t)0xFFFFFFFFFFULL)
+#define UWB_TS_LEN       5           // bytes, as read from the device
+#define UWB_UUS_TO_DTU   65536       // 1 UWB microsecond = 512 / 499.2 us
+#define UWB_TX_DLY_MASK  ((uwb_ts_t)0x1FF)    // delayed TX ignores the low 9 bits
+
+// dtu -> ps, 16.16 fixed point (15.650040 ps)
+#define UWB_PS_PER_DTU_Q16   1025641
+// dtu -> mm of flight in air (c = 299702547 m/s), 16.16 fixed point (4.6904 mm)
+#define UWB_MM_PER_DTU_Q16   307387
+// mm -> dtu, 0.32 fixed point (0.2132034 dtu); 16 bits would be 36 mm off per km
+#define UWB_DTU_PER_MM_Q32   915701602
+
+/* Assemble a timestamp from the little endian bytes of dwt_readrxtimestamp(),
+ * dwt_readtxtimestamp() or dwt_cb_data_t.rx_stamp. */
+static inline uwb_ts_t uwb_ts_from_bytes(const uint8_t *b) {
+    return (uwb_ts_t)b[0] | ((uwb_ts_t)b[1] << 8) | ((uwb_ts_t)b[2] << 16) |
+           ((uwb_ts_t)b[3] << 24) | ((uwb_ts_t)b[4] << 32);
+}
+
+static inline void uwb_ts_to_bytes(uwb_ts_t ts, uint8_t *b) {
+    b[0] = (uint8_t)ts;
+    b[1] = (uint8_t)(ts >> 8);
+    b[2] = (uint8_t)(ts >> 16);
+    b[3] = (uint8_t)(ts >> 24);
+    b[4] = (uint8_t)(ts >> 32);
+}
+
+/* Rebuild a timestamp from the hi32 (bits 39..8) register read, as returned by
+ * dwt_readrxtimestamphi32()/dwt_readtxtimestamphi32(). The low 8 bits are 0. */
+static inline uwb_ts_t uwb_ts_from_hi32(uint32_t hi32) {
+    return (uwb_ts_t)hi32 << 8;
+}
+
+static inline uint32_t uwb_ts_lo32(uwb_ts_t ts) { return (uint32_t)ts; }
+
+/* ts + dtu, wrapped to 40 bits. dtu may be negative. */
+static inline uwb_ts_t uwb_ts_add(uwb_ts_t ts, int64_t dtu) {
+    return (ts + (uwb_ts_t)dtu) & UWB_TS_MASK;
+}
+
+/* a - b in dtu, taking the shorter way round the 40-bit wrap, so the result
+ * is correct as long as the two are less than ~8.6 s apart. */
+static inline int64_t uwb_ts_diff(uwb_ts_t a, uwb_ts_t b) {
+    uwb_ts_t d = (a - b) & UWB_TS_MASK;
+
+    return (int64_t)(d << (64 - UWB_TS_BITS)) >> (64 - UWB_TS_BITS);
+}
+
+/* Same for the 32-bit low halves carried in ranging messages; valid for
+ * intervals up to ~33 ms. */
+static inline int64_t uwb_ts_diff32(uint32_t a, uint32_t b) {
+    return (int64_t)(int32_t)(a - b);
+}
+
+static inline int64_t uwb_dtu_to_ps(int64_t dtu) {
+    return (dtu * UWB_PS_PER_DTU_Q16) >> 16;
+}
+
+static inline int64_t uwb_ps_to_dtu(int64_t ps) {
+    // exact ratio 4992 / 78125, intervals stay far below overflow
+    return ps * 4992 / 78125;
+}
+
+static inline int32_t uwb_dtu_to_mm(int64_t dtu) {
+    return (int32_t)((dtu * UWB_MM_PER_DTU_Q16) >> 16);
+}
+
+static inline int64_t uwb_mm_to_dtu(int32_t mm) {
+    return ((int64_t)mm * UWB_DTU_PER_MM_Q32) >> 32;
+}
+
+static inline int64_t uwb_uus_to_dtu(uint32_t uus) {
+    return (int64_t)uus * UWB_UUS_TO_DTU;
+}
+
+/* Delayed TX/RX: the device is programmed with bits 39..8 of the start time
+ * and ignores the low 9 bits, so a frame sent at "at" actually leaves at
+ * uwb_ts_delayed(at) and carries that plus the TX antenna delay. */
+static inline uint32_t uwb_ts_dly_reg(uwb_ts_t at) {
+    return (uint32_t)(at >> 8);
+}
+
+static inline uwb_ts_t uwb_ts_delayed(uwb_ts_t at) {
+    return at & ~UWB_TX_DLY_MASK & UWB_TS_MASK;
+}
+
+static inline uwb_ts_t uwb_ts_delayed_tx_stamp(uwb_ts_t at, uint16_t ant_dly) {
+    return uwb_ts_add(uwb_ts_delayed(at), ant_dly);
+}
+
+#endif /* UWB_TIMESTAMP_H */
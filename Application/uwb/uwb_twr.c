@@ -0,0 +1,402 @@
+#include "uwb_twr.h"
+
+#include "deca_device_api.h"
+#include "deca_irq.h"
+#include "deca_range_tables.h"
+#include "queue.h"
+#include "task.h"
+#include "uwb_clkoffset.h"
+#include "uwb_nlos.h"
+#include "uwb_tempcomp.h"
+#include "uwb_timestamp.h"
+
+#define UWB_TWR_STACK_WORDS  256
+#define UWB_TWR_RESULT_QUEUE 8
+#define UWB_TWR_WATCHDOG     pdMS_TO_TICKS(10)    // give up a stuck exchange
+
+#define UWB_TWR_INT_MASK                                                 \
+    (DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE |         \
+     DWT_INT_RFSL | DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_SFDT |        \
+     DWT_INT_ARFE)
+
+/* IEEE 802.15.4 data frames with short addresses:
+ * fctrl(2) seq(1) pan(2) dst(2) src(2) func(1) payload... fcs(2) */
+#define MSG_SEQ       2
+#define MSG_PAN       3
+#define MSG_DST       5
+#define MSG_SRC       7
+#define MSG_FUNC      9
+#define MSG_TS1       10
+#define MSG_TS2       14
+#define MSG_TS3       18
+#define MSG_FCS_LEN   2
+#define MSG_LEN_MAX   24
+
+#define FUNC_POLL     0x21
+#define FUNC_RESP     0x10
+#define FUNC_FINAL    0x23
+
+#define POLL_LEN      (MSG_FUNC + 1 + MSG_FCS_LEN)
+#define RESP_SS_LEN   (MSG_TS2 + 4 + MSG_FCS_LEN)
+#define RESP_DS_LEN   (MSG_FUNC + 1 + MSG_FCS_LEN)
+#define FINAL_LEN     (MSG_TS3 + 4 + MSG_FCS_LEN)
+
+typedef enum {
+    TWR_IDLE,          // initiator: between exchanges
+    TWR_WAIT_RESP,     // initiator: poll sent
+    TWR_WAIT_FINAL_TX, // initiator (DS): final scheduled
+    TWR_WAIT_POLL,     // responder: listening
+    TWR_WAIT_RESP_TX,  // responder (SS): response scheduled
+    TWR_WAIT_FINAL,    // responder (DS): response sent, final expected
+} uwb_twr_state_t;
+
+static uwb_twr_config_t twr_cfg;
+static uwb_twr_state_t twr_state;
+static TickType_t twr_state_tick;
+static uint8_t twr_seq;
+static uint16_t twr_peer;    // responder: initiator of the current exchange
+
+static uint32_t twr_poll_rx_ts;    // responder, low 32 bits
+static QueueHandle_t twr_results;
+static uwb_twr_stats_t twr_stats;
+
+static uint8_t twr_tx[MSG_LEN_MAX];
+static uint8_t twr_rx[MSG_LEN_MAX];
+
+static uint32_t msg_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static void msg_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t msg_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void msg_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void twr_set_state(uwb_twr_state_t state) {
+    twr_state = state;
+    twr_state_tick = xTaskGetTickCount();
+}
+
+static void twr_msg_header(uint8_t func, uint16_t dst) {
+    twr_tx[0] = 0x41;    // data frame, PAN ID compression
+    twr_tx[1] = 0x88;    // short destination and source addresses
+    twr_tx[MSG_SEQ] = twr_seq;
+    msg_put16(&twr_tx[MSG_PAN], twr_cfg.pan_id);
+    msg_put16(&twr_tx[MSG_DST], dst);
+    msg_put16(&twr_tx[MSG_SRC], twr_cfg.addr);
+    twr_tx[MSG_FUNC] = func;
+}
+
+/* Read the received frame and check it is func addressed to us. */
+static int twr_msg_read(const dwt_cb_data_t *cb, uint8_t func,
+                        uint16_t len) {
+    if (cb->datalength != len) {
+        return 0;
+    }
+    dwt_readrxdata(twr_rx, len - MSG_FCS_LEN, 0);
+    return twr_rx[MSG_FUNC] == func &&
+           msg_get16(&twr_rx[MSG_PAN]) == twr_cfg.pan_id &&
+           msg_get16(&twr_rx[MSG_DST]) == twr_cfg.addr;
+}
+
+/* Schedule the reply to a frame received at rx_ts. Returns the TX timestamp
+ * the frame will carry, antenna delay included. */
+static uwb_ts_t twr_delayed_tx_time(uwb_ts_t rx_ts) {
+    uwb_ts_t at = uwb_ts_add(rx_ts, uwb_uus_to_dtu(UWB_TWR_REPLY_DLY_UUS));
+
+    dwt_setdelayedtrxtime(uwb_ts_dly_reg(at));
+    return uwb_ts_delayed_tx_stamp(at, twr_cfg.ant_dly);
+}
+
+static int twr_send(uint16_t len, uint8_t mode) {
+    dwt_writetxdata(len, twr_tx, 0);
+    dwt_writetxfctrl(len, 0, 1);
+    if (dwt_starttx(mode) != DWT_SUCCESS) {
+        twr_stats.tx_late++;
+        return -1;
+    }
+    return 0;
+}
+
+/* diag is the diagnostics of the last frame of the exchange, read by the
+ * caller while the frame was still in the receiver. */
+static void twr_report(uint16_t peer, int64_t tof, const dwt_rxdiag_t *diag,
+                       int32_t ppb) {
+    uwb_twr_result_t res;
+
+    res.peer = peer;
+    res.seq = twr_seq;
+    res.mode = (uint8_t)twr_cfg.mode;
+    res.tof_dtu = (int32_t)tof;
+    res.dist_mm = uwb_dtu_to_mm(tof);
+
+    res.dist_mm -=
+        dwt_getrangebiascm(twr_cfg.chan, res.dist_mm, twr_cfg.prf) * 10;
+
+    uwb_nlos_estimate(diag, twr_cfg.prf, &res.nlos);
+    res.clk_offset_ppb = ppb;
+
+    twr_stats.ranges++;
+    xQueueSend(twr_results, &res, 0);
+}
+
+/* Back to the role's resting state: initiator idle, responder listening. */
+static void twr_rest(void) {
+    if (twr_cfg.role == UWB_TWR_INITIATOR) {
+        twr_set_state(TWR_IDLE);
+    } else {
+        // the transceiver is off between exchanges
+        uwb_tempcomp_apply();
+        dwt_setrxtimeout(0);
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        twr_set_state(TWR_WAIT_POLL);
+    }
+}
+
+static void twr_send_poll(void) {
+    twr_seq++;
+    twr_stats.exchanges++;
+    twr_msg_header(FUNC_POLL, twr_cfg.peer);
+
+    dwt_setrxaftertxdelay(UWB_TWR_TX_TO_RX_DLY_UUS);
+    dwt_setrxtimeout(UWB_TWR_RX_TIMEOUT_UUS);
+    if (twr_send(POLL_LEN, DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) ==
+        0) {
+        twr_set_state(TWR_WAIT_RESP);
+    }
+}
+
+static void twr_initiator_rx(const dwt_cb_data_t *cb) {
+    uint32_t poll_tx_ts, resp_rx_ts, final_tx_ts;
+    dwt_rxdiag_t diag;
+    uwb_ts_t resp_rx_ts40 = uwb_ts_from_bytes(cb->rx_stamp);
+
+    if (twr_state != TWR_WAIT_RESP ||
+        !twr_msg_read(cb, FUNC_RESP,
+                      twr_cfg.mode == UWB_TWR_SS ? RESP_SS_LEN
+                                                 : RESP_DS_LEN) ||
+        twr_rx[MSG_SEQ] != twr_seq ||
+        msg_get16(&twr_rx[MSG_SRC]) != twr_cfg.peer) {
+        twr_stats.bad_frame++;
+        twr_rest();
+        return;
+    }
+
+    poll_tx_ts = dwt_readtxtimestamplo32();
+    resp_rx_ts = uwb_ts_lo32(resp_rx_ts40);
+
+    if (twr_cfg.mode == UWB_TWR_SS) {
+        // round trip minus the responder's reply time, all modulo 2^32; the
+        // reply time is timed by the responder's clock, so it is scaled to
+        // ours with the offset measured on its response
+        int64_t ra = uwb_ts_diff32(resp_rx_ts, poll_tx_ts);
+        int64_t db = uwb_ts_diff32(msg_get32(&twr_rx[MSG_TS2]),
+                                   msg_get32(&twr_rx[MSG_TS1]));
+        int32_t ppb;
+
+        dwt_readdiagnostics(&diag);
+        ppb = uwb_clkoffset_ppb(diag.carrierIntegrator, twr_cfg.chan,
+                                twr_cfg.data_rate);
+        twr_report(twr_cfg.peer, (ra - uwb_clkoffset_to_local(db, ppb)) / 2,
+                   &diag, ppb);
+        twr_rest();
+        return;
+    }
+
+    // DS: send the final with our three timestamps
+    final_tx_ts = uwb_ts_lo32(twr_delayed_tx_time(resp_rx_ts40));
+    twr_msg_header(FUNC_FINAL, twr_cfg.peer);
+    msg_put32(&twr_tx[MSG_TS1], poll_tx_ts);
+    msg_put32(&twr_tx[MSG_TS2], resp_rx_ts);
+    msg_put32(&twr_tx[MSG_TS3], final_tx_ts);
+    if (twr_send(FINAL_LEN, DWT_START_TX_DELAYED) == 0) {
+        twr_set_state(TWR_WAIT_FINAL_TX);
+    } else {
+        twr_rest();
+    }
+}
+
+static void twr_responder_rx(const dwt_cb_data_t *cb) {
+    uwb_ts_t rx_ts40 = uwb_ts_from_bytes(cb->rx_stamp);
+    uint32_t resp_tx_ts;
+
+    if (twr_state == TWR_WAIT_FINAL && twr_msg_read(cb, FUNC_FINAL, FINAL_LEN) &&
+        twr_rx[MSG_SEQ] == twr_seq &&
+        msg_get16(&twr_rx[MSG_SRC]) == twr_peer) {
+        uint32_t final_rx_ts = uwb_ts_lo32(rx_ts40);
+        uint32_t poll_tx_ts = msg_get32(&twr_rx[MSG_TS1]);
+        uint32_t resp_rx_ts = msg_get32(&twr_rx[MSG_TS2]);
+        uint32_t final_tx_ts = msg_get32(&twr_rx[MSG_TS3]);
+        int64_t ra, rb, da, db;
+        dwt_rxdiag_t diag;
+
+        resp_tx_ts = dwt_readtxtimestamplo32();
+        ra = uwb_ts_diff32(resp_rx_ts, poll_tx_ts);
+        rb = uwb_ts_diff32(final_rx_ts, resp_tx_ts);
+        da = uwb_ts_diff32(final_tx_ts, resp_rx_ts);
+        db = uwb_ts_diff32(resp_tx_ts, twr_poll_rx_ts);
+
+        // asymmetric DS-TWR, cancels first order clock offset
+        dwt_readdiagnostics(&diag);
+        twr_report(twr_peer, (ra * rb - da * db) / (ra + rb + da + db), &diag,
+                   uwb_clkoffset_ppb(diag.carrierIntegrator, twr_cfg.chan,
+                                     twr_cfg.data_rate));
+        twr_rest();
+        return;
+    }
+
+    if (!twr_msg_read(cb, FUNC_POLL, POLL_LEN)) {
+        twr_stats.bad_frame++;
+        twr_rest();
+        return;
+    }
+
+    // a poll, possibly restarting an unfinished exchange
+    twr_stats.exchanges++;
+    twr_seq = twr_rx[MSG_SEQ];
+    twr_peer = msg_get16(&twr_rx[MSG_SRC]);
+    twr_poll_rx_ts = uwb_ts_lo32(rx_ts40);
+
+    resp_tx_ts = uwb_ts_lo32(twr_delayed_tx_time(rx_ts40));
+    twr_msg_header(FUNC_RESP, twr_peer);
+
+    if (twr_cfg.mode == UWB_TWR_SS) {
+        msg_put32(&twr_tx[MSG_TS1], twr_poll_rx_ts);
+        msg_put32(&twr_tx[MSG_TS2], resp_tx_ts);
+        if (twr_send(RESP_SS_LEN, DWT_START_TX_DELAYED) == 0) {
+            twr_set_state(TWR_WAIT_RESP_TX);
+            return;
+        }
+    } else {
+        dwt_setrxaftertxdelay(UWB_TWR_TX_TO_RX_DLY_UUS);
+        dwt_setrxtimeout(UWB_TWR_RX_TIMEOUT_UUS);
+        if (twr_send(RESP_DS_LEN,
+                     DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == 0) {
+            twr_set_state(TWR_WAIT_FINAL);
+            return;
+        }
+    }
+    twr_rest();
+}
+
+static void twr_tx_done_cb(const dwt_cb_data_t *cb) {
+    (void)cb;
+    // frames sent with a response expected keep their state until the reply
+    if (twr_state == TWR_WAIT_FINAL_TX || twr_state == TWR_WAIT_RESP_TX) {
+        twr_rest();
+    }
+}
+
+static void twr_rx_ok_cb(const dwt_cb_data_t *cb) {
+    if (twr_cfg.role == UWB_TWR_INITIATOR) {
+        twr_initiator_rx(cb);
+    } else {
+        twr_responder_rx(cb);
+    }
+}
+
+static void twr_rx_to_cb(const dwt_cb_data_t *cb) {
+    (void)cb;
+    twr_stats.rx_timeout++;
+    twr_rest();
+}
+
+static void twr_rx_err_cb(const dwt_cb_data_t *cb) {
+    (void)cb;
+    twr_stats.rx_error++;
+    twr_rest();
+}
+
+static void twr_task(void *pvParameters) {
+    TickType_t period = pdMS_TO_TICKS(twr_cfg.period_ms);
+    TickType_t next = xTaskGetTickCount();
+    TickType_t wait;
+    uint32_t irq;
+
+    decaselectdevice((unsigned int)(uintptr_t)pvParameters);
+
+    dwt_setdblrxbuffmode(0);
+    dwt_setrxantennadelay(twr_cfg.ant_dly);
+    dwt_settxantennadelay(twr_cfg.ant_dly);
+    dwt_setcallbacks(twr_tx_done_cb, twr_rx_ok_cb, twr_rx_to_cb,
+                     twr_rx_err_cb);
+    dwt_setinterrupt(UWB_TWR_INT_MASK, 1);
+    deca_irq_init(xTaskGetCurrentTaskHandle());
+
+    twr_rest();
+
+    while (1) {
+        wait = UWB_TWR_WATCHDOG;
+        if (twr_cfg.role == UWB_TWR_INITIATOR && twr_state == TWR_IDLE) {
+            int32_t due = (int32_t)(next - xTaskGetTickCount());
+            wait = (due > 0) ? (TickType_t)due : 0;
+        }
+
+        irq = ulTaskNotifyTake(pdTRUE, wait);
+        if (irq) {
+            // the IRQ line stays high until every enabled event is cleared
+            do {
+                dwt_isr();
+            } while (deca_irq_active());
+        }
+
+        if (twr_cfg.role == UWB_TWR_INITIATOR && twr_state == TWR_IDLE) {
+            TickType_t now = xTaskGetTickCount();
+
+            if ((int32_t)(now - next) >= 0) {
+                next = now + period;
+                uwb_tempcomp_apply();
+                twr_send_poll();
+            }
+        } else if (!irq && twr_state != TWR_WAIT_POLL &&
+                   xTaskGetTickCount() - twr_state_tick >= UWB_TWR_WATCHDOG) {
+            // an expected event never came, drop the exchange
+            dwt_forcetrxoff();
+            twr_rest();
+        }
+    }
+}
+
+int uwb_twr_start(const uwb_twr_config_t *cfg, UBaseType_t priority) {
+    twr_cfg = *cfg;
+    if (twr_cfg.ant_dly == 0) {
+        twr_cfg.ant_dly = UWB_TWR_ANT_DLY_DEFAULT;
+    }
+    if (twr_cfg.period_ms == 0) {
+        twr_cfg.period_ms = 1;
+    }
+
+    twr_results = xQueueCreate(UWB_TWR_RESULT_QUEUE, sizeof(uwb_twr_result_t));
+    if (twr_results == NULL) {
+        return -1;
+    }
+    // the engine works with the DW1000 selected by the caller
+    if (xTaskCreate(twr_task, "UwbTwr", UWB_TWR_STACK_WORDS,
+                    (void *)(uintptr_t)decadeviceindex(), priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+BaseType_t uwb_twr_get_result(uwb_twr_result_t *res, TickType_t timeout) {
+    return xQueueReceive(twr_results, res, timeout);
+}
+
+void uwb_twr_get_stats(uwb_twr_stats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = twr_stats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,73 @@
+#ifndef UWB_TWR_H
+#define UWB_TWR_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "uwb_nlos.h"
+
+/* Reply times in UWB microseconds (1 uus = 512/499.2 us). The responder must
+ * read the poll, compute the response time and load the TX frame inside
+ * UWB_TWR_REPLY_DLY_UUS; at the PSC_32 SPI rate that takes about 250 us. A DS
+ * exchange (poll, response, final) completes in under 1 ms. */
+#define UWB_TWR_REPLY_DLY_UUS    400    // RX timestamp to delayed TX of the reply
+#define UWB_TWR_TX_TO_RX_DLY_UUS 210    // end of own TX to receiver on
+#define UWB_TWR_RX_TIMEOUT_UUS   210    // receiver on time for the reply
+#define UWB_TWR_ANT_DLY_DEFAULT  16436  // TX and RX antenna delay, device time units
+
+typedef enum {
+    UWB_TWR_INITIATOR,
+    UWB_TWR_RESPONDER,
+} uwb_twr_role_t;
+
+typedef enum {
+    UWB_TWR_SS,    // single sided: poll, response; initiator gets the range,
+                   // corrected for the responder's clock offset
+    UWB_TWR_DS,    // double sided: poll, response, final; responder gets it
+} uwb_twr_mode_t;
+
+typedef struct {
+    uwb_twr_role_t role;
+    uwb_twr_mode_t mode;
+    uint16_t pan_id;
+    uint16_t addr;         // own short address
+    uint16_t peer;         // initiator: responder address to range with
+    uint16_t period_ms;    // initiator: time between exchanges
+    uint16_t ant_dly;      // 0 for UWB_TWR_ANT_DLY_DEFAULT
+    uint8_t chan;          // as configured, for the range bias correction
+    uint8_t prf;
+    uint8_t data_rate;     // as configured (DWT_BR_x), for the clock offset
+} uwb_twr_config_t;
+
+typedef struct {
+    uint16_t peer;
+    uint8_t seq;
+    uint8_t mode;          // uwb_twr_mode_t
+    int32_t tof_dtu;       // time of flight, device time units
+    int32_t dist_mm;       // bias corrected distance
+    uwb_nlos_t nlos;       // of the last frame of the exchange, down-weight
+                           // ranges with a high likelihood
+    int32_t clk_offset_ppb;    // peer clock vs ours, from the last frame
+} uwb_twr_result_t;
+
+typedef struct {
+    uint32_t exchanges;    // initiator: polls sent, responder: polls received
+    uint32_t ranges;       // results produced
+    uint32_t rx_timeout;
+    uint32_t rx_error;
+    uint32_t tx_late;      // delayed TX missed its slot
+    uint32_t bad_frame;    // unexpected frame, wrong peer or sequence
+} uwb_twr_stats_t;
+
+/* Start the ranging engine. Like uwb_rx_start() it takes over the DW1000 IRQ
+ * and callbacks, so only one of the two can run. The device must already be
+ * initialised and configured. The engine task drives the device selected by
+ * the caller (decaselectdevice()). */
+int uwb_twr_start(const uwb_twr_config_t *cfg, UBaseType_t priority);
+
+/* Wait for the next range computed on this side. */
+BaseType_t uwb_twr_get_result(uwb_twr_result_t *res, TickType_t timeout);
+
+void uwb_twr_get_stats(uwb_twr_stats_t *stats);
+
+#endif /* UWB_TWR_H */
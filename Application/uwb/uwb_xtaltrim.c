@@ -0,0 +1,123 @@
+#include "uwb_xtaltrim.h"
+
+#include "deca_device_api.h"
+#include "task.h"
+#include "uwb_clkoffset.h"
+
+#define UWB_XTALTRIM_STACK_WORDS 128
+#define UWB_XTALTRIM_TRIM_MAX    0x1F    // FS_XTALT_MASK
+
+static uwb_xtaltrim_config_t uwb_xtaltrim_cfg;
+static volatile uint8_t uwb_xtaltrim_running;
+static int64_t uwb_xtaltrim_sum;
+static uint32_t uwb_xtaltrim_count;
+static uwb_xtaltrim_state_t uwb_xtaltrim_st;
+
+void uwb_xtaltrim_feed_ppb(int32_t ppb) {
+    if (!uwb_xtaltrim_running) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    uwb_xtaltrim_sum += ppb;
+    uwb_xtaltrim_count++;
+    taskEXIT_CRITICAL();
+}
+
+void uwb_xtaltrim_feed_carrier(int32_t carrier) {
+    uwb_xtaltrim_feed_ppb(uwb_clkoffset_ppb(carrier, uwb_xtaltrim_cfg.chan,
+                                            uwb_xtaltrim_cfg.data_rate));
+}
+
+// trim steps that bring the average offset back to zero, 0 inside the band
+static int32_t xtaltrim_steps(int32_t ppb) {
+    int32_t steps;
+
+    if (ppb <= UWB_XTALTRIM_HI_PPB && ppb >= -UWB_XTALTRIM_HI_PPB) {
+        return 0;
+    }
+    // the reference runs fast = we run slow = lower the trim, rounded
+    steps = -(ppb + ((ppb > 0) ? 1 : -1) * UWB_XTALTRIM_PPB_PER_STEP / 2) /
+            UWB_XTALTRIM_PPB_PER_STEP;
+    if (steps == 0) {
+        steps = (ppb > 0) ? -1 : 1;
+    }
+    if (steps > UWB_XTALTRIM_MAX_STEP) {
+        steps = UWB_XTALTRIM_MAX_STEP;
+    } else if (steps < -UWB_XTALTRIM_MAX_STEP) {
+        steps = -UWB_XTALTRIM_MAX_STEP;
+    }
+    return steps;
+}
+
+static void xtaltrim_task(void *pvParameters) {
+    TickType_t last = xTaskGetTickCount();
+    int64_t sum;
+    uint32_t count;
+    int32_t avg;
+    int32_t trim;
+
+    decaselectdevice((unsigned int)(uintptr_t)pvParameters);
+
+    uwb_xtaltrim_st.trim = dwt_getxtaltrim();
+    uwb_xtaltrim_running = 1;
+
+    while (1) {
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(uwb_xtaltrim_cfg.period_ms));
+
+        taskENTER_CRITICAL();
+        sum = uwb_xtaltrim_sum;
+        count = uwb_xtaltrim_count;
+        uwb_xtaltrim_sum = 0;
+        uwb_xtaltrim_count = 0;
+        taskEXIT_CRITICAL();
+
+        if (count == 0 || count < uwb_xtaltrim_cfg.min_samples) {
+            continue;
+        }
+        avg = (int32_t)(sum / (int64_t)count);
+        trim = uwb_xtaltrim_st.trim + xtaltrim_steps(avg);
+        if (trim < 0) {
+            trim = 0;
+        } else if (trim > UWB_XTALTRIM_TRIM_MAX) {
+            trim = UWB_XTALTRIM_TRIM_MAX;
+        }
+
+        taskENTER_CRITICAL();
+        uwb_xtaltrim_st.offset_ppb = avg;
+        uwb_xtaltrim_st.samples += count;
+        taskEXIT_CRITICAL();
+
+        if (trim == uwb_xtaltrim_st.trim) {
+            continue;
+        }
+        dwt_setxtaltrim((uint8_t)trim);
+
+        // samples taken across the change describe neither setting
+        taskENTER_CRITICAL();
+        uwb_xtaltrim_st.trim = (uint8_t)trim;
+        uwb_xtaltrim_st.steps++;
+        uwb_xtaltrim_sum = 0;
+        uwb_xtaltrim_count = 0;
+        taskEXIT_CRITICAL();
+    }
+}
+
+int uwb_xtaltrim_start(const uwb_xtaltrim_config_t *cfg, UBaseType_t priority) {
+    uwb_xtaltrim_cfg = *cfg;
+    if (uwb_xtaltrim_cfg.period_ms == 0) {
+        uwb_xtaltrim_cfg.period_ms = 1000;
+    }
+    // the task works with the DW1000 selected by the caller
+    if (xTaskCreate(xtaltrim_task, "UwbXtal", UWB_XTALTRIM_STACK_WORDS,
+                    (void *)(uintptr_t)decadeviceindex(), priority,
+                    NULL) != pdPASS) {
+        return -1;
+    }
+    return 0;
+}
+
+void uwb_xtaltrim_get_state(uwb_xtaltrim_state_t *state) {
+    taskENTER_CRITICAL();
+    *state = uwb_xtaltrim_st;
+    taskEXIT_CRITICAL();
+}
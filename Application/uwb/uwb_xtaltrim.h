@@ -0,0 +1,48 @@
+#ifndef UWB_XTALTRIM_H
+#define UWB_XTALTRIM_H
+
+#include <stdint.h>
+
+#include "freertos.h"
+
+/* Background crystal trim calibration. Measurements of our clock offset
+ * against a reference (carrier integrator of its frames, or TWR clock
+ * offsets) are averaged over each period; when the average leaves
+ * +-UWB_XTALTRIM_HI_PPB the trim is stepped towards zero offset and the
+ * samples taken meanwhile are discarded. Inside that band nothing changes,
+ * so the trim does not dither around the half step. Each trim step moves the
+ * DW1000 clock by about UWB_XTALTRIM_PPB_PER_STEP, higher trim values
+ * lowering the frequency. */
+#define UWB_XTALTRIM_PPB_PER_STEP 1500    // typical, depends on the crystal
+#define UWB_XTALTRIM_HI_PPB       1000    // act beyond 2/3 of a step
+#define UWB_XTALTRIM_MAX_STEP     2       // trim steps per adjustment
+
+typedef struct {
+    uint16_t period_ms;    // averaging period
+    uint16_t min_samples;  // fewer samples in a period are ignored
+    uint8_t chan;          // as configured, to convert carrier integrators
+    uint8_t data_rate;
+} uwb_xtaltrim_config_t;
+
+typedef struct {
+    uint8_t trim;          // current trim value
+    int32_t offset_ppb;    // last period average, reference vs ours
+    uint32_t samples;      // samples used
+    uint32_t steps;        // adjustments made
+} uwb_xtaltrim_state_t;
+
+/* Start the calibration task on the DW1000 selected by the caller. It starts
+ * from the trim set by dwt_initialise() (OTP or FS_XTALT_MIDRANGE). */
+int uwb_xtaltrim_start(const uwb_xtaltrim_config_t *cfg, UBaseType_t priority);
+
+/* Feed the carrier integrator of a frame sent by the reference
+ * (dwt_rxdiag_t.carrierIntegrator). No-op until uwb_xtaltrim_start(). */
+void uwb_xtaltrim_feed_carrier(int32_t carrier);
+
+/* Feed a clock offset of the reference relative to ours in ppb, positive
+ * when the reference runs fast (e.g. uwb_twr_result_t.clk_offset_ppb). */
+void uwb_xtaltrim_feed_ppb(int32_t ppb);
+
+void uwb_xtaltrim_get_state(uwb_xtaltrim_state_t *state);
+
+#endif /* UWB_XTALTRIM_H */
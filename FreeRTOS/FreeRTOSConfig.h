@@ -419,16 +419,8 @@ extern uint32_t SystemCoreClock;
  * number of the failing assert (for example, "vAssertCalled( __FILE__, __LINE__ )"
  * or it can simple disable interrupts and sit in a loop to halt all execution
  * on the failing line for viewing in a debugger. */
-#define configASSERT(x)                                   \
-    if ((x) == 0)                                         \
-    {                                                     \
-        printf("OS Error:%s,%d\r\n", __FILE__, __LINE__); \
-        taskDISABLE_INTERRUPTS();                         \
-        for (;;)                                          \
-            ;                                             \
-    }
-// #define vAssertCalled(char,int) printf("Error:%s,%d\r\n",char,int)
-// #define configASSERT(x) if((x)==0) vAssertCalled(__FILE__,__LINE__)
+extern void vAssertCalled(const char *file, int line);
+#define configASSERT(x) if((x)==0) vAssertCalled(__FILE__,__LINE__)
 
 /******************************************************************************/
 /* FreeRTOS MPU specific definitions. *****************************************/
@@ -12,6 +12,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "deca_types.h"
 #include "deca_param_types.h"
@@ -60,6 +61,39 @@ void _dwt_aonarrayupload(void);
  * Static data for DW1000 DecaWave Transceiver control
  */
 
+// -------------------------------------------------------------------------------------------------------------------
+// Register values derived from a dwt_config_t, so that dwt_reconfigure() can compare two configurations register by
+// register and write only what differs
+typedef struct
+{
+    uint32_t      sysCfg ;            // SYS_CFG bits set by the configuration (RXM110K and PHR_MODE)
+    uint32_t      chanCtrl ;          // CHAN_CTRL
+    uint32_t      txFctrl ;           // TX_FCTRL bit rate, PRF and preamble length
+    uint32_t      pllCfg ;            // FS_PLLCFG
+    uint32_t      txCtrl ;            // RF_TXCTRL
+    uint32_t      tune2 ;             // DRX_TUNE2
+    uint16_t      repc ;              // LDE_REPC
+    uint16_t      ldeCfg2 ;           // LDE_CFG2
+    uint16_t      tune0b ;            // DRX_TUNE0b
+    uint16_t      tune1a ;            // DRX_TUNE1a
+    uint16_t      tune1b ;            // DRX_TUNE1b
+    uint16_t      sfdToc ;            // DRX_SFDTOC
+    uint16_t      agcTune1 ;          // AGC_TUNE1
+    uint8_t       pllTune ;           // FS_PLLTUNE
+    uint8_t       rxCtrlh ;           // RF_RXCTRLH
+    uint8_t       tune4h ;            // DRX_TUNE4H, 0 if not written (110 kbps)
+    uint8_t       usrSfd ;            // USR_SFD length, 0 if not written (standard SFD)
+} dwt_configregs_t ;
+
+#define CONFIG_XFER_MAX         (27)    // one per register written by a full configuration, plus the 7 that
+#define CONFIG_DATA_MAX         (70)    // dwt_restoreconfig() adds; sum of their lengths
+
+// Registers outside the configuration that dwt_restoreconfig() writes back, bits of restoreMask
+#define RESTORE_RXANTD          0x01
+#define RESTORE_TXANTD          0x02
+#define RESTORE_XTALT           0x04
+#define RESTORE_TXRF            0x08
+
 // -------------------------------------------------------------------------------------------------------------------
 // Structure to hold device data
 typedef struct
@@ -71,10 +105,26 @@ typedef struct
     uint8_t       longFrames ;        // Flag in non-standard long frame mode
     uint8_t       otprev ;            // OTP revision number (read during initialisation)
     uint32_t      txFCTRL ;           // Keep TX_FCTRL register config
-    uint32_t      sysCFGreg ;         // Local copy of system config register
+    uint32_t      shadow[DWT_SHADOW_NUM] ; // Write-through copies of the configuration registers, see _dwt_readshadow()
+    uint8_t       shadowValid ;       // Bit n set when shadow[n] matches the device
+    dwt_shadowstats_t shadowStats ;   // SPI transactions saved by the shadows
+    dwt_configregs_t configRegs ;     // Registers written by the last dwt_configure()/dwt_reconfigure()
+    uint8_t       configValid ;       // configRegs matches the device
+    uint16_t      configNxfer ;       // Staging area for the configuration burst, the register values must stay
+    uint16_t      configNdata ;       // valid until transferspi() returns
+    dwt_spixfer_t configXfer[CONFIG_XFER_MAX] ;
+    uint8_t       configData[CONFIG_DATA_MAX] ;
     uint8_t       dblbuffon;          // Double RX buffer mode flag
     uint8_t       wait4resp ;         // wait4response was set with last TX start command
     uint16_t      sleep_mode;         // Used for automatic reloading of LDO tune and microcode at wake-up
+    dwt_otpcache_t otpCache ;         // OTP words already read, kept across dwt_initialise() calls
+    uint8_t       shadowSlept ;       // shadowValid and configValid when the device went to sleep,
+    uint8_t       configSlept ;       // i.e. what dwt_restoreconfig() can write back
+    uint8_t       restoreMask ;       // RESTORE_xxx values below set since dwt_initialise()
+    uint8_t       xtalTrim ;
+    uint16_t      rxAntDly ;
+    uint16_t      txAntDly ;
+    dwt_txconfig_t txConfig ;
     uint16_t      otp_mask ;          // Local copy of the OTP mask used in dwt_initialise call
     dwt_cb_data_t cbData;           // Callback data structure
     dwt_cb_t    cbTxDone;           // Callback for TX confirmation event
@@ -84,7 +134,95 @@ typedef struct
 } dwt_local_data_t ;
 
 static dwt_local_data_t dw1000local[DWT_NUM_DW_DEV] ; // Static local device data, can be an array to support multiple DW1000 testing applications/platforms
+#if DWT_NUM_DW_DEV > 1
+// Several devices can be driven concurrently from different tasks, each task works with the one it selected
+#define pdw1000local (&dw1000local[decadeviceindex()])
+#else
 static dwt_local_data_t *pdw1000local = dw1000local ; // Static local data structure pointer
+#endif
+
+// Register files and access masks of the shadowed registers, indexed by DWT_SHADOW_xxx
+static const uint8_t shadow_reg[DWT_SHADOW_NUM] = {SYS_CFG_ID, SYS_MASK_ID, TX_FCTRL_ID, CHAN_CTRL_ID} ;
+static const uint32_t shadow_mask[DWT_SHADOW_NUM] = {SYS_CFG_MASK, SYS_MASK_MASK_32, 0xFFFFFFFFUL, CHAN_CTRL_MASK} ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_readshadow()
+ *
+ * @brief returns the local copy of a configuration register, reading it over SPI only if the copy is not valid (after
+ * initialisation, soft reset or sleep)
+ *
+ * input parameters
+ * @param shadow - DWT_SHADOW_SYS_CFG, DWT_SHADOW_SYS_MASK, DWT_SHADOW_TX_FCTRL or DWT_SHADOW_CHAN_CTRL
+ *
+ * output parameters
+ *
+ * returns the register value
+ */
+static uint32_t _dwt_readshadow(int shadow)
+{
+    if(pdw1000local->shadowValid & (1 << shadow))
+    {
+        pdw1000local->shadowStats.saved[shadow]++ ;
+    }
+    else
+    {
+        pdw1000local->shadow[shadow] = shadow_mask[shadow] & dwt_read32bitreg(shadow_reg[shadow]) ;
+        pdw1000local->shadowValid |= (1 << shadow) ;
+        pdw1000local->shadowStats.loads[shadow]++ ;
+    }
+
+    return pdw1000local->shadow[shadow] ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_writeshadow()
+ *
+ * @brief writes a configuration register and its local copy, the SPI write is skipped if the device already holds
+ * the value
+ *
+ * input parameters
+ * @param shadow - DWT_SHADOW_SYS_CFG, DWT_SHADOW_SYS_MASK, DWT_SHADOW_TX_FCTRL or DWT_SHADOW_CHAN_CTRL
+ * @param value  - the new register value
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_writeshadow(int shadow, uint32_t value)
+{
+    if((pdw1000local->shadowValid & (1 << shadow)) && (pdw1000local->shadow[shadow] == value))
+    {
+        pdw1000local->shadowStats.saved[shadow]++ ;
+        return ;
+    }
+
+    dwt_write32bitreg(shadow_reg[shadow], value) ;
+    pdw1000local->shadow[shadow] = value ;
+    pdw1000local->shadowValid |= (1 << shadow) ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getshadowstats()
+ *
+ * @brief returns how many SPI transactions the register shadows saved and how often they had to be reloaded
+ *
+ * input parameters
+ * @param reset - if non-zero the counters are cleared after being copied
+ *
+ * output parameters
+ * @param stats - the counters, per shadowed register
+ *
+ * no return value
+ */
+void dwt_getshadowstats(dwt_shadowstats_t *stats, int reset)
+{
+    *stats = pdw1000local->shadowStats ;
+
+    if(reset)
+    {
+        memset(&pdw1000local->shadowStats, 0, sizeof(pdw1000local->shadowStats)) ;
+    }
+}
 
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -123,9 +261,13 @@ int dwt_setlocaldataptr(unsigned int index)
         return DWT_ERROR ;
     }
 
+#if DWT_NUM_DW_DEV > 1
+    return decaselectdevice(index) ;
+#else
     pdw1000local = &dw1000local[index];
 
     return DWT_SUCCESS ;
+#endif
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -147,6 +289,8 @@ int dwt_setlocaldataptr(unsigned int index)
  *    also the SPI frequency has to be < 3MHz
  * 2. It reads and applies LDO tune and crystal trim values from OTP memory
  * 3. If accurate RX timestamping is needed microcode/LDE must be loaded
+ * 4. OTP words are read once and cached in dw1000local[], later calls (e.g. after wake up or a soft reset) reuse them,
+ *    see dwt_getotpcache()/dwt_setotpcache(). The system clock is only forced to XTI when an OTP read is actually needed.
  *
  * input parameters
  * @param config    -   specifies what configuration to load
@@ -172,12 +316,16 @@ int dwt_setlocaldataptr(unsigned int index)
 
 int dwt_initialise(int config)
 {
-    uint16_t otp_xtaltrim_and_rev = 0;
-    uint32_t ldo_tune = 0;
+    dwt_otpcache_t *otp = &pdw1000local->otpCache;
+    uint32_t otpneed = 0;
 
     pdw1000local->dblbuffon = 0; // - set to 0 - meaning double buffer mode is off by default
     pdw1000local->wait4resp = 0; // - set to 0 - meaning wait for response not active
     pdw1000local->sleep_mode = 0; // - set to 0 - meaning sleep mode has not been configured
+    pdw1000local->shadowValid = 0; // - register shadows are reloaded on first use
+    pdw1000local->configValid = 0;
+    pdw1000local->shadowSlept = 0;
+    pdw1000local->configSlept = 0;
 
     pdw1000local->cbTxDone = NULL;
     pdw1000local->cbRxOk = NULL;
@@ -197,12 +345,47 @@ int dwt_initialise(int config)
     if(!(DWT_DW_WAKE_UP & config)) // Don't reset the device if DWT_DW_WAKE_UP bit is set, e.g. when calling this API after wake up
     {
         dwt_softreset(); // Make sure the device is completely reset before starting initialisation
+        pdw1000local->restoreMask = 0; // Everything is back to its reset value
+        otpneed = DWT_OTPCACHE_LDO | DWT_OTPCACHE_XTRIM;
+    }
+    else if(DWT_DW_WUP_RD_OTPREV & config)
+    {
+        otpneed = DWT_OTPCACHE_XTRIM;
     }
+    otpneed |= config & (DWT_READ_OTP_PID | DWT_READ_OTP_LID | DWT_READ_OTP_BAT | DWT_READ_OTP_TMP);
+    // OTP words are the same on every call, only the ones not read before go over SPI
+    otpneed &= ~otp->valid;
 
-    if(!((DWT_DW_WAKE_UP & config) && ((DWT_READ_OTP_TMP | DWT_READ_OTP_BAT | DWT_READ_OTP_LID | DWT_READ_OTP_PID | DWT_DW_WUP_RD_OTPREV)& config)))
+    if(!(DWT_DW_WAKE_UP & config) || (otpneed != 0))
     {
         _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: set system clock to XTI - this is necessary to make sure the values read by _dwt_otpread are reliable
-    }                                  // when not reading from OTP, clocks don't need to change.
+    }                                  // when not reading from OTP after wake up, clocks don't need to change.
+
+    if(otpneed & DWT_OTPCACHE_LDO)
+    {
+        otp->ldoTune = _dwt_otpread(LDOTUNE_ADDRESS);
+    }
+    if(otpneed & DWT_OTPCACHE_XTRIM)
+    {
+        otp->xtrimRev = _dwt_otpread(XTRIM_ADDRESS) & 0xffff; // Read 32 bit value, XTAL trim val is in low octet-0 (5 bits), OTP revision is the next byte
+    }
+    if(otpneed & DWT_READ_OTP_PID)
+    {
+        otp->partID = _dwt_otpread(PARTID_ADDRESS);
+    }
+    if(otpneed & DWT_READ_OTP_LID)
+    {
+        otp->lotID = _dwt_otpread(LOTID_ADDRESS);
+    }
+    if(otpneed & DWT_READ_OTP_BAT)
+    {
+        otp->vBatP = _dwt_otpread(VBAT_ADDRESS) & 0xff;
+    }
+    if(otpneed & DWT_READ_OTP_TMP)
+    {
+        otp->tempP = _dwt_otpread(VTEMP_ADDRESS) & 0xff;
+    }
+    otp->valid |= otpneed;
 
     // Configure the CPLL lock detect
     dwt_write8bitoffsetreg(EXT_SYNC_ID, EC_CTRL_OFFSET, EC_CTRL_PLLLCK);
@@ -212,81 +395,41 @@ int dwt_initialise(int config)
     // kicked/loaded on wake up
     if(!(DWT_DW_WAKE_UP & config))
     {
-        // Load LDO tune from OTP and kick it if there is a value actually programmed.
-        ldo_tune = _dwt_otpread(LDOTUNE_ADDRESS);
-        if((ldo_tune & 0xFF) != 0)
+        // Kick LDO tune if there is a value actually programmed in OTP.
+        if((otp->ldoTune & 0xFF) != 0)
         {
             // Kick LDO tune
             dwt_write8bitoffsetreg(OTP_IF_ID, OTP_SF, OTP_SF_LDO_KICK); // Set load LDO kick bit
             pdw1000local->sleep_mode |= AON_WCFG_ONW_LLDO; // LDO tune must be kicked at wake-up
         }
     }
+    else if(otp->valid & DWT_OTPCACHE_LDO)
+    {   // The OTP value says whether it was kicked on power up
+        if((otp->ldoTune & 0xFF) != 0)
+            pdw1000local->sleep_mode |= AON_WCFG_ONW_LLDO;
+    }
     else
     {   //if LDOTUNE reg contains value different from default it means it was kicked from OTP and thus set AON_WCFG_ONW_LLDO.
         if(dwt_read32bitoffsetreg(RF_CONF_ID, LDOTUNE) != LDOTUNE_DEFAULT)
             pdw1000local->sleep_mode |= AON_WCFG_ONW_LLDO;
     }
 
-    if((!(DWT_DW_WAKE_UP & config)) || ((DWT_DW_WAKE_UP & config) && (DWT_DW_WUP_RD_OTPREV & config)))
-    {
-        // Read OTP revision number
-        otp_xtaltrim_and_rev = _dwt_otpread(XTRIM_ADDRESS) & 0xffff;        // Read 32 bit value, XTAL trim val is in low octet-0 (5 bits)
-        pdw1000local->otprev = (otp_xtaltrim_and_rev >> 8) & 0xff;          // OTP revision is the next byte
-    }
-    else
-        pdw1000local->otprev = 0; // If OTP valuse are not used, if this API is called after DW1000 IC has been woken up
-                                  // (DWT_DW_WAKE_UP bit is set), set otprev to 0
+    // If the OTP revision has never been read (DW1000 IC woken up without DWT_DW_WUP_RD_OTPREV), set otprev to 0
+    pdw1000local->otprev = (otp->valid & DWT_OTPCACHE_XTRIM) ? ((otp->xtrimRev >> 8) & 0xff) : 0;
 
     if(!(DWT_DW_WAKE_UP & config))
     {
         // XTAL trim value is set in OTP for DW1000 module and EVK/TREK boards but that might not be the case in a custom design
-        if ((otp_xtaltrim_and_rev & 0x1F) == 0) // A value of 0 means that the crystal has not been trimmed
-        {
-            otp_xtaltrim_and_rev = FS_XTALT_MIDRANGE ; // Set to mid-range if no calibration value inside
-        }
+        // A value of 0 means that the crystal has not been trimmed, set to mid-range then
         // Configure XTAL trim
-        dwt_setxtaltrim((uint8_t)otp_xtaltrim_and_rev);
-    }
-
-    if(DWT_READ_OTP_PID & config)
-    {
-        // Load Part from OTP
-        pdw1000local->partID = _dwt_otpread(PARTID_ADDRESS);
-    }
-    else
-    {
-        pdw1000local->partID = 0;
+        dwt_setxtaltrim(((otp->xtrimRev & 0x1F) == 0) ? FS_XTALT_MIDRANGE : (uint8_t)otp->xtrimRev);
     }
 
-    if(DWT_READ_OTP_LID & config)
-    {
-        // Load Lot ID from OTP
-        pdw1000local->lotID = _dwt_otpread(LOTID_ADDRESS);
-    }
-    else
-    {
-        pdw1000local->lotID = 0;
-    }
-
-    if(DWT_READ_OTP_BAT & config)
-    {
-        // Load VBAT from OTP
-        pdw1000local->vBatP = _dwt_otpread(VBAT_ADDRESS) & 0xff;
-    }
-    else
-    {
-        pdw1000local->vBatP = 0;
-    }
-
-    if(DWT_READ_OTP_TMP & config)
-    {
-        // Load TEMP from OTP
-        pdw1000local->tempP = _dwt_otpread(VTEMP_ADDRESS) & 0xff;
-    }
-    else
-    {
-        pdw1000local->tempP = 0;
-    }
+    // Part ID, lot ID and the production references of VBAT and TEMP, 0 if never read from OTP
+    pdw1000local->partID = (otp->valid & DWT_READ_OTP_PID) ? otp->partID : 0;
+    pdw1000local->lotID = (otp->valid & DWT_READ_OTP_LID) ? otp->lotID : 0;
+    pdw1000local->vBatP = (otp->valid & DWT_READ_OTP_BAT) ? otp->vBatP : 0;
+    pdw1000local->tempP = (otp->valid & DWT_READ_OTP_TMP) ? otp->tempP : 0;
 
     // Load leading edge detect code (LDE/microcode)
     if(!(DWT_DW_WAKE_UP & config))
@@ -317,10 +460,9 @@ int dwt_initialise(int config)
     dwt_write8bitoffsetreg(AON_ID, AON_CFG1_OFFSET, 0x00);
 
     // Read system register / store local copy
-    pdw1000local->sysCFGreg = dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
-    pdw1000local->longFrames = (pdw1000local->sysCFGreg & SYS_CFG_PHR_MODE_11) >> SYS_CFG_PHR_MODE_SHFT ; //configure longFrames
+    pdw1000local->longFrames = (_dwt_readshadow(DWT_SHADOW_SYS_CFG) & SYS_CFG_PHR_MODE_11) >> SYS_CFG_PHR_MODE_SHFT ; //configure longFrames
 
-    pdw1000local->txFCTRL = dwt_read32bitreg(TX_FCTRL_ID) ;
+    pdw1000local->txFCTRL = _dwt_readshadow(DWT_SHADOW_TX_FCTRL) ;
 
     return DWT_SUCCESS ;
 
@@ -603,13 +745,21 @@ uint32_t dwt_readdevid(void)
  */
 void dwt_configuretxrf(dwt_txconfig_t *config)
 {
+    dwt_spixfer_t xfer[2];
+    uint8_t power[4];
+    int j ;
 
-    // Configure RF TX PG_DELAY
-    dwt_write8bitoffsetreg(TX_CAL_ID, TC_PGDELAY_OFFSET, config->PGdly);
-
-    // Configure TX power
-    dwt_write32bitreg(TX_POWER_ID, config->power);
+    for ( j = 0 ; j < 4 ; j++ )
+    {
+        power[j] = (uint8_t)(config->power >> (8 * j)) ;
+    }
 
+    // Configure RF TX PG_DELAY and TX power, back-to-back in one batch
+    dwt_xferwrite(&xfer[0], TX_CAL_ID, TC_PGDELAY_OFFSET, 1, &config->PGdly);
+    dwt_xferwrite(&xfer[1], TX_POWER_ID, 0, 4, power);
+    transferspi(xfer, 2);
+    pdw1000local->txConfig = *config;
+    pdw1000local->restoreMask |= RESTORE_TXRF;
 }
 
 
@@ -642,105 +792,275 @@ void dwt_configurefor64plen(int prf)
 }
 
 
+#define CONFIG_SYS_CFG_BITS     (SYS_CFG_RXM110K | SYS_CFG_PHR_MODE_11)
+
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_configure()
+ * @fn _dwt_configregs()
  *
- * @brief This function provides the main API for the configuration of the
- * DW1000 and this low-level driver.  The input is a pointer to the data structure
- * of type dwt_config_t that holds all the configurable items.
- * The dwt_config_t structure shows which ones are supported
+ * @brief computes the register values a configuration results in
  *
  * input parameters
- * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ * @param config - the configuration, sfdTO must already be non-zero
  *
  * output parameters
+ * @param regs   - the register values
  *
  * no return value
  */
-void dwt_configure(dwt_config_t *config)
+static void _dwt_configregs(const dwt_config_t *config, dwt_configregs_t *regs)
 {
     uint8_t nsSfd_result  = 0;
     uint8_t useDWnsSFD = 0;
     uint8_t chan = config->chan ;
-    uint32_t regval ;
-    uint16_t reg16 = lde_replicaCoeff[config->rxCode];
     uint8_t prfIndex = config->prf - DWT_PRF_16M;
     uint8_t bw = ((chan == 4) || (chan == 7)) ? 1 : 0 ; // Select wide or narrow band
 
-#ifdef DWT_API_ERROR_CHECK
-    assert(config->dataRate <= DWT_BR_6M8);
-    assert(config->rxPAC <= DWT_PAC64);
-    assert((chan >= 1) && (chan <= 7) && (chan != 6));
-    assert(((config->prf == DWT_PRF_64M) && (config->txCode >= 9) && (config->txCode <= 24))
-           || ((config->prf == DWT_PRF_16M) && (config->txCode >= 1) && (config->txCode <= 8)));
-    assert(((config->prf == DWT_PRF_64M) && (config->rxCode >= 9) && (config->rxCode <= 24))
-           || ((config->prf == DWT_PRF_16M) && (config->rxCode >= 1) && (config->rxCode <= 8)));
-    assert((config->txPreambLength == DWT_PLEN_64) || (config->txPreambLength == DWT_PLEN_128) || (config->txPreambLength == DWT_PLEN_256)
-           || (config->txPreambLength == DWT_PLEN_512) || (config->txPreambLength == DWT_PLEN_1024) || (config->txPreambLength == DWT_PLEN_1536)
-           || (config->txPreambLength == DWT_PLEN_2048) || (config->txPreambLength == DWT_PLEN_4096));
-    assert((config->phrMode == DWT_PHRMODE_STD) || (config->phrMode == DWT_PHRMODE_EXT));
-#endif
+    regs->repc = lde_replicaCoeff[config->rxCode];
+    regs->sysCfg = (SYS_CFG_PHR_MODE_11 & ((uint32_t)config->phrMode << SYS_CFG_PHR_MODE_SHFT));
 
     // For 110 kbps we need a special setup
     if(DWT_BR_110K == config->dataRate)
     {
-        pdw1000local->sysCFGreg |= SYS_CFG_RXM110K ;
-        reg16 >>= 3; // lde_replicaCoeff must be divided by 8
+        regs->sysCfg |= SYS_CFG_RXM110K ;
+        regs->repc >>= 3; // lde_replicaCoeff must be divided by 8
+    }
+
+    regs->ldeCfg2 = prfIndex ? (uint16_t) LDE_PARAM3_64 : (uint16_t) LDE_PARAM3_16 ;
+
+    // PLL2/RF PLL block CFG/TUNE, RF RX and TX blocks (for a given channel)
+    regs->pllCfg = fs_pll_cfg[chan_idx[chan]];
+    regs->pllTune = fs_pll_tune[chan_idx[chan]];
+    regs->rxCtrlh = rx_config[bw];
+    regs->txCtrl = tx_config[chan_idx[chan]];
+
+    // Baseband parameters (for specified PRF, bit rate, PAC, and SFD settings)
+    regs->tune0b = sftsh[config->dataRate][config->nsSFD];
+    regs->tune1a = dtune1[prfIndex];
+
+    if(config->dataRate == DWT_BR_110K)
+    {
+        regs->tune1b = DRX_TUNE1b_110K;
+        regs->tune4h = 0;
+    }
+    else if(config->txPreambLength == DWT_PLEN_64)
+    {
+        regs->tune1b = DRX_TUNE1b_6M8_PRE64;
+        regs->tune4h = DRX_TUNE4H_PRE64;
     }
     else
     {
-        pdw1000local->sysCFGreg &= (~SYS_CFG_RXM110K) ;
+        regs->tune1b = DRX_TUNE1b_850K_6M8;
+        regs->tune4h = DRX_TUNE4H_PRE128PLUS;
     }
 
-    pdw1000local->longFrames = config->phrMode ;
+    regs->tune2 = digital_bb_config[prfIndex][config->rxPAC];
+    regs->sfdToc = config->sfdTO;
+    regs->agcTune1 = agc_config.target[prfIndex];
+
+    // (Non-standard) user SFD for improved performance
+    if(config->nsSFD)
+    {
+        regs->usrSfd = dwnsSFDlen[config->dataRate];
+        nsSfd_result = 3 ;
+        useDWnsSFD = 1 ;
+    }
+    else
+    {
+        regs->usrSfd = 0;
+    }
 
-    pdw1000local->sysCFGreg &= ~SYS_CFG_PHR_MODE_11;
-    pdw1000local->sysCFGreg |= (SYS_CFG_PHR_MODE_11 & ((uint32_t)config->phrMode << SYS_CFG_PHR_MODE_SHFT));
+    regs->chanCtrl = (CHAN_CTRL_TX_CHAN_MASK & (chan << CHAN_CTRL_TX_CHAN_SHIFT)) | // Transmit Channel
+                     (CHAN_CTRL_RX_CHAN_MASK & (chan << CHAN_CTRL_RX_CHAN_SHIFT)) | // Receive Channel
+                     (CHAN_CTRL_RXFPRF_MASK & ((uint32_t)config->prf << CHAN_CTRL_RXFPRF_SHIFT)) | // RX PRF
+                     ((CHAN_CTRL_TNSSFD|CHAN_CTRL_RNSSFD) & ((uint32_t)nsSfd_result << CHAN_CTRL_TNSSFD_SHIFT)) | // nsSFD enable RX&TX
+                     (CHAN_CTRL_DWSFD & ((uint32_t)useDWnsSFD << CHAN_CTRL_DWSFD_SHIFT)) | // Use DW nsSFD
+                     (CHAN_CTRL_TX_PCOD_MASK & ((uint32_t)config->txCode << CHAN_CTRL_TX_PCOD_SHIFT)) | // TX Preamble Code
+                     (CHAN_CTRL_RX_PCOD_MASK & ((uint32_t)config->rxCode << CHAN_CTRL_RX_PCOD_SHIFT)) ; // RX Preamble Code
 
-    dwt_write32bitreg(SYS_CFG_ID,pdw1000local->sysCFGreg) ;
-    // Set the lde_replicaCoeff
-    dwt_write16bitoffsetreg(LDE_IF_ID, LDE_REPC_OFFSET, reg16) ;
+    // TX Preamble Size, PRF and Data Rate
+    regs->txFctrl = ((uint32_t)(config->txPreambLength | config->prf) << TX_FCTRL_TXPRF_SHFT) | ((uint32_t)config->dataRate << TX_FCTRL_TXBR_SHFT);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_stagereset()
+ *
+ * @brief empties the staging area of the configuration burst
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_stagereset(void)
+{
+    pdw1000local->configNxfer = 0;
+    pdw1000local->configNdata = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_stagewrite()
+ *
+ * @brief adds a register write to the configuration burst
+ *
+ * input parameters
+ * @param regFileID - ID of register file being accessed
+ * @param regOffset - the index into register file
+ * @param length    - number of bytes to write (1, 2 or 4)
+ * @param regval    - the value to write
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_stagewrite(int regFileID, int regOffset, uint16_t length, uint32_t regval)
+{
+    uint8_t *buffer = &pdw1000local->configData[pdw1000local->configNdata];
+    int j ;
+
+#ifdef DWT_API_ERROR_CHECK
+    assert(pdw1000local->configNxfer < CONFIG_XFER_MAX);
+    assert(pdw1000local->configNdata + length <= CONFIG_DATA_MAX);
+#endif
+
+    for ( j = 0 ; j < length ; j++ )
+    {
+        buffer[j] = (uint8_t)(regval >> (8 * j)) ;
+    }
+
+    dwt_xferwrite(&pdw1000local->configXfer[pdw1000local->configNxfer++], regFileID, regOffset, length, buffer);
+    pdw1000local->configNdata += length;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_writeconfig()
+ *
+ * @brief writes the registers of a configuration in one SPI burst, either all of them or only the ones that differ
+ * from a previous configuration. SYS_CFG, CHAN_CTRL and TX_FCTRL go through the register shadows. The writes are
+ * appended to the ones already staged by the caller, see _dwt_stagereset().
+ *
+ * input parameters
+ * @param regs - the register values to apply
+ * @param prev - the register values the device currently holds, NULL to write everything
+ *
+ * output parameters
+ *
+ * returns the number of register writes issued, or DWT_ERROR if the SPI transfer failed
+ */
+#define CONFIG_CHANGED(field)   ((prev == NULL) || (regs->field != prev->field))
+
+static int _dwt_writeconfig(const dwt_configregs_t *regs, const dwt_configregs_t *prev)
+{
+    uint32_t sysconfig = (_dwt_readshadow(DWT_SHADOW_SYS_CFG) & ~CONFIG_SYS_CFG_BITS) | regs->sysCfg ;
+    int sfdreinit = 0 ;
+    int ret ;
+
+    if((prev == NULL) || (sysconfig != pdw1000local->shadow[DWT_SHADOW_SYS_CFG]))
+    {
+        _dwt_stagewrite(SYS_CFG_ID, 0, 4, sysconfig);
+    }
 
-    _dwt_configlde(prfIndex);
+    // Set the lde_replicaCoeff
+    if(CONFIG_CHANGED(repc))        _dwt_stagewrite(LDE_IF_ID, LDE_REPC_OFFSET, 2, regs->repc);
+    if(prev == NULL)                _dwt_stagewrite(LDE_IF_ID, LDE_CFG1_OFFSET, 1, LDE_PARAM1); // 8-bit configuration register
+    if(CONFIG_CHANGED(ldeCfg2))     _dwt_stagewrite(LDE_IF_ID, LDE_CFG2_OFFSET, 2, regs->ldeCfg2); // 16-bit LDE configuration tuning register
 
     // Configure PLL2/RF PLL block CFG/TUNE (for a given channel)
-    dwt_write32bitoffsetreg(FS_CTRL_ID, FS_PLLCFG_OFFSET, fs_pll_cfg[chan_idx[chan]]);
-    dwt_write8bitoffsetreg(FS_CTRL_ID, FS_PLLTUNE_OFFSET, fs_pll_tune[chan_idx[chan]]);
+    if(CONFIG_CHANGED(pllCfg))      _dwt_stagewrite(FS_CTRL_ID, FS_PLLCFG_OFFSET, 4, regs->pllCfg);
+    if(CONFIG_CHANGED(pllTune))     _dwt_stagewrite(FS_CTRL_ID, FS_PLLTUNE_OFFSET, 1, regs->pllTune);
 
     // Configure RF RX blocks (for specified channel/bandwidth)
-    dwt_write8bitoffsetreg(RF_CONF_ID, RF_RXCTRLH_OFFSET, rx_config[bw]);
+    if(CONFIG_CHANGED(rxCtrlh))     _dwt_stagewrite(RF_CONF_ID, RF_RXCTRLH_OFFSET, 1, regs->rxCtrlh);
 
-    // Configure RF TX blocks (for specified channel and PRF)
-    // Configure RF TX control
-    dwt_write32bitoffsetreg(RF_CONF_ID, RF_TXCTRL_OFFSET, tx_config[chan_idx[chan]]);
+    // Configure RF TX control (for specified channel and PRF)
+    if(CONFIG_CHANGED(txCtrl))      _dwt_stagewrite(RF_CONF_ID, RF_TXCTRL_OFFSET, 4, regs->txCtrl);
+
+    // Configure the baseband parameters: DTUNE0, DTUNE1, DTUNE2, DTUNE3 (SFD timeout)
+    if(CONFIG_CHANGED(tune0b))      _dwt_stagewrite(DRX_CONF_ID, DRX_TUNE0b_OFFSET, 2, regs->tune0b);
+    if(CONFIG_CHANGED(tune1a))      _dwt_stagewrite(DRX_CONF_ID, DRX_TUNE1a_OFFSET, 2, regs->tune1a);
+    if(CONFIG_CHANGED(tune1b))      _dwt_stagewrite(DRX_CONF_ID, DRX_TUNE1b_OFFSET, 2, regs->tune1b);
+    if(regs->tune4h && CONFIG_CHANGED(tune4h)) _dwt_stagewrite(DRX_CONF_ID, DRX_TUNE4H_OFFSET, 1, regs->tune4h);
+    if(CONFIG_CHANGED(tune2))       _dwt_stagewrite(DRX_CONF_ID, DRX_TUNE2_OFFSET, 4, regs->tune2);
+    if(CONFIG_CHANGED(sfdToc))      _dwt_stagewrite(DRX_CONF_ID, DRX_SFDTOC_OFFSET, 2, regs->sfdToc);
 
-    // Configure the baseband parameters (for specified PRF, bit rate, PAC, and SFD settings)
-    // DTUNE0
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE0b_OFFSET, sftsh[config->dataRate][config->nsSFD]);
+    // Configure AGC parameters
+    if(prev == NULL)                _dwt_stagewrite(AGC_CFG_STS_ID, 0xC, 4, agc_config.lo32);
+    if(CONFIG_CHANGED(agcTune1))    _dwt_stagewrite(AGC_CFG_STS_ID, 0x4, 2, regs->agcTune1);
 
-    // DTUNE1
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1a_OFFSET, dtune1[prfIndex]);
+    // Write non standard (DW) SFD length
+    if(regs->usrSfd && CONFIG_CHANGED(usrSfd)) _dwt_stagewrite(USR_SFD_ID, 0x00, 1, regs->usrSfd);
 
-    if(config->dataRate == DWT_BR_110K)
+    if(CONFIG_CHANGED(chanCtrl))
     {
-        dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_110K);
+        _dwt_stagewrite(CHAN_CTRL_ID, 0, 4, regs->chanCtrl);
+        sfdreinit = 1;
     }
-    else
+    if(CONFIG_CHANGED(txFctrl))
     {
-        if(config->txPreambLength == DWT_PLEN_64)
-        {
-            dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_6M8_PRE64);
-            dwt_write8bitoffsetreg(DRX_CONF_ID, DRX_TUNE4H_OFFSET, DRX_TUNE4H_PRE64);
-        }
-        else
-        {
-            dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_TUNE1b_OFFSET, DRX_TUNE1b_850K_6M8);
-            dwt_write8bitoffsetreg(DRX_CONF_ID, DRX_TUNE4H_OFFSET, DRX_TUNE4H_PRE128PLUS);
-        }
+        _dwt_stagewrite(TX_FCTRL_ID, 0, 4, regs->txFctrl);
+        sfdreinit = 1;
     }
 
-    // DTUNE2
-    dwt_write32bitoffsetreg(DRX_CONF_ID, DRX_TUNE2_OFFSET, digital_bb_config[prfIndex][config->rxPAC]);
+    // The SFD transmit pattern is initialised by the DW1000 upon a user TX request, but (due to an IC issue) it is not done for an auto-ACK TX. The
+    // SYS_CTRL write below works around this issue, by simultaneously initiating and aborting a transmission, which correctly initialises the SFD
+    // after its configuration or reconfiguration.
+    // This issue is not documented at the time of writing this code. It should be in next release of DW1000 User Manual (v2.09, from July 2016).
+    if(sfdreinit)
+    {
+        _dwt_stagewrite(SYS_CTRL_ID, SYS_CTRL_OFFSET, 1, SYS_CTRL_TXSTRT | SYS_CTRL_TRXOFF); // Request TX start and TRX off at the same time
+    }
+
+    ret = (pdw1000local->configNxfer == 0) ? 0 : transferspi(pdw1000local->configXfer, pdw1000local->configNxfer);
+
+    // Whatever the outcome the shadows must not claim values the device may not hold
+    if(ret != 0)
+    {
+        pdw1000local->shadowValid = 0;
+        pdw1000local->configValid = 0;
+        return DWT_ERROR;
+    }
+
+    pdw1000local->shadow[DWT_SHADOW_SYS_CFG] = sysconfig;
+    pdw1000local->shadow[DWT_SHADOW_CHAN_CTRL] = regs->chanCtrl;
+    pdw1000local->shadow[DWT_SHADOW_TX_FCTRL] = regs->txFctrl;
+    pdw1000local->shadowValid |= (1 << DWT_SHADOW_CHAN_CTRL) | (1 << DWT_SHADOW_TX_FCTRL);
+    pdw1000local->txFCTRL = regs->txFctrl;
+
+    return pdw1000local->configNxfer;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_configure()
+ *
+ * @brief This function provides the main API for the configuration of the
+ * DW1000 and this low-level driver.  The input is a pointer to the data structure
+ * of type dwt_config_t that holds all the configurable items.
+ * The dwt_config_t structure shows which ones are supported
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_configure(dwt_config_t *config)
+{
+#ifdef DWT_API_ERROR_CHECK
+    uint8_t chan = config->chan ;
+
+    assert(config->dataRate <= DWT_BR_6M8);
+    assert(config->rxPAC <= DWT_PAC64);
+    assert((chan >= 1) && (chan <= 7) && (chan != 6));
+    assert(((config->prf == DWT_PRF_64M) && (config->txCode >= 9) && (config->txCode <= 24))
+           || ((config->prf == DWT_PRF_16M) && (config->txCode >= 1) && (config->txCode <= 8)));
+    assert(((config->prf == DWT_PRF_64M) && (config->rxCode >= 9) && (config->rxCode <= 24))
+           || ((config->prf == DWT_PRF_16M) && (config->rxCode >= 1) && (config->rxCode <= 8)));
+    assert((config->txPreambLength == DWT_PLEN_64) || (config->txPreambLength == DWT_PLEN_128) || (config->txPreambLength == DWT_PLEN_256)
+           || (config->txPreambLength == DWT_PLEN_512) || (config->txPreambLength == DWT_PLEN_1024) || (config->txPreambLength == DWT_PLEN_1536)
+           || (config->txPreambLength == DWT_PLEN_2048) || (config->txPreambLength == DWT_PLEN_4096));
+    assert((config->phrMode == DWT_PHRMODE_STD) || (config->phrMode == DWT_PHRMODE_EXT));
+#endif
 
     // DTUNE3 (SFD timeout)
     // Don't allow 0 - SFD timeout will always be enabled
@@ -748,40 +1068,57 @@ void dwt_configure(dwt_config_t *config)
     {
         config->sfdTO = DWT_SFDTOC_DEF;
     }
-    dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_SFDTOC_OFFSET, config->sfdTO);
 
-    // Configure AGC parameters
-    dwt_write32bitoffsetreg( AGC_CFG_STS_ID, 0xC, agc_config.lo32);
-    dwt_write16bitoffsetreg( AGC_CFG_STS_ID, 0x4, agc_config.target[prfIndex]);
+    pdw1000local->longFrames = config->phrMode ;
 
-    // Set (non-standard) user SFD for improved performance,
-    if(config->nsSFD)
+    _dwt_configregs(config, &pdw1000local->configRegs);
+    _dwt_stagereset();
+    pdw1000local->configValid = (_dwt_writeconfig(&pdw1000local->configRegs, NULL) != DWT_ERROR);
+} // end dwt_configure()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_reconfigure()
+ *
+ * @brief This function switches the DW1000 to a new configuration like dwt_configure(), but only writes the registers
+ * whose value differs from the last applied configuration, all of them in a single SPI burst. If no configuration is
+ * known to be applied (after dwt_initialise(), dwt_softreset() or sleep) it falls back to a full configuration.
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ *
+ * output parameters
+ *
+ * returns the number of register writes issued (0 if nothing changed), or DWT_ERROR if the SPI transfer failed
+ */
+int dwt_reconfigure(dwt_config_t *config)
+{
+    dwt_configregs_t regs ;
+    int ret ;
+
+    if(!pdw1000local->configValid)
     {
-        // Write non standard (DW) SFD length
-        dwt_write8bitoffsetreg(USR_SFD_ID, 0x00, dwnsSFDlen[config->dataRate]);
-        nsSfd_result = 3 ;
-        useDWnsSFD = 1 ;
+        dwt_configure(config);
+        return pdw1000local->configValid ? pdw1000local->configNxfer : DWT_ERROR ;
     }
-    regval =  (CHAN_CTRL_TX_CHAN_MASK & (chan << CHAN_CTRL_TX_CHAN_SHIFT)) | // Transmit Channel
-              (CHAN_CTRL_RX_CHAN_MASK & (chan << CHAN_CTRL_RX_CHAN_SHIFT)) | // Receive Channel
-              (CHAN_CTRL_RXFPRF_MASK & ((uint32_t)config->prf << CHAN_CTRL_RXFPRF_SHIFT)) | // RX PRF
-              ((CHAN_CTRL_TNSSFD|CHAN_CTRL_RNSSFD) & ((uint32_t)nsSfd_result << CHAN_CTRL_TNSSFD_SHIFT)) | // nsSFD enable RX&TX
-              (CHAN_CTRL_DWSFD & ((uint32_t)useDWnsSFD << CHAN_CTRL_DWSFD_SHIFT)) | // Use DW nsSFD
-              (CHAN_CTRL_TX_PCOD_MASK & ((uint32_t)config->txCode << CHAN_CTRL_TX_PCOD_SHIFT)) | // TX Preamble Code
-              (CHAN_CTRL_RX_PCOD_MASK & ((uint32_t)config->rxCode << CHAN_CTRL_RX_PCOD_SHIFT)) ; // RX Preamble Code
 
-    dwt_write32bitreg(CHAN_CTRL_ID,regval) ;
+    if(config->sfdTO == 0)
+    {
+        config->sfdTO = DWT_SFDTOC_DEF;
+    }
 
-    // Set up TX Preamble Size, PRF and Data Rate
-    pdw1000local->txFCTRL = ((uint32_t)(config->txPreambLength | config->prf) << TX_FCTRL_TXPRF_SHFT) | ((uint32_t)config->dataRate << TX_FCTRL_TXBR_SHFT);
-    dwt_write32bitreg(TX_FCTRL_ID, pdw1000local->txFCTRL);
+    _dwt_configregs(config, &regs);
+    _dwt_stagereset();
+    ret = _dwt_writeconfig(&regs, &pdw1000local->configRegs);
 
-    // The SFD transmit pattern is initialised by the DW1000 upon a user TX request, but (due to an IC issue) it is not done for an auto-ACK TX. The
-    // SYS_CTRL write below works around this issue, by simultaneously initiating and aborting a transmission, which correctly initialises the SFD
-    // after its configuration or reconfiguration.
-    // This issue is not documented at the time of writing this code. It should be in next release of DW1000 User Manual (v2.09, from July 2016).
-    dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, SYS_CTRL_TXSTRT | SYS_CTRL_TRXOFF); // Request TX start and TRX off at the same time
-} // end dwt_configure()
+    if(ret != DWT_ERROR)
+    {
+        pdw1000local->configRegs = regs ;
+        pdw1000local->configValid = 1 ;
+        pdw1000local->longFrames = config->phrMode ;
+    }
+
+    return ret ;
+} // end dwt_reconfigure()
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_setrxantennadelay()
@@ -800,6 +1137,8 @@ void dwt_setrxantennadelay(uint16_t rxDelay)
 {
     // Set the RX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(LDE_IF_ID, LDE_RXANTD_OFFSET, rxDelay);
+    pdw1000local->rxAntDly = rxDelay;
+    pdw1000local->restoreMask |= RESTORE_RXANTD;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -819,6 +1158,8 @@ void dwt_settxantennadelay(uint16_t txDelay)
 {
     // Set the TX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(TX_ANTD_ID, TX_ANTD_OFFSET, txDelay);
+    pdw1000local->txAntDly = txDelay;
+    pdw1000local->restoreMask |= RESTORE_TXANTD;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -890,7 +1231,7 @@ void dwt_writetxfctrl(uint16_t txFrameLength, uint16_t txBufferOffset, int rangi
     // Write the frame length to the TX frame control register
     // pdw1000local->txFCTRL has kept configured bit rate information
     uint32_t reg32 = pdw1000local->txFCTRL | txFrameLength | ((uint32_t)txBufferOffset << TX_FCTRL_TXBOFFS_SHFT) | ((uint32_t)ranging << TX_FCTRL_TR_SHFT);
-    dwt_write32bitreg(TX_FCTRL_ID, reg32);
+    _dwt_writeshadow(DWT_SHADOW_TX_FCTRL, reg32) ; // Skipped when sending the same length again
 } // end dwt_writetxfctrl()
 
 
@@ -957,15 +1298,10 @@ void dwt_readaccdata(uint8_t *buffer, uint16_t len, uint16_t accOffset)
 #define B20_SIGN_EXTEND_TEST (0x00100000UL)
 #define B20_SIGN_EXTEND_MASK (0xFFF00000UL)
 
-int32 dwt_readcarrierintegrator(void)
+static int32 _dwt_carrierint(const uint8_t *buffer)
 {
     uint32_t  regval = 0 ;
     int     j ;
-    uint8_t   buffer[DRX_CARRIER_INT_LEN] ;
-
-    /* Read 3 bytes into buffer (21-bit quantity) */
-
-    dwt_readfromdevice(DRX_CONF_ID,DRX_CARRIER_INT_OFFSET,DRX_CARRIER_INT_LEN, buffer) ;
 
     for (j = 2 ; j >= 0 ; j --)  // arrange the three bytes into an unsigned integer value
     {
@@ -978,10 +1314,22 @@ int32 dwt_readcarrierintegrator(void)
     return (int32) regval ; // cast unsigned value to signed quantity.
 }
 
+int32 dwt_readcarrierintegrator(void)
+{
+    uint8_t   buffer[DRX_CARRIER_INT_LEN] ;
+
+    /* Read 3 bytes into buffer (21-bit quantity) */
+
+    dwt_readfromdevice(DRX_CONF_ID,DRX_CARRIER_INT_OFFSET,DRX_CARRIER_INT_LEN, buffer) ;
+
+    return _dwt_carrierint(buffer) ;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readdiagnostics()
  *
- * @brief this function reads the RX signal quality diagnostic data
+ * @brief this function reads the RX signal quality diagnostic data, together with the carrier integrator, in one SPI
+ * batch
  *
  * input parameters
  * @param diagnostics - diagnostic structure pointer, this will contain the diagnostic data read from the DW1000
@@ -992,18 +1340,51 @@ int32 dwt_readcarrierintegrator(void)
  */
 void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
 {
+    dwt_spixfer_t xfer[6];
+    uint8_t fpindex[2];
+    uint8_t maxnoise[2];
+    uint8_t fpampl1[2];
+    uint8_t finfo[4];
+    uint8_t carrier[DRX_CARRIER_INT_LEN];
+
+    // Read all the diagnostic registers in one batch, RX_FQUAL (8 bytes) goes directly into the structure
+    dwt_xferread(&xfer[0], RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET, 2, fpindex);
+    dwt_xferread(&xfer[1], LDE_IF_ID, LDE_THRESH_OFFSET, 2, maxnoise);
+    dwt_xferread(&xfer[2], RX_FQUAL_ID, 0x0, 8, (uint8_t*)&diagnostics->stdNoise);
+    dwt_xferread(&xfer[3], RX_TIME_ID, RX_TIME_FP_AMPL1_OFFSET, 2, fpampl1);
+    dwt_xferread(&xfer[4], RX_FINFO_ID, 0x0, 4, finfo);
+    dwt_xferread(&xfer[5], DRX_CONF_ID, DRX_CARRIER_INT_OFFSET, DRX_CARRIER_INT_LEN, carrier);
+    transferspi(xfer, 6);
+
     // Read the HW FP index
-    diagnostics->firstPath = dwt_read16bitoffsetreg(RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET);
+    diagnostics->firstPath = (uint16_t)((fpindex[1] << 8) | fpindex[0]);
 
     // LDE diagnostic data
-    diagnostics->maxNoise = dwt_read16bitoffsetreg(LDE_IF_ID, LDE_THRESH_OFFSET);
+    diagnostics->maxNoise = (uint16_t)((maxnoise[1] << 8) | maxnoise[0]);
 
-    // Read all 8 bytes in one SPI transaction
-    dwt_readfromdevice(RX_FQUAL_ID, 0x0, 8, (uint8_t*)&diagnostics->stdNoise);
+    diagnostics->firstPathAmp1 = (uint16_t)((fpampl1[1] << 8) | fpampl1[0]);
 
-    diagnostics->firstPathAmp1 = dwt_read16bitoffsetreg(RX_TIME_ID, RX_TIME_FP_AMPL1_OFFSET);
+    diagnostics->rxPreamCount = ((((uint32_t)finfo[3] << 24) | ((uint32_t)finfo[2] << 16) | ((uint32_t)finfo[1] << 8) | finfo[0])
+                                 & RX_FINFO_RXPACC_MASK) >> RX_FINFO_RXPACC_SHIFT;
 
-    diagnostics->rxPreamCount = (dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXPACC_MASK) >> RX_FINFO_RXPACC_SHIFT  ;
+    diagnostics->carrierIntegrator = _dwt_carrierint(carrier);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getrxprf()
+ *
+ * @brief This function returns the RX PRF the device is configured with, as needed to turn the RX diagnostics into
+ * power levels. It is served from the CHAN_CTRL shadow, so it normally costs no SPI access.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_PRF_16M or DWT_PRF_64M
+ */
+uint8_t dwt_getrxprf(void)
+{
+    return (uint8_t)((_dwt_readshadow(DWT_SHADOW_CHAN_CTRL) & CHAN_CTRL_RXFPRF_MASK) >> CHAN_CTRL_RXFPRF_SHIFT) ;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1139,15 +1520,64 @@ void dwt_readsystime(uint8_t * timestamp)
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_writetodevice()
+ * @fn _dwt_buildheader()
  *
- * @brief  this function is used to write to the DW1000 device registers
+ * @brief  this function composes the SPI transaction header used to access the DW1000 device registers
  * Notes:
- *        1. Firstly we create a header (the first byte is a header byte)
  *        a. check if sub index is used, if subindexing is used - set bit-6 to 1 to signify that the sub-index address follows the register index byte
  *        b. set bit-7 (or with 0x80) for write operation
  *        c. if extended sub address index is used (i.e. if index > 127) set bit-7 of the first sub-index byte following the first header byte
  *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param write         - 1 for a write operation, 0 for a read operation
+ * @param header        - pointer to a buffer of at least 3 bytes in which to compose the header
+ *
+ * output parameters
+ *
+ * returns the length of the header (1 to 3 bytes)
+ */
+static int _dwt_buildheader(uint16_t recordNumber, uint16_t index, int write, uint8_t *header)
+{
+    int   cnt = 0; // Counter for length of header
+    uint8_t rw = write ? 0x80 : 0x00 ; // Bit-7 selects the WRITE (1) or READ (0) operation
+#ifdef DWT_API_ERROR_CHECK
+    assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
+#endif
+
+    // Write message header selecting the operation and addresses as appropriate (this is one to three bytes long)
+    if (index == 0) // For index of 0, no sub-index is required
+    {
+        header[cnt++] = (uint8_t)(rw | recordNumber) ; // Bit-7 is the operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
+    }
+    else
+    {
+#ifdef DWT_API_ERROR_CHECK
+        assert(index <= 0x7FFF); // Index and sub-addressable area are limited to 15-bits.
+#endif
+        header[cnt++] = (uint8_t)(rw | 0x40 | recordNumber) ; // Bit-7 is the operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+
+        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
+        {
+            header[cnt++] = (uint8_t)index ; // Bit-7 zero means no extension, bits 6-0 is index.
+        }
+        else
+        {
+            header[cnt++] = 0x80 | (uint8_t)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
+            header[cnt++] =  (uint8_t) (index >> 7) ; // 8-bit value = high eight bits of index.
+        }
+    }
+
+    return cnt;
+} // end _dwt_buildheader()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_writetodevice()
+ *
+ * @brief  this function is used to write to the DW1000 device registers
+ * Notes:
+ *        1. Firstly we create a header (the first byte is a header byte), see _dwt_buildheader()
  *        2. Write the header followed by the data bytes to the DW1000 device
  *
  *
@@ -1167,36 +1597,15 @@ void dwt_writetodevice
     uint16_t  index,
     uint32_t        length,
     const uint8_t   *buffer
-)
-{
-    uint8_t header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
-#ifdef DWT_API_ERROR_CHECK
-    assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
-#endif
-
-    // Write message header selecting WRITE operation and addresses as appropriate (this is one to three bytes long)
-    if (index == 0) // For index of 0, no sub-index is required
-    {
-        header[cnt++] = 0x80 | recordNumber ; // Bit-7 is WRITE operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
-    }
-    else
-    {
+)
+{
+    uint8_t header[3] ; // Buffer to compose header in
+    int   cnt ; // Length of header
 #ifdef DWT_API_ERROR_CHECK
-        assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
+    assert((index + length) <= 0x7FFF); // Sub-addressable area is limited to 15-bits.
 #endif
-        header[cnt++] = 0xC0 | recordNumber ; // Bit-7 is WRITE operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
 
-        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
-        {
-            header[cnt++] = (uint8_t)index ; // Bit-7 zero means no extension, bits 6-0 is index.
-        }
-        else
-        {
-            header[cnt++] = 0x80 | (uint8_t)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
-            header[cnt++] =  (uint8_t) (index >> 7) ; // 8-bit value = high eight bits of index.
-        }
-    }
+    cnt = _dwt_buildheader(recordNumber, index, 1, header);
 
     // Write it to the SPI
     writetospi(cnt,header,length,buffer);
@@ -1207,11 +1616,7 @@ void dwt_writetodevice
  *
  * @brief  this function is used to read from the DW1000 device registers
  * Notes:
- *        1. Firstly we create a header (the first byte is a header byte)
- *        a. check if sub index is used, if subindexing is used - set bit-6 to 1 to signify that the sub-index address follows the register index byte
- *        b. set bit-7 (or with 0x80) for write operation
- *        c. if extended sub address index is used (i.e. if index > 127) set bit-7 of the first sub-index byte following the first header byte
- *
+ *        1. Firstly we create a header (the first byte is a header byte), see _dwt_buildheader()
  *        2. Write the header followed by the data bytes to the DW1000 device
  *        3. Store the read data in the input buffer
  *
@@ -1234,38 +1639,67 @@ void dwt_readfromdevice
 )
 {
     uint8_t header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
-#ifdef DWT_API_ERROR_CHECK
-    assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
-#endif
-
-    // Write message header selecting READ operation and addresses as appropriate (this is one to three bytes long)
-    if (index == 0) // For index of 0, no sub-index is required
-    {
-        header[cnt++] = (uint8_t) recordNumber ; // Bit-7 zero is READ operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
-    }
-    else
-    {
+    int   cnt ; // Length of header
 #ifdef DWT_API_ERROR_CHECK
-        assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
+    assert((index + length) <= 0x7FFF); // Sub-addressable area is limited to 15-bits.
 #endif
-        header[cnt++] = (uint8_t)(0x40 | recordNumber) ; // Bit-7 zero is READ operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
 
-        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
-        {
-            header[cnt++] = (uint8_t) index ; // Bit-7 zero means no extension, bits 6-0 is index.
-        }
-        else
-        {
-            header[cnt++] = 0x80 | (uint8_t)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
-            header[cnt++] =  (uint8_t) (index >> 7) ; // 8-bit value = high eight bits of index.
-        }
-    }
+    cnt = _dwt_buildheader(recordNumber, index, 0, header);
 
     // Do the read from the SPI
     readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
 } // end dwt_readfromdevice()
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_xferread()
+ *
+ * @brief  this function fills in an SPI transaction descriptor reading from the DW1000 device registers, so that
+ * several accesses can be handed to transferspi() and run back-to-back in one batch
+ *
+ * input parameters:
+ * @param xfer          - pointer to the descriptor to fill in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data (must stay valid until the batch is done)
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_xferread(dwt_spixfer_t *xfer, uint16_t recordNumber, uint16_t index, uint16_t length, uint8_t *buffer)
+{
+    xfer->headerLength = (uint16_t)_dwt_buildheader(recordNumber, index, 0, xfer->header);
+    xfer->length = length;
+    xfer->txBuffer = NULL;
+    xfer->rxBuffer = buffer;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_xferwrite()
+ *
+ * @brief  this function fills in an SPI transaction descriptor writing to the DW1000 device registers, so that
+ * several accesses can be handed to transferspi() and run back-to-back in one batch
+ *
+ * input parameters:
+ * @param xfer          - pointer to the descriptor to fill in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written
+ * @param buffer        - pointer to buffer containing the bytes to be written (must stay valid until the batch is done)
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_xferwrite(dwt_spixfer_t *xfer, uint16_t recordNumber, uint16_t index, uint16_t length, const uint8_t *buffer)
+{
+    xfer->headerLength = (uint16_t)_dwt_buildheader(recordNumber, index, 1, xfer->header);
+    xfer->length = length;
+    xfer->txBuffer = buffer;
+    xfer->rxBuffer = NULL;
+}
+
 
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1437,7 +1871,7 @@ void dwt_write32bitoffsetreg(int regFileID, int regOffset, uint32_t regval)
  */
 void dwt_enableframefilter(uint16_t enable)
 {
-    uint32_t sysconfig = SYS_CFG_MASK & dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
+    uint32_t sysconfig = _dwt_readshadow(DWT_SHADOW_SYS_CFG) ; // Read sysconfig register
 
     if(enable)
     {
@@ -1450,8 +1884,7 @@ void dwt_enableframefilter(uint16_t enable)
         sysconfig &= ~(SYS_CFG_FFE);
     }
 
-    pdw1000local->sysCFGreg = sysconfig ;
-    dwt_write32bitreg(SYS_CFG_ID,sysconfig) ;
+    _dwt_writeshadow(DWT_SHADOW_SYS_CFG, sysconfig) ;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1893,6 +2326,13 @@ void dwt_entersleep(void)
 {
     // Copy config to AON - upload the new configuration
     _dwt_aonarrayupload();
+
+    // What comes back on wake-up depends on the AON configuration, reload the shadows then, or write them back with
+    // dwt_restoreconfig()
+    pdw1000local->shadowSlept = pdw1000local->shadowValid;
+    pdw1000local->configSlept = pdw1000local->configValid;
+    pdw1000local->shadowValid = 0;
+    pdw1000local->configValid = 0;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -2108,6 +2548,9 @@ int dwt_spicswakeup(uint8_t *buff, uint16_t length)
         // Need 5ms for XTAL to start and stabilise (could wait for PLL lock IRQ status bit !!!)
         // NOTE: Polling of the STATUS register is not possible unless frequency is < 3MHz
         deca_sleep(5);
+
+        pdw1000local->shadowValid = 0; // Device was asleep, its registers may not match the shadows
+        pdw1000local->configValid = 0;
     }
     else
     {
@@ -2122,6 +2565,155 @@ int dwt_spicswakeup(uint8_t *buff, uint16_t length)
     return DWT_SUCCESS;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_spicswakeuppoll()
+ *
+ * @brief wakes the device up like dwt_spicswakeup(), but instead of waiting a fixed 5ms for the XTAL and PLL it polls
+ * SYS_STATUS until the clock PLL has locked, which is typically much sooner. The SLP2INIT and CPLOCK events are left
+ * set, dwt_restoreconfig() clears them.
+ *
+ * NOTE: Polling of the STATUS register is not possible unless the SPI frequency is < 3MHz
+ *
+ * input parameters
+ * @param buff     - this is a pointer to the dummy buffer which will be used in the SPI read transaction used for the WAKE UP of the device
+ * @param length   - this is the length of the dummy buffer, enough to hold the chip select low for 500us
+ * @param maxpolls - SYS_STATUS reads before giving up
+ *
+ * output parameters
+ *
+ * returns the number of SYS_STATUS reads it took (0 if the device was awake), or DWT_ERROR if the PLL did not lock
+ */
+int dwt_spicswakeuppoll(uint8_t *buff, uint16_t length, uint16_t maxpolls)
+{
+    uint16_t polls = 0;
+
+    if(dwt_readdevid() == DWT_DEVICE_ID)
+    {
+        return 0;
+    }
+
+    // Need to keep chip select line low for at least 500us
+    dwt_readfromdevice(0x0, 0x0, length, buff);
+
+    pdw1000local->shadowValid = 0; // Device was asleep, its registers may not match the shadows
+    pdw1000local->configValid = 0;
+
+    while(polls < maxpolls)
+    {
+        polls++;
+        if(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_CPLOCK)
+        {
+            return (dwt_readdevid() == DWT_DEVICE_ID) ? polls : DWT_ERROR;
+        }
+    }
+
+    return DWT_ERROR;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_restoreconfig()
+ *
+ * @brief after a wake up, writes back in one SPI burst what the device held when dwt_entersleep() was called: the
+ * configuration of the last dwt_configure()/dwt_reconfigure(), the interrupt mask and the antenna delays, XTAL trim and
+ * TX spectrum set through the API. Only the shadows of the registers written in the burst are valid again afterwards:
+ * SYS_MASK, and with the configuration SYS_CFG, CHAN_CTRL and TX_FCTRL. The others are read back on first use.
+ * The wake up events (SLP2INIT, CPLOCK) are cleared in the same burst.
+ *
+ * NOTE: the transceiver must be idle, e.g. straight after dwt_spicswakeuppoll()
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns the number of register writes issued, or DWT_ERROR if the SPI transfer failed
+ */
+int dwt_restoreconfig(void)
+{
+    uint8_t mask = pdw1000local->restoreMask;
+    uint8_t slept = pdw1000local->shadowSlept;
+    uint8_t written = 0; // Shadows written back by this burst
+    int ret;
+
+    // The device has just woken up, none of the shadows is known to match it yet
+    pdw1000local->shadowValid = 0;
+
+    _dwt_stagereset();
+    _dwt_stagewrite(SYS_STATUS_ID, 0, 4, SYS_STATUS_SLP2INIT | SYS_STATUS_CPLOCK);
+    if(mask & RESTORE_XTALT)    _dwt_stagewrite(FS_CTRL_ID, FS_XTALT_OFFSET, 1, pdw1000local->xtalTrim);
+    if(mask & RESTORE_RXANTD)   _dwt_stagewrite(LDE_IF_ID, LDE_RXANTD_OFFSET, 2, pdw1000local->rxAntDly);
+    if(mask & RESTORE_TXANTD)   _dwt_stagewrite(TX_ANTD_ID, TX_ANTD_OFFSET, 2, pdw1000local->txAntDly);
+    if(mask & RESTORE_TXRF)
+    {
+        _dwt_stagewrite(TX_CAL_ID, TC_PGDELAY_OFFSET, 1, pdw1000local->txConfig.PGdly);
+        _dwt_stagewrite(TX_POWER_ID, 0, 4, pdw1000local->txConfig.power);
+    }
+    if(slept & (1 << DWT_SHADOW_SYS_MASK))
+    {
+        _dwt_stagewrite(SYS_MASK_ID, 0, 4, pdw1000local->shadow[DWT_SHADOW_SYS_MASK]);
+        written |= (1 << DWT_SHADOW_SYS_MASK);
+    }
+
+    if(pdw1000local->configSlept)
+    {
+        // SYS_CFG is rebuilt from its value before sleep rather than from what the device came back with
+        pdw1000local->shadowValid = slept & (1 << DWT_SHADOW_SYS_CFG);
+
+        // Appends the full configuration and sends everything, SYS_CFG, CHAN_CTRL and TX_FCTRL included
+        ret = _dwt_writeconfig(&pdw1000local->configRegs, NULL);
+        pdw1000local->configValid = (ret != DWT_ERROR);
+        if(ret == DWT_ERROR)
+        {
+            return DWT_ERROR; // _dwt_writeconfig() has invalidated the shadows
+        }
+        pdw1000local->shadowValid = written | (1 << DWT_SHADOW_SYS_CFG) | (1 << DWT_SHADOW_CHAN_CTRL) | (1 << DWT_SHADOW_TX_FCTRL);
+        return ret;
+    }
+
+    ret = transferspi(pdw1000local->configXfer, pdw1000local->configNxfer);
+    if(ret != 0)
+    {
+        return DWT_ERROR;
+    }
+    pdw1000local->shadowValid = written;
+    return pdw1000local->configNxfer;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getotpcache()
+ *
+ * @brief copies the OTP words dwt_initialise() has read so far, e.g. to keep them in memory that survives a power down
+ * of the micro
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param cache - the OTP words, valid says which
+ *
+ * no return value
+ */
+void dwt_getotpcache(dwt_otpcache_t *cache)
+{
+    *cache = pdw1000local->otpCache;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setotpcache()
+ *
+ * @brief hands OTP words saved with dwt_getotpcache() back to the driver, before dwt_initialise(), so that it does not
+ * read them again
+ *
+ * input parameters
+ * @param cache - the OTP words, as read from the same device
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_setotpcache(const dwt_otpcache_t *cache)
+{
+    pdw1000local->otpCache = *cache;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn _dwt_configlde()
  *
@@ -2218,19 +2810,19 @@ void dwt_loadopsettabfromotp(uint8_t ops_sel)
 void dwt_setsmarttxpower(int enable)
 {
     // Config system register
-    pdw1000local->sysCFGreg = dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
+    uint32_t sysconfig = _dwt_readshadow(DWT_SHADOW_SYS_CFG) ; // Read sysconfig register
 
     // Disable smart power configuration
     if(enable)
     {
-        pdw1000local->sysCFGreg &= ~(SYS_CFG_DIS_STXP) ;
+        sysconfig &= ~(SYS_CFG_DIS_STXP) ;
     }
     else
     {
-        pdw1000local->sysCFGreg |= SYS_CFG_DIS_STXP ;
+        sysconfig |= SYS_CFG_DIS_STXP ;
     }
 
-    dwt_write32bitreg(SYS_CFG_ID,pdw1000local->sysCFGreg) ;
+    _dwt_writeshadow(DWT_SHADOW_SYS_CFG, sysconfig) ;
 }
 
 
@@ -2253,8 +2845,7 @@ void dwt_enableautoack(uint8_t responseDelayTime)
     // Set auto ACK reply delay
     dwt_write8bitoffsetreg(ACK_RESP_T_ID, ACK_RESP_T_ACK_TIM_OFFSET, responseDelayTime); // In symbols
     // Enable auto ACK
-    pdw1000local->sysCFGreg |= SYS_CFG_AUTOACK;
-    dwt_write32bitreg(SYS_CFG_ID,pdw1000local->sysCFGreg) ;
+    _dwt_writeshadow(DWT_SHADOW_SYS_CFG, _dwt_readshadow(DWT_SHADOW_SYS_CFG) | SYS_CFG_AUTOACK) ;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -2271,20 +2862,22 @@ void dwt_enableautoack(uint8_t responseDelayTime)
  */
 void dwt_setdblrxbuffmode(int enable)
 {
+    uint32_t sysconfig = _dwt_readshadow(DWT_SHADOW_SYS_CFG) ;
+
     if(enable)
     {
         // Enable double RX buffer mode
-        pdw1000local->sysCFGreg &= ~SYS_CFG_DIS_DRXB;
+        sysconfig &= ~SYS_CFG_DIS_DRXB;
         pdw1000local->dblbuffon = 1;
     }
     else
     {
         // Disable double RX buffer mode
-        pdw1000local->sysCFGreg |= SYS_CFG_DIS_DRXB;
+        sysconfig |= SYS_CFG_DIS_DRXB;
         pdw1000local->dblbuffon = 0;
     }
 
-    dwt_write32bitreg(SYS_CFG_ID,pdw1000local->sysCFGreg) ;
+    _dwt_writeshadow(DWT_SHADOW_SYS_CFG, sysconfig) ;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -2378,7 +2971,40 @@ uint8_t dwt_checkirq(void)
  */
 void dwt_isr(void)
 {
-    uint32_t status = pdw1000local->cbData.status = dwt_read32bitreg(SYS_STATUS_ID); // Read status register low 32bits
+    dwt_spixfer_t xfer[4];
+    uint8_t statusbytes[4];
+    uint8_t finfobytes[2];
+    uint32_t status;
+
+    // Fetch status, frame info, frame control and RX timestamp in one batch, the RX fields are only used on RXFCG
+    dwt_xferread(&xfer[0], SYS_STATUS_ID, 0, 4, statusbytes);
+    dwt_xferread(&xfer[1], RX_FINFO_ID, RX_FINFO_OFFSET, 2, finfobytes);
+    dwt_xferread(&xfer[2], RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl);
+    dwt_xferread(&xfer[3], RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, pdw1000local->cbData.rx_stamp);
+    transferspi(xfer, 4);
+
+    status = ((uint32_t)statusbytes[3] << 24) | ((uint32_t)statusbytes[2] << 16) | ((uint32_t)statusbytes[1] << 8) | statusbytes[0];
+    pdw1000local->cbData.status = status;
+
+    // Handle RX overrun event - Both RX buffers were full when another frame arrived (double buffered mode only). The
+    // buffered frames can no longer be trusted, so the receiver is reset and the pending RX events are dropped. The
+    // cbRxErr callback is called with SYS_STATUS_RXOVRR set in the status copy.
+    if(status & SYS_STATUS_RXOVRR)
+    {
+        dwt_forcetrxoff();
+        dwt_rxreset();
+
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXOVRR | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR | SYS_STATUS_ALL_RX_TO);
+        status &= ~(SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR | SYS_STATUS_ALL_RX_TO);
+
+        pdw1000local->wait4resp = 0;
+
+        // Call the corresponding callback if present
+        if(pdw1000local->cbRxErr != NULL)
+        {
+            pdw1000local->cbRxErr(&pdw1000local->cbData);
+        }
+    }
 
     // Handle RX good frame event
     if(status & SYS_STATUS_RXFCG)
@@ -2390,8 +3016,8 @@ void dwt_isr(void)
 
         pdw1000local->cbData.rx_flags = 0;
 
-        // Read frame info - Only the first two bytes of the register are used here.
-        finfo16 = dwt_read16bitoffsetreg(RX_FINFO_ID, RX_FINFO_OFFSET);
+        // Frame info - Only the first two bytes of the register are used here.
+        finfo16 = (uint16_t)(((uint16_t)finfobytes[1] << 8) | finfobytes[0]);
 
         // Report frame length - Standard frame length up to 127, extended frame length up to 1023 bytes
         len = finfo16 & RX_FINFO_RXFL_MASK_1023;
@@ -2407,8 +3033,7 @@ void dwt_isr(void)
             pdw1000local->cbData.rx_flags |= DWT_CB_DATA_RX_FLAG_RNG;
         }
 
-        // Report frame control - First bytes of the received frame.
-        dwt_readfromdevice(RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl);
+        // Frame control (first bytes of the received frame) and RX timestamp were fetched with the status above.
 
         // Because of a previous frame not being received properly, AAT bit can be set upon the proper reception of a frame not requesting for
         // acknowledgement (ACK frame is not actually sent though). If the AAT bit is set, check ACK request bit in frame control to confirm (this
@@ -2814,7 +3439,7 @@ void dwt_forcetrxoff(void)
     decaIrqStatus_t stat ;
     uint32_t mask;
 
-    mask = dwt_read32bitreg(SYS_MASK_ID) ; // Read set interrupt mask
+    mask = _dwt_readshadow(DWT_SHADOW_SYS_MASK) ; // Read set interrupt mask
 
     // Need to beware of interrupts occurring in the middle of following read modify write cycle
     // We can disable the radio, but before the status is cleared an interrupt can be set (e.g. the
@@ -3042,29 +3667,21 @@ int dwt_rxenable(int mode)
  */
 void dwt_setrxtimeout(uint16_t time)
 {
-    uint8_t temp ;
-
-    temp = dwt_read8bitoffsetreg(SYS_CFG_ID, 3); // Read at offset 3 to get the upper byte only
+    uint32_t sysconfig = _dwt_readshadow(DWT_SHADOW_SYS_CFG) ;
 
     if(time > 0)
     {
         dwt_write16bitoffsetreg(RX_FWTO_ID, RX_FWTO_OFFSET, time) ;
 
-        temp |= (uint8_t)(SYS_CFG_RXWTOE>>24); // Shift RXWTOE mask as we read the upper byte only
-        // OR in 32bit value (1 bit set), I know this is in high byte.
-        pdw1000local->sysCFGreg |= SYS_CFG_RXWTOE;
-
-        dwt_write8bitoffsetreg(SYS_CFG_ID, 3, temp); // Write at offset 3 to write the upper byte only
+        sysconfig |= SYS_CFG_RXWTOE;
     }
     else
     {
-        temp &= ~((uint8_t)(SYS_CFG_RXWTOE>>24)); // Shift RXWTOE mask as we read the upper byte only
-        // AND in inverted 32bit value (1 bit clear), I know this is in high byte.
-        pdw1000local->sysCFGreg &= ~(SYS_CFG_RXWTOE);
-
-        dwt_write8bitoffsetreg(SYS_CFG_ID, 3, temp); // Write at offset 3 to write the upper byte only
+        sysconfig &= ~(SYS_CFG_RXWTOE);
     }
 
+    _dwt_writeshadow(DWT_SHADOW_SYS_CFG, sysconfig) ; // Skipped if the enable bit does not change
+
 } // end dwt_setrxtimeout()
 
 
@@ -3122,11 +3739,11 @@ void dwt_setinterrupt(uint32_t bitmask, uint8_t operation)
 
     if(operation == 2)
     {
-        dwt_write32bitreg(SYS_MASK_ID, bitmask) ; // New value
+        _dwt_writeshadow(DWT_SHADOW_SYS_MASK, bitmask) ; // New value
     }
     else
     {
-        mask = dwt_read32bitreg(SYS_MASK_ID) ; // Read register
+        mask = _dwt_readshadow(DWT_SHADOW_SYS_MASK) ; // Read register
         if(operation == 1)
         {
             mask |= bitmask ;
@@ -3135,7 +3752,7 @@ void dwt_setinterrupt(uint32_t bitmask, uint8_t operation)
         {
             mask &= ~bitmask ; // Clear the bit
         }
-        dwt_write32bitreg(SYS_MASK_ID, mask) ; // New value
+        _dwt_writeshadow(DWT_SHADOW_SYS_MASK, mask) ; // New value
     }
 
     decamutexoff(stat) ;
@@ -3258,6 +3875,8 @@ void dwt_softreset(void)
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
 
     pdw1000local->wait4resp = 0;
+    pdw1000local->shadowValid = 0; // Registers are back to their reset values
+    pdw1000local->configValid = 0;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -3277,6 +3896,8 @@ void dwt_setxtaltrim(uint8_t value)
     // The 3 MSb in this 8-bit register must be kept to 0b011 to avoid any malfunction.
     uint8_t reg_val = (3 << 5) | (value & FS_XTALT_MASK);
     dwt_write8bitoffsetreg(FS_CTRL_ID, FS_XTALT_OFFSET, reg_val);
+    pdw1000local->xtalTrim = reg_val;
+    pdw1000local->restoreMask |= RESTORE_XTALT;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -3415,6 +4036,13 @@ uint16_t dwt_readtempvbat(uint8_t fastSPI)
     uint8_t vbat_raw;
     uint8_t temp_raw;
 
+    if(fastSPI == 1)
+    {
+        dwt_starttempvbat();
+        deca_sleep(1); // If using PLL clocks(and fast SPI rate) then this sleep is needed
+        return dwt_finishtempvbat();
+    }
+
     // These writes should be single writes and in sequence
     wr_buf[0] = 0x80; // Enable TLD Bias
     dwt_writetodevice(RF_CONF_ID,0x11,1,wr_buf);
@@ -3425,32 +4053,18 @@ uint16_t dwt_readtempvbat(uint8_t fastSPI)
     wr_buf[0] = 0x0f; // Enable Outputs (only after Biases are up and running)
     dwt_writetodevice(RF_CONF_ID,0x12,1,wr_buf);    //
 
-    if(fastSPI == 1)
-    {
-        // Reading All SAR inputs
-        wr_buf[0] = 0x00;
-        dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
-        wr_buf[0] = 0x01; // Set SAR enable
-        dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
-
-        deca_sleep(1); // If using PLL clocks(and fast SPI rate) then this sleep is needed
-        // Read voltage and temperature.
-        dwt_readfromdevice(TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET,2,wr_buf);
-    }
-    else //change to a slow clock
-    {
-        _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: set system clock to XTI - this is necessary to make sure the values read are reliable
-        // Reading All SAR inputs
-        wr_buf[0] = 0x00;
-        dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
-        wr_buf[0] = 0x01; // Set SAR enable
-        dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
+    // change to a slow clock
+    _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: set system clock to XTI - this is necessary to make sure the values read are reliable
+    // Reading All SAR inputs
+    wr_buf[0] = 0x00;
+    dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
+    wr_buf[0] = 0x01; // Set SAR enable
+    dwt_writetodevice(TX_CAL_ID, TC_SARL_SAR_C,1,wr_buf);
 
-        // Read voltage and temperature.
-        dwt_readfromdevice(TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET,2,wr_buf);
-        // Default clocks (ENABLE_ALL_SEQ)
-        _dwt_enableclocks(ENABLE_ALL_SEQ); // Enable clocks for sequencing
-    }
+    // Read voltage and temperature.
+    dwt_readfromdevice(TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET,2,wr_buf);
+    // Default clocks (ENABLE_ALL_SEQ)
+    _dwt_enableclocks(ENABLE_ALL_SEQ); // Enable clocks for sequencing
 
     vbat_raw = wr_buf[0];
     temp_raw = wr_buf[1];
@@ -3461,6 +4075,65 @@ uint16_t dwt_readtempvbat(uint8_t fastSPI)
     return (((uint16_t)temp_raw<<8)|(vbat_raw));
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_starttempvbat()
+ *
+ * @brief this function starts a temperature and battery voltage conversion for the fast SPI path of
+ * dwt_readtempvbat(): the TLD and ADC biases are enabled and the SAR started. The five writes stay single,
+ * in-sequence SPI transactions but are issued as one batch. The caller must leave at least 1ms before
+ * dwt_finishtempvbat(), during which the SPI bus is free and the receiver keeps running.
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_starttempvbat(void)
+{
+    dwt_spixfer_t xfer[5];
+    uint8_t wr_buf[5];
+
+    wr_buf[0] = 0x80; // Enable TLD Bias
+    wr_buf[1] = 0x0A; // Enable TLD Bias and ADC Bias
+    wr_buf[2] = 0x0f; // Enable Outputs (only after Biases are up and running)
+    wr_buf[3] = 0x00; // Reading All SAR inputs
+    wr_buf[4] = 0x01; // Set SAR enable
+
+    dwt_xferwrite(&xfer[0], RF_CONF_ID, 0x11, 1, &wr_buf[0]);
+    dwt_xferwrite(&xfer[1], RF_CONF_ID, 0x12, 1, &wr_buf[1]);
+    dwt_xferwrite(&xfer[2], RF_CONF_ID, 0x12, 1, &wr_buf[2]);
+    dwt_xferwrite(&xfer[3], TX_CAL_ID, TC_SARL_SAR_C, 1, &wr_buf[3]);
+    dwt_xferwrite(&xfer[4], TX_CAL_ID, TC_SARL_SAR_C, 1, &wr_buf[4]);
+    transferspi(xfer, 5);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_finishtempvbat()
+ *
+ * @brief this function reads the result of the conversion started by dwt_starttempvbat() and clears the SAR
+ * enable, in one SPI batch.
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * returns  (temp_raw<<8)|(vbat_raw)
+ */
+uint16_t dwt_finishtempvbat(void)
+{
+    dwt_spixfer_t xfer[2];
+    uint8_t rd_buf[2];
+    uint8_t clear = 0x00; // Clear SAR enable
+
+    // Read voltage and temperature.
+    dwt_xferread(&xfer[0], TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET, 2, rd_buf);
+    dwt_xferwrite(&xfer[1], TX_CAL_ID, TC_SARL_SAR_C, 1, &clear);
+    transferspi(xfer, 2);
+
+    return (((uint16_t)rd_buf[1]<<8)|(rd_buf[0]));
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_convertrawtemperature()
  *
@@ -3908,6 +4581,126 @@ uint16_t dwt_calcpgcount(uint8_t pgdly)
     return average_count;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_measurepgcount()
+ *
+ * @brief runs one PG calibration count for the given PG_DELAY, with the clocks already set up as in
+ * dwt_calcpgcount(). The three control writes go out as one batch.
+ *
+ * input parameters:
+ * @param pgdly - uint8_t - the PG_DELAY to measure
+ *
+ * output parameters: None
+ *
+ * returns: (uint16_t) PGC_STATUS count value
+ */
+static uint16_t _dwt_measurepgcount(uint8_t pgdly)
+{
+    dwt_spixfer_t xfer[3];
+    uint8_t wr_buf[3];
+    uint8_t rd_buf[2];
+
+    wr_buf[0] = pgdly;
+    wr_buf[1] = TC_PGCCTRL_DIR_CONV | TC_PGCCTRL_TMEAS_MASK; // Set cal direction and time
+    wr_buf[2] = TC_PGCCTRL_DIR_CONV | TC_PGCCTRL_TMEAS_MASK | TC_PGCCTRL_CALSTART; // Start cal
+
+    dwt_xferwrite(&xfer[0], TX_CAL_ID, TC_PGDELAY_OFFSET, 1, &wr_buf[0]);
+    dwt_xferwrite(&xfer[1], TX_CAL_ID, TC_PGCCTRL_OFFSET, 1, &wr_buf[1]);
+    dwt_xferwrite(&xfer[2], TX_CAL_ID, TC_PGCCTRL_OFFSET, 1, &wr_buf[2]);
+    transferspi(xfer, 3);
+
+    // Allow cal to complete
+    deca_sleep(1);
+
+    dwt_readfromdevice(TX_CAL_ID, TC_PGCAL_STATUS_OFFSET, 2, rd_buf);
+    return (uint16_t)(((uint16_t)rd_buf[1] << 8) | rd_buf[0]) & TC_PGCAL_STATUS_DELAY_MASK;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_trackbandwidthtempadj()
+ *
+ * @brief this function determines the corrected bandwidth setting (PG_DELAY register setting) like
+ * dwt_calcbandwidthtempadj(), but searches outwards from the setting currently in use instead of bisecting the
+ * whole range. After a temperature change of a few degrees the best setting is one or two codes away, so this
+ * takes two or three PG count measurements instead of seven. The clock set-up, each measurement and the restore
+ * are batched, so a typical call is around ten SPI transactions.
+ *
+ * NOTE 1: SPI Frequency must be < 3MHz.
+ * NOTE 2: The transceiver must be idle: the PG count runs with the packet sequencing disabled.
+ *
+ * input parameters:
+ * @param target_count - uint16_t - the PG count target to reach in order to correct the bandwidth
+ * @param pgdly - uint8_t - the PG_DELAY currently in use, the search starts there
+ * @param max_steps - uint8_t - the furthest the result may move from pgdly
+ *
+ * output parameters:
+ *
+ * returns: (uint8_t) The setting to be programmed into the PG_DELAY value
+ */
+uint8_t dwt_trackbandwidthtempadj(uint16_t target_count, uint8_t pgdly, uint8_t max_steps)
+{
+    dwt_spixfer_t xfer[4];
+    uint8_t old_regs[7];    // PMSC_CTRL0, PMSC_CTRL1 and RF_CONF, to restore later
+    uint8_t wr_buf[8];
+    uint8_t best_bw = pgdly;
+    uint8_t curr_bw = pgdly;
+    uint16_t raw_count;
+    int32 delta_count, delta_lowest;
+    int step, i;
+
+    // Record the current values of these registers, to restore later
+    dwt_xferread(&xfer[0], PMSC_ID, PMSC_CTRL0_OFFSET, 1, &old_regs[0]);
+    dwt_xferread(&xfer[1], PMSC_ID, PMSC_CTRL1_OFFSET, 2, &old_regs[1]);
+    dwt_xferread(&xfer[2], RF_CONF_ID, 0, 4, &old_regs[3]);
+    transferspi(xfer, 3);
+
+    wr_buf[0] = PMSC_CTRL0_SYSCLKS_19M; //  Set clock to XTAL
+    wr_buf[1] = (uint8_t)PMSC_CTRL1_PKTSEQ_DISABLE; //  Disable sequencing
+    wr_buf[2] = (uint8_t)(PMSC_CTRL1_PKTSEQ_DISABLE >> 8);
+    for (i = 0; i < 4; i++) //  Turn on CLK PLL, Mix Bias and PG
+    {
+        wr_buf[3 + i] = (uint8_t)((RF_CONF_TXPOW_MASK | RF_CONF_PGMIXBIASEN_MASK) >> (8 * i));
+    }
+    wr_buf[7] = PMSC_CTRL0_SYSCLKS_125M | PMSC_CTRL0_TXCLKS_125M; //  Set sys and TX clock to PLL
+    dwt_xferwrite(&xfer[0], PMSC_ID, PMSC_CTRL0_OFFSET, 1, &wr_buf[0]);
+    dwt_xferwrite(&xfer[1], PMSC_ID, PMSC_CTRL1_OFFSET, 2, &wr_buf[1]);
+    dwt_xferwrite(&xfer[2], RF_CONF_ID, 0, 4, &wr_buf[3]);
+    dwt_xferwrite(&xfer[3], PMSC_ID, PMSC_CTRL0_OFFSET, 1, &wr_buf[7]);
+    transferspi(xfer, 4);
+
+    raw_count = _dwt_measurepgcount(curr_bw);
+    delta_lowest = abs((int)raw_count - (int)target_count);
+
+    // A higher PG_DELAY gives a lower count: step towards the target until the count crosses it
+    step = (raw_count > target_count) ? 1 : -1;
+    for (i = 0; (i < max_steps) && (delta_lowest != 0); i++)
+    {
+        if (((step > 0) && (curr_bw == 0xFF)) || ((step < 0) && (curr_bw == 0)))
+            break;
+        curr_bw = (uint8_t)(curr_bw + step);
+
+        raw_count = _dwt_measurepgcount(curr_bw);
+        delta_count = abs((int)raw_count - (int)target_count);
+        if (delta_count < delta_lowest)
+        {
+            delta_lowest = delta_count;
+            best_bw = curr_bw;
+        }
+
+        if ((step > 0) ? (raw_count <= target_count) : (raw_count >= target_count))
+            break;
+    }
+
+    // Restore old register values
+    dwt_xferwrite(&xfer[0], PMSC_ID, PMSC_CTRL0_OFFSET, 1, &old_regs[0]);
+    dwt_xferwrite(&xfer[1], PMSC_ID, PMSC_CTRL1_OFFSET, 2, &old_regs[1]);
+    dwt_xferwrite(&xfer[2], RF_CONF_ID, 0, 4, &old_regs[3]);
+    transferspi(xfer, 3);
+
+    // Returns the best PG_DELAY setting
+    return best_bw;
+}
+
 
 /* ===============================================================================================
    List of expected (known) device ID handled by this software
@@ -178,6 +178,10 @@ typedef signed long int32;
 #define DWT_READ_OTP_BAT     0x40    // read ref voltage from OTP
 #define DWT_READ_OTP_TMP     0x80    // read ref temperature from OTP
 
+// OTP words cached by dwt_initialise(), bits of dwt_otpcache_t.valid along with DWT_READ_OTP_PID/LID/BAT/TMP
+#define DWT_OTPCACHE_LDO     0x100   // LDOTUNE
+#define DWT_OTPCACHE_XTRIM   0x200   // XTAL trim and OTP revision
+
 
 //DW1000 OTP operating parameter set selection
 #define DWT_OPSET_64LEN   0x0
@@ -216,6 +220,7 @@ typedef struct
     uint16_t datalength;  //length of frame
     uint8_t  fctrl[2];    //frame control bytes
     uint8_t  rx_flags;    //RX frame flags, see above
+    uint8_t  rx_stamp[5]; //RX timestamp (adjusted time of arrival), valid for RX good frame events
 } dwt_cb_data_t;
 
 // Call-back type for all events
@@ -254,6 +259,24 @@ typedef struct
 }
 dwt_txconfig_t ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Structure typedef: dwt_otpcache_t
+ *
+ * OTP words read by dwt_initialise(), see dwt_getotpcache()/dwt_setotpcache()
+ *
+ */
+typedef struct
+{
+    uint32_t    valid ;         // DWT_OTPCACHE_xxx and DWT_READ_OTP_xxx bits of the words below that have been read
+    uint32_t    ldoTune ;       // LDOTUNE, low byte 0 if not programmed
+    uint32_t    xtrimRev ;      // XTAL trim (bits 4:0) and OTP revision (bits 15:8)
+    uint32_t    partID ;
+    uint32_t    lotID ;
+    uint8_t     vBatP ;         // VBAT measured at 3.3V in production
+    uint8_t     tempP ;         // TEMP measured at 23C in production
+}
+dwt_otpcache_t ;
+
 
 typedef struct
 {
@@ -266,6 +289,7 @@ typedef struct
     uint16_t      maxGrowthCIR ;      // Channel Impulse Response max growth CIR
     uint16_t      rxPreamCount ;      // Count of preamble symbols accumulated
     uint16_t      firstPath ;         // First path index (10.6 bits fixed point integer)
+    int32         carrierIntegrator ; // RX carrier integrator, as returned by dwt_readcarrierintegrator()
 }dwt_rxdiag_t ;
 
 
@@ -287,6 +311,38 @@ typedef struct
 
 } dwt_deviceentcnts_t ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Structure typedef: dwt_spixfer_t
+ *
+ * Descriptor of one SPI transaction (chip select low, header, body, chip select high), used to hand a list of
+ * accesses to transferspi()/queuespi() so that they run back-to-back. Use dwt_xferread()/dwt_xferwrite() to fill it.
+ *
+ */
+typedef struct
+{
+    uint16_t        headerLength ;  // number of header bytes (1 to 3)
+    uint8_t         header[3] ;     // transaction header
+    uint16_t        length ;        // number of body bytes
+    const uint8_t   *txBuffer ;     // body bytes to write, NULL to clock out zeros (read)
+    uint8_t         *rxBuffer ;     // buffer for the body bytes clocked in, NULL to discard them (write)
+} dwt_spixfer_t ;
+
+// Call-back type for the completion of a queued SPI batch
+typedef void (*dwt_spidone_t)(void *arg);
+
+// Configuration registers the driver keeps write-through copies of, see dwt_getshadowstats()
+#define DWT_SHADOW_SYS_CFG      0
+#define DWT_SHADOW_SYS_MASK     1
+#define DWT_SHADOW_TX_FCTRL     2
+#define DWT_SHADOW_CHAN_CTRL    3
+#define DWT_SHADOW_NUM          4
+
+typedef struct
+{
+    uint32_t saved[DWT_SHADOW_NUM] ;    // SPI reads and redundant writes skipped, per register
+    uint32_t loads[DWT_SHADOW_NUM] ;    // reads needed because the copy was invalid (init, soft reset, sleep)
+} dwt_shadowstats_t ;
+
 
 /********************************************************************************************************************/
 /*                                                 REMOVED API LIST                                                 */
@@ -339,6 +395,7 @@ int32 dwt_apiversion(void);
  * @fn dwt_setlocaldataptr()
  *
  * @brief This function sets the local data structure pointer to point to the element in the local array as given by the index.
+ * With DWT_NUM_DW_DEV > 1 the selection is made per task through decaselectdevice().
  *
  * input parameters
  * @param index    - selects the array element to point to. Must be within the array bounds, i.e. < DWT_NUM_DW_DEV
@@ -596,6 +653,23 @@ void dwt_configurefor64plen(int prf);
  */
 void dwt_configure(dwt_config_t *config) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_reconfigure()
+ *
+ * @brief This function switches to a new configuration at runtime (e.g. another channel, data rate or preamble code).
+ * It compares the new configuration with the last one applied by dwt_configure()/dwt_reconfigure() and writes only
+ * the registers that change, in a single SPI burst. Without a known previous configuration (after dwt_initialise(),
+ * dwt_softreset() or sleep) it does a full dwt_configure(). The transceiver should be off when calling this.
+ *
+ * input parameters
+ * @param config    -   pointer to the configuration structure, which contains the device configuration data.
+ *
+ * output parameters
+ *
+ * returns the number of register writes issued (0 if nothing changed), or DWT_ERROR if the SPI transfer failed
+ */
+int dwt_reconfigure(dwt_config_t *config) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_configuretxrf()
  *
@@ -1124,6 +1198,68 @@ void dwt_entersleepaftertx(int enable);
  */
 int dwt_spicswakeup(uint8_t *buff, uint16_t length);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_spicswakeuppoll()
+ *
+ * @brief wakes the device up like dwt_spicswakeup(), polling SYS_STATUS for the clock PLL lock instead of waiting a
+ * fixed 5ms. The SPI frequency must be < 3MHz while polling.
+ *
+ * input parameters
+ * @param buff     - this is a pointer to the dummy buffer which will be used in the SPI read transaction used for the WAKE UP of the device
+ * @param length   - this is the length of the dummy buffer, enough to hold the chip select low for 500us
+ * @param maxpolls - SYS_STATUS reads before giving up
+ *
+ * output parameters
+ *
+ * returns the number of SYS_STATUS reads it took (0 if the device was awake), or DWT_ERROR if the PLL did not lock
+ */
+int dwt_spicswakeuppoll(uint8_t *buff, uint16_t length, uint16_t maxpolls);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_restoreconfig()
+ *
+ * @brief after a wake up, writes back in one SPI burst the configuration, interrupt mask, antenna delays, XTAL trim and
+ * TX spectrum the device held when dwt_entersleep() was called, and clears the wake up events. The transceiver must
+ * be idle.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns the number of register writes issued, or DWT_ERROR if the SPI transfer failed
+ */
+int dwt_restoreconfig(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getotpcache()
+ *
+ * @brief copies the OTP words dwt_initialise() has read so far, e.g. to keep them in memory that survives a power down
+ * of the micro
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param cache - the OTP words, valid says which
+ *
+ * no return value
+ */
+void dwt_getotpcache(dwt_otpcache_t *cache);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setotpcache()
+ *
+ * @brief hands OTP words saved with dwt_getotpcache() back to the driver before dwt_initialise(), so that they are not
+ * read again
+ *
+ * input parameters
+ * @param cache - the OTP words, as read from the same device
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_setotpcache(const dwt_otpcache_t *cache);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_setcallbacks()
  *
@@ -1377,6 +1513,24 @@ void dwt_rxreset(void);
  */
 void dwt_softreset(void) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getshadowstats()
+ *
+ * @brief SYS_CFG, SYS_MASK, TX_FCTRL and CHAN_CTRL are shadowed in the driver, so read-modify-write calls such as
+ * dwt_setinterrupt() or dwt_enableframefilter() skip the SPI read, and writes of an unchanged value are dropped. The
+ * shadows are invalidated by dwt_initialise(), dwt_softreset(), dwt_entersleep() and dwt_spicswakeup(). Registers
+ * written directly with dwt_writexxbitreg() bypass the shadows, use the API calls for them.
+ *
+ * input parameters
+ * @param reset - if non-zero the counters are cleared after being copied
+ *
+ * output parameters
+ * @param stats - per register counts of saved and reloading SPI transactions
+ *
+ * no return value
+ */
+void dwt_getshadowstats(dwt_shadowstats_t *stats, int reset) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readrxdata()
  *
@@ -1441,7 +1595,8 @@ int32 dwt_readcarrierintegrator(void) ;
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readdiagnostics()
  *
- * @brief this function reads the RX signal quality diagnostic data
+ * @brief this function reads the RX signal quality diagnostic data, together with the carrier integrator, in one SPI
+ * batch
  *
  * input parameters
  * @param diagnostics - diagnostic structure pointer, this will contain the diagnostic data read from the DW1000
@@ -1452,6 +1607,20 @@ int32 dwt_readcarrierintegrator(void) ;
  */
 void dwt_readdiagnostics(dwt_rxdiag_t * diagnostics);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getrxprf()
+ *
+ * @brief This function returns the RX PRF the device is configured with, as needed to turn the RX diagnostics into
+ * power levels. It is served from the CHAN_CTRL shadow, so it normally costs no SPI access.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_PRF_16M or DWT_PRF_64M
+ */
+uint8_t dwt_getrxprf(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_loadopsettabfromotp()
  *
@@ -1606,6 +1775,33 @@ void dwt_configcontinuousframemode(uint32_t framerepetitionrate);
  */
 uint16_t dwt_readtempvbat(uint8_t fastSPI);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_starttempvbat()
+ *
+ * @brief this function starts a temperature and battery voltage conversion for the fast SPI path, in one SPI batch.
+ * Read the result with dwt_finishtempvbat() at least 1ms later; the SPI bus is free in between.
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_starttempvbat(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_finishtempvbat()
+ *
+ * @brief this function reads the conversion started by dwt_starttempvbat() and clears the SAR enable, in one SPI batch.
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * returns  (temp_raw<<8)|(vbat_raw)
+ */
+uint16_t dwt_finishtempvbat(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_convertrawtemperature()
  *
@@ -1751,6 +1947,27 @@ uint32_t dwt_calcpowertempadj(uint8_t channel, uint32_t ref_powerreg, int delta_
  */
 uint16_t dwt_calcpgcount(uint8_t pgdly);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_trackbandwidthtempadj()
+ *
+ * @brief this function determines the corrected bandwidth setting (PG_DELAY register setting) like
+ * dwt_calcbandwidthtempadj(), searching outwards from the setting in use. After a small temperature change it needs
+ * two or three PG count measurements instead of seven, each in one SPI batch.
+ *
+ * NOTE 1: SPI Frequency must be < 3MHz.
+ * NOTE 2: The transceiver must be idle.
+ *
+ * input parameters:
+ * @param target_count - uint16_t - the PG count target, as returned by dwt_calcpgcount() at the reference temperature
+ * @param pgdly - uint8_t - the PG_DELAY currently in use
+ * @param max_steps - uint8_t - the furthest the result may move from pgdly
+ *
+ * output parameters:
+ *
+ * returns: (uint8_t) The setting to be programmed into the PG_DELAY value
+ */
+uint8_t dwt_trackbandwidthtempadj(uint16_t target_count, uint8_t pgdly, uint8_t max_steps);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_writetodevice()
  *
@@ -1813,6 +2030,44 @@ void dwt_readfromdevice
     uint8_t   *buffer             // input parameter - pointer to buffer in which to return the read data.
 ) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_xferread()
+ *
+ * @brief  this function fills in an SPI transaction descriptor reading from the DW1000 device registers, so that
+ * several accesses can be handed to transferspi() and run back-to-back in one batch
+ *
+ * input parameters:
+ * @param xfer          - pointer to the descriptor to fill in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data (must stay valid until the batch is done)
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_xferread(dwt_spixfer_t *xfer, uint16_t recordNumber, uint16_t index, uint16_t length, uint8_t *buffer) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_xferwrite()
+ *
+ * @brief  this function fills in an SPI transaction descriptor writing to the DW1000 device registers, so that
+ * several accesses can be handed to transferspi() and run back-to-back in one batch
+ *
+ * input parameters:
+ * @param xfer          - pointer to the descriptor to fill in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written
+ * @param buffer        - pointer to buffer containing the bytes to be written (must stay valid until the batch is done)
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_xferwrite(dwt_spixfer_t *xfer, uint16_t recordNumber, uint16_t index, uint16_t length, const uint8_t *buffer) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_read32bitoffsetreg()
  *
@@ -1965,6 +2220,50 @@ int writetospi(uint16_t headerLength, const uint8_t *headerBuffer, uint32_t body
  */
 int readfromspi(uint16_t headerLength, const uint8_t *headerBuffer, uint32_t readlength, uint8_t *readBuffer);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn queuespi()
+ *
+ * @brief
+ * Low level abstract function to start a batch of SPI transactions without waiting for it. The transactions are run
+ * back-to-back in the order given (each one with its own chip select cycle) and the done call-back is called once,
+ * when the last one has completed. The call-back may run in interrupt context.
+ * The caller must own the SPI bus until the call-back has been called, and the descriptors and the buffers they
+ * point to must stay valid until then.
+ * If the platform cannot run the batch in the background, it is run before returning and done is called from here.
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * input parameters:
+ * @param xfers - pointer to the array of transaction descriptors
+ * @param count - number of descriptors in the array
+ * @param done  - call-back to call when the batch has completed, may be NULL
+ * @param arg   - argument passed to the call-back
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int queuespi(dwt_spixfer_t *xfers, uint16_t count, dwt_spidone_t done, void *arg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn transferspi()
+ *
+ * @brief
+ * Low level abstract function to run a batch of SPI transactions back-to-back and wait for the whole batch to be
+ * done, see queuespi(). This is the blocking equivalent and takes care of the SPI bus ownership itself.
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * input parameters:
+ * @param xfers - pointer to the array of transaction descriptors
+ * @param count - number of descriptors in the array
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int transferspi(dwt_spixfer_t *xfers, uint16_t count);
+
 // ---------------------------------------------------------------------------
 //
 // NB: The purpose of the deca_mutex.c file is to provide for microprocessor interrupt enable/disable, this is used for
@@ -2030,6 +2329,37 @@ void decamutexoff(decaIrqStatus_t s) ;
  */
 void deca_sleep(unsigned int time_ms);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn decaselectdevice()
+ *
+ * @brief Selects the DW1000 the calling context works with, when more than one is driven (DWT_NUM_DW_DEV > 1). The
+ * platform keeps the choice per task, so that tasks working with different devices can call the driver
+ * concurrently; the driver's local data and the SPI/IRQ port both follow it.
+ * NB: The body of this function is defined in deca_port.c and is platform specific
+ *
+ * input parameters:
+ * @param index - selects the device, must be < DWT_NUM_DW_DEV
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int decaselectdevice(unsigned int index);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn decadeviceindex()
+ *
+ * @brief Returns the index of the DW1000 selected by decaselectdevice() for the calling context.
+ * NB: The body of this function is defined in deca_port.c and is platform specific
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * returns the device index
+ */
+int decadeviceindex(void);
+
 #ifdef __cplusplus
 }
 #endif
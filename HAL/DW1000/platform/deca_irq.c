@@ -0,0 +1,60 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_irq.c
+ * @brief	DW1000 IRQ line (EXTI) port
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_irq.h"
+
+#include "deca_port.h"
+#include "gd32f4xx.h"
+
+static TaskHandle_t deca_irq_tasks[DWT_NUM_DW_DEV];
+
+void deca_irq_init(TaskHandle_t task) {
+    int index = decadeviceindex();
+    const deca_port_config_t *dev = &deca_port_configs[index];
+
+    deca_irq_tasks[index] = task;
+
+    rcu_periph_clock_enable(dev->irq_rcu);
+    rcu_periph_clock_enable(RCU_SYSCFG);
+
+    // DW1000 IRQ 为高电平有效, 下拉避免悬空时误触发
+    gpio_mode_set(dev->irq_port, GPIO_MODE_INPUT, GPIO_PUPD_PULLDOWN,
+                  dev->irq_pin);
+
+    syscfg_exti_line_config(dev->exti_port, dev->exti_pin);
+    exti_init(dev->exti_line, EXTI_INTERRUPT, EXTI_TRIG_RISING);
+    exti_interrupt_flag_clear(dev->exti_line);
+
+    nvic_irq_enable(EXTI10_15_IRQn, DECA_IRQ_PRIORITY, 0);
+}
+
+int deca_irq_active(void) {
+    const deca_port_config_t *dev = decaportconfig();
+
+    return gpio_input_bit_get(dev->irq_port, dev->irq_pin) == SET;
+}
+
+void EXTI10_15_IRQHandler(void) {
+    BaseType_t woken = pdFALSE;
+
+    // 所有设备的 IRQ 线共用此向量, 逐个检查
+    for (int i = 0; i < DWT_NUM_DW_DEV; i++) {
+        exti_line_enum line = deca_port_configs[i].exti_line;
+
+        if (exti_interrupt_flag_get(line) != RESET) {
+            exti_interrupt_flag_clear(line);
+            // 中断处理 (SPI 访问) 交给任务执行, 中断中只发通知
+            if (deca_irq_tasks[i] != NULL) {
+                vTaskNotifyGiveFromISR(deca_irq_tasks[i], &woken);
+            }
+        }
+    }
+    portYIELD_FROM_ISR(woken);
+}
@@ -0,0 +1,66 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_irq.h
+ * @brief	DW1000 IRQ line (EXTI) port
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef _DECA_IRQ_H_
+#define _DECA_IRQ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "task.h"
+
+// DW1000 IRQ 引脚见 deca_port.c, 均须位于 EXTI10_15_IRQn
+#define DECA_IRQ_PRIORITY               (6)                     // must not be above configMAX_SYSCALL_INTERRUPT_PRIORITY
+
+typedef struct
+{
+    uint32_t masked_count;          // decamutexon() sections that masked the DW1000 IRQ line
+    uint32_t masked_max;            // longest of them in core cycles (DW1000 event latency)
+    uint32_t critical_count;        // sections that fell back to a critical section
+    uint32_t critical_max;          // longest of them in core cycles (added latency of every other ISR)
+} deca_mutex_stats_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_irq_init()
+ *
+ * Configures the IRQ input of the selected DW1000 (rising edge, see deca_port.c) and enables the interrupt. Each edge
+ * sends a task notification to the given task, which is expected to call dwt_isr() until deca_irq_active() returns 0.
+ * @param task - the task handling DW1000 events
+ */
+void deca_irq_init(TaskHandle_t task) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_irq_active()
+ *
+ * Returns 1 while the IRQ line of the selected DW1000 is asserted. The line is level driven by the chip, so an edge missed while the
+ * EXTI line was masked is recovered by polling this after dwt_isr().
+ */
+int deca_irq_active(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: decamutexgetstats()
+ *
+ * Copies the decamutexon()/decamutexoff() timing counters (core cycles, DWT cycle counter). decamutexon() only masks
+ * the EXTI line of the selected DW1000 while holding the SPI bus lock; critical_max shows how long unrelated
+ * interrupts were held off when it had to fall back to a critical section. The body is defined in deca_mutex.c.
+ * @param stats - destination
+ * @param reset - non-zero to clear the counters after reading
+ */
+void decamutexgetstats(deca_mutex_stats_t *stats, int reset) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_IRQ_H_ */
@@ -11,6 +11,9 @@
  */
 
 #include "deca_device_api.h"
+#include "deca_irq.h"
+#include "deca_port.h"
+#include "deca_spi.h"
 #include "gd32f4xx.h"
 #include "freertos.h"
 #include "task.h"
@@ -41,6 +44,23 @@
 //     __restore_intstate()
 // ---------------------------------------------------------------------------
 
+// decamutexon() 返回值的各位
+#define DECA_MUTEX_EXTI     0x1    // 调用前 DW1000 中断线已使能, 由本次调用屏蔽
+#define DECA_MUTEX_BUSLOCK  0x2    // 持有 SPI 总线锁
+#define DECA_MUTEX_CRITICAL 0x4    // 无法取得总线锁, 退回到临界区
+
+static deca_mutex_stats_t deca_mutex_stats;
+static uint32_t deca_mutex_masked_start[DWT_NUM_DW_DEV];
+static uint32_t deca_mutex_critical_start;
+
+static void deca_mutex_max(uint32_t *max, uint32_t start) {
+    uint32_t cycles = DWT->CYCCNT - start;
+
+    if (cycles > *max) {
+        *max = cycles;
+    }
+}
+
 /*!
  * ------------------------------------------------------------------------------------------------------------------
  * Function: decamutexon()
@@ -49,6 +69,12 @@
  * start of a critical section It returns the irq state before disable, this
  * value is used to re-enable in decamutexoff call
  *
+ * Here it takes ownership of the SPI bus (priority inheriting recursive mutex)
+ * and masks only the EXTI line of the selected DW1000, so other bus users and
+ * the DW1000 event task are held off while every other interrupt is still
+ * served. A task that cannot take the bus lock (bus not opened yet) falls back
+ * to a critical section. Calls nest.
+ *
  * Note: The body of this function is defined in deca_mutex.c and is platform
  * specific
  *
@@ -59,15 +85,24 @@
  * returns the state of the DW1000 interrupt
  */
 decaIrqStatus_t decamutexon(void) {
-    decaIrqStatus_t s = exti_interrupt_flag_get(EXTI_15);
-
-    taskENTER_CRITICAL();    // 禁止任务切换和中断（内核级别）
+    // 先取得总线所有权, 防止在其他任务的 DMA 传输过程中插入访问
+    int locked = spibuslock();
+    int dev = decadeviceindex();
+    exti_line_enum line = deca_port_configs[dev].exti_line;
+    decaIrqStatus_t s = locked ? DECA_MUTEX_BUSLOCK : 0;
 
-    exti_interrupt_flag_clear(EXTI_15);    // 清除中断标志位
-    if (s) {
-        exti_interrupt_disable(EXTI_15);    // 禁用 EXTI 中断
+    if (!locked && spicanblock()) {
+        // 总线锁尚未创建, 只能屏蔽调度和中断
+        taskENTER_CRITICAL();
+        deca_mutex_critical_start = DWT->CYCCNT;
+        s |= DECA_MUTEX_CRITICAL;
     }
 
+    // 只屏蔽中断线, 挂起标志保留, 重新使能后事件照常送达
+    if (decairqline(line, 0)) {
+        deca_mutex_masked_start[dev] = DWT->CYCCNT;
+        s |= DECA_MUTEX_EXTI;
+    }
     return s;
 }
 /*!
@@ -89,9 +124,33 @@ decaIrqStatus_t decamutexon(void) {
  * returns the state of the DW1000 interrupt
  */
 void decamutexoff(decaIrqStatus_t s) {
-    if (s) {
-        exti_interrupt_disable(EXTI_15);    // 再次确认关闭（可选）
+    int dev = decadeviceindex();
+
+    if (s & DECA_MUTEX_EXTI) {
+        deca_mutex_max(&deca_mutex_stats.masked_max,
+                       deca_mutex_masked_start[dev]);
+        deca_mutex_stats.masked_count++;
+        decairqline(deca_port_configs[dev].exti_line, 1);
+    }
+
+    if (s & DECA_MUTEX_CRITICAL) {
+        deca_mutex_max(&deca_mutex_stats.critical_max,
+                       deca_mutex_critical_start);
+        deca_mutex_stats.critical_count++;
+        taskEXIT_CRITICAL();
     }
 
-    taskEXIT_CRITICAL();    // 重新打开调度和中断
+    spibusunlock(s & DECA_MUTEX_BUSLOCK);
+}
+
+void decamutexgetstats(deca_mutex_stats_t *stats, int reset) {
+    taskENTER_CRITICAL();
+    *stats = deca_mutex_stats;
+    if (reset) {
+        deca_mutex_stats.masked_count = 0;
+        deca_mutex_stats.masked_max = 0;
+        deca_mutex_stats.critical_count = 0;
+        deca_mutex_stats.critical_max = 0;
+    }
+    taskEXIT_CRITICAL();
 }
@@ -0,0 +1,96 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_port.c
+ * @brief	DW1000 board wiring and per-device selection
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_port.h"
+
+#include <stdint.h>
+
+#include "freertos.h"
+#include "task.h"
+
+#if DWT_NUM_DW_DEV > 2
+#error "add the wiring of the extra DW1000 devices to deca_port_configs"
+#endif
+
+const deca_bus_config_t deca_bus_configs[DECA_NUM_BUS] = {
+    // SPI3 DMA 请求映射: DMA1 CH0 = SPI3_RX, DMA1 CH1 = SPI3_TX (子外设 4)
+    {SPI3, DMA1, DMA_CH0, DMA_CH1, DMA_SUBPERI4, DMA1_Channel0_IRQn, RCU_DMA1},
+#if DECA_NUM_BUS > 1
+    // SPI4 DMA 请求映射: DMA1 CH3 = SPI4_RX, DMA1 CH4 = SPI4_TX (子外设 2)
+    {SPI4, DMA1, DMA_CH3, DMA_CH4, DMA_SUBPERI2, DMA1_Channel3_IRQn, RCU_DMA1},
+#endif
+};
+
+const deca_port_config_t deca_port_configs[DWT_NUM_DW_DEV] = {
+    // 设备 0: SPI3, CS = PE4, IRQ = PE15
+    {0, GPIOE, GPIO_PIN_4, RCU_GPIOE, GPIOE, GPIO_PIN_15, RCU_GPIOE,
+     EXTI_SOURCE_GPIOE, EXTI_SOURCE_PIN15, EXTI_15},
+#if DWT_NUM_DW_DEV > 1
+    // 设备 1: SPI4 (PF7 CLK, PF8 MISO, PF9 MOSI), CS = PF6, IRQ = PF10,
+    // 按实际电路修改
+    {1, GPIOF, GPIO_PIN_6, RCU_GPIOF, GPIOF, GPIO_PIN_10, RCU_GPIOF,
+     EXTI_SOURCE_GPIOF, EXTI_SOURCE_PIN10, EXTI_10},
+#endif
+};
+
+static unsigned int deca_port_default;
+
+// 任务上下文才有自己的 TLS, 调度器启动前和中断中使用默认设备
+static int deca_port_has_tls(void) {
+    return (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) &&
+           (__get_IPSR() == 0);
+}
+
+int decaselectdevice(unsigned int index) {
+    if (index >= DWT_NUM_DW_DEV) {
+        return DWT_ERROR;
+    }
+    if (deca_port_has_tls()) {
+        vTaskSetThreadLocalStoragePointer(NULL, DECA_PORT_TLS_INDEX,
+                                          (void *)(uintptr_t)(index + 1));
+    } else {
+        deca_port_default = index;
+    }
+    return DWT_SUCCESS;
+}
+
+int decadeviceindex(void) {
+#if DWT_NUM_DW_DEV > 1
+    if (deca_port_has_tls()) {
+        uintptr_t sel = (uintptr_t)pvTaskGetThreadLocalStoragePointer(
+            NULL, DECA_PORT_TLS_INDEX);
+
+        if (sel != 0) {
+            return (int)(sel - 1);
+        }
+    }
+    return (int)deca_port_default;
+#else
+    return 0;
+#endif
+}
+
+const deca_port_config_t *decaportconfig(void) {
+    return &deca_port_configs[decadeviceindex()];
+}
+
+int decairqline(exti_line_enum line, int enable) {
+    // 各任务和 DMA 中断都会改写 EXTI_INTEN, 读-改-写期间屏蔽中断以免丢失更新
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    int was = (EXTI_INTEN & line) != 0;
+
+    if (enable) {
+        exti_interrupt_enable(line);
+    } else {
+        exti_interrupt_disable(line);
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return was;
+}
@@ -0,0 +1,82 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_port.h
+ * @brief	DW1000 board wiring and per-device selection
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef _DECA_PORT_H_
+#define _DECA_PORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_device_api.h"
+#include "gd32f4xx.h"
+
+// 每条 SPI 总线一套 DMA 通道和总线锁, 同一总线上的设备只用片选区分
+#if DWT_NUM_DW_DEV > 1
+#define DECA_NUM_BUS                    (2)
+#else
+#define DECA_NUM_BUS                    (1)
+#endif
+
+#define DECA_PORT_TLS_INDEX             (0)                     // FreeRTOS TLS slot holding the selected device + 1
+
+typedef struct
+{
+    uint32_t spi;                       // SPIx, pins and clock set up by the application
+    uint32_t dma;                       // DMAx
+    dma_channel_enum dma_rx_ch;
+    dma_channel_enum dma_tx_ch;
+    dma_subperipheral_enum dma_subperi;
+    IRQn_Type dma_irqn;                 // IRQ of the RX channel, see the handlers in deca_spi.c
+    rcu_periph_enum dma_rcu;
+} deca_bus_config_t;
+
+typedef struct
+{
+    uint8_t bus;                        // index in deca_bus_configs
+    uint32_t cs_port;
+    uint32_t cs_pin;
+    rcu_periph_enum cs_rcu;
+    uint32_t irq_port;
+    uint32_t irq_pin;
+    rcu_periph_enum irq_rcu;
+    uint8_t exti_port;                  // EXTI_SOURCE_GPIOx
+    uint8_t exti_pin;                   // EXTI_SOURCE_PINx, must be 10 to 15 (EXTI10_15_IRQn)
+    exti_line_enum exti_line;
+} deca_port_config_t;
+
+extern const deca_bus_config_t deca_bus_configs[DECA_NUM_BUS];
+extern const deca_port_config_t deca_port_configs[DWT_NUM_DW_DEV];
+
+// 设备选择: decaselectdevice() / decadeviceindex(), 声明见 deca_device_api.h
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: decaportconfig()
+ *
+ * Returns the wiring of the DW1000 selected by the calling task (see decaselectdevice()).
+ */
+const deca_port_config_t *decaportconfig(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: decairqline()
+ *
+ * Masks (enable = 0) or unmasks (enable = 1) a DW1000 EXTI line. EXTI_INTEN is shared by all devices and is also
+ * written from the SPI DMA interrupt, so the read-modify-write runs with interrupts masked. Callable from tasks and
+ * ISRs.
+ *
+ * returns 1 if the line was enabled before the call, 0 otherwise
+ */
+int decairqline(exti_line_enum line, int enable) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_PORT_H_ */
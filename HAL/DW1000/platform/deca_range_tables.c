@@ -14,6 +14,7 @@
 
 #include "deca_device_api.h"
 #include "deca_param_types.h"
+#include "deca_range_tables.h"
 
 #define NUM_16M_OFFSET  (37)
 #define NUM_16M_OFFSETWB  (68)
@@ -619,34 +620,43 @@ const uint8 range25cm64PRFwb[2][NUM_64M_OFFSETWB] =
 }; // end range25cm64PRFwb
 
 
+// Inverted table for the channel/PRF in use: correction in cm indexed directly by the range in 25 cm units. Built from
+// the tables above on first use and rebuilt when the channel or PRF changes, so a lookup is O(1) and integer only.
+// There is one per device, so devices on different channels do not keep rebuilding each other's.
+#define RANGE_BIAS_LUT_LEN  (256)
+#define RANGE_BIAS_KEY(chan, prf)   ((uint16) ((chan) | ((prf) << 8)))
+
+typedef struct
+{
+    int8 lut[RANGE_BIAS_LUT_LEN];
+    volatile uint16 key;                            // RANGE_BIAS_KEY() the LUT was built for, 0 = not built
+} rangebias_lut_t;
+
+static rangebias_lut_t rangebias[DWT_NUM_DW_DEV];
+
 /*! ------------------------------------------------------------------------------------------------------------------
- * Function: dwt_getrangebias()
+ * Function: _dwt_buildrangebias()
  *
- * Description: This function is used to return the range bias correction need for TWR with DW1000 units.
+ * Description: This function walks the range bias table for the given channel and PRF once and fills the LUT of
+ * the device with the nearest centimeter correction for every 25 cm range bucket (0 to 255). The key is cleared while
+ * the LUT is written and set last, so another task of the same device never takes a half built LUT for valid; it
+ * rebuilds it as well, with the same values.
  *
- * input parameters:	
- * @param chan  - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7) 
- * @param range - the calculated distance before correction
- * @param prf	- this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
+ * input parameters:
+ * @param bias  - LUT of the selected device
+ * @param chan  - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7)
+ * @param prf   - this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
  *
  * output parameters
  *
- * returns correction needed in meters
+ * no return value
  */
-double dwt_getrangebias(uint8 chan, float range, uint8 prf)
+static void _dwt_buildrangebias(rangebias_lut_t *bias, uint8 chan, uint8 prf)
 {
-    //first get the lookup index that corresponds to given range for a particular channel at 16M PRF
+    const uint8 *table ;
+    int cmoffset ;
     int i = 0 ;
-    int chanIdx ;
-    int cmoffseti ;                                 // integer number of CM offset
-
-    double mOffset ;                                // final offset result in metres
-
-    // NB: note we may get some small negitive values e.g. up to -50 cm.
-
-    int rangeint25cm = (int) (range * 4.00) ;       // convert range to integer number of 25cm values.
-
-    if (rangeint25cm > 255) rangeint25cm = 255 ;    // make sure it matches largest value in table (all tables end in 255 !!!!)
+    int r ;
 
     if (prf == DWT_PRF_16M)
     {
@@ -654,19 +664,13 @@ double dwt_getrangebias(uint8 chan, float range, uint8 prf)
         {
             case 4:
             case 7:
-            {
-                chanIdx = chan_idxwb[chan];
-                while (rangeint25cm > range25cm16PRFwb[chanIdx][i]) i++ ;       // find index in table corresponding to range
-                cmoffseti = i + CM_OFFSET_16M_WB ;                              // nearest centimeter correction
-            }
-            break;
+                table = range25cm16PRFwb[chan_idxwb[chan]];
+                cmoffset = CM_OFFSET_16M_WB ;
+                break;
             default:
-            {
-                chanIdx = chan_idxnb[chan];
-                while (rangeint25cm > range25cm16PRFnb[chanIdx][i]) i++ ;       // find index in table corresponding to range
-                cmoffseti = i + CM_OFFSET_16M_NB ;                              // nearest centimeter correction
-            }
-        }//end of switch
+                table = range25cm16PRFnb[chan_idxnb[chan]];
+                cmoffset = CM_OFFSET_16M_NB ;
+        }
     }
     else // 64M PRF
     {
@@ -674,25 +678,83 @@ double dwt_getrangebias(uint8 chan, float range, uint8 prf)
         {
             case 4:
             case 7:
-            {
-                chanIdx = chan_idxwb[chan];
-                while (rangeint25cm > range25cm64PRFwb[chanIdx][i]) i++ ;       // find index in table corresponding to range
-                cmoffseti = i + CM_OFFSET_64M_WB ;                              // nearest centimeter correction
-            }
-            break;
+                table = range25cm64PRFwb[chan_idxwb[chan]];
+                cmoffset = CM_OFFSET_64M_WB ;
+                break;
             default:
-            {
-                chanIdx = chan_idxnb[chan];
-                while (rangeint25cm > range25cm64PRFnb[chanIdx][i]) i++ ;       // find index in table corresponding to range
-                cmoffseti = i + CM_OFFSET_64M_NB ;                              // nearest centimeter correction
-            }
-        }//end of switch
-    } // end else
+                table = range25cm64PRFnb[chan_idxnb[chan]];
+                cmoffset = CM_OFFSET_64M_NB ;
+        }
+    }
+
+    bias->key = 0 ;
+    for (r = 0; r < RANGE_BIAS_LUT_LEN; r++)
+    {
+        while (r > table[i]) i++ ;                  // tables are ascending and end in 255, so i never runs off the end
+        bias->lut[r] = (int8) (i + cmoffset) ;
+    }
+    bias->key = RANGE_BIAS_KEY(chan, prf) ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: _dwt_rangebias25cm()
+ *
+ * Description: Returns the correction in cm for a range given in integer units of 25 cm, (re)building the LUT of the
+ * selected device if the channel or PRF differs from the last call.
+ */
+static int _dwt_rangebias25cm(uint8 chan, int rangeint25cm, uint8 prf)
+{
+    rangebias_lut_t *bias = &rangebias[decadeviceindex()] ;
+
+    if (bias->key != RANGE_BIAS_KEY(chan, prf))
+    {
+        _dwt_buildrangebias(bias, chan, prf);
+    }
 
+    // NB: note we may get some small negitive values e.g. up to -50 cm, these all map to the first entry.
+    if (rangeint25cm < 0) rangeint25cm = 0 ;
+    if (rangeint25cm > 255) rangeint25cm = 255 ;    // make sure it matches largest value in table (all tables end in 255 !!!!)
 
-    mOffset = (float) cmoffseti ;                                       // offset result in centimmetres
+    return bias->lut[rangeint25cm] ;
+}
 
-    mOffset *= 0.01 ;                                                   // convert to metres
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebiascm()
+ *
+ * Description: This function is used to return the range bias correction need for TWR with DW1000 units, using
+ * integer arithmetic only.
+ *
+ * input parameters:
+ * @param chan     - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7)
+ * @param range_mm - the calculated distance before correction, in millimetres
+ * @param prf      - this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
+ *
+ * output parameters
+ *
+ * returns correction needed in centimetres
+ */
+int dwt_getrangebiascm(uint8 chan, int32 range_mm, uint8 prf)
+{
+    return _dwt_rangebias25cm(chan, (int) (range_mm / 250), prf) ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias()
+ *
+ * Description: This function is used to return the range bias correction need for TWR with DW1000 units.
+ *
+ * input parameters:	
+ * @param chan  - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7) 
+ * @param range - the calculated distance before correction
+ * @param prf	- this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
+ *
+ * output parameters
+ *
+ * returns correction needed in meters
+ */
+double dwt_getrangebias(uint8 chan, float range, uint8 prf)
+{
+    int rangeint25cm = (int) (range * 4.00) ;       // convert range to integer number of 25cm values.
 
-    return (mOffset) ;
+    return _dwt_rangebias25cm(chan, rangeint25cm, prf) * 0.01 ;
 }
@@ -0,0 +1,52 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_range_tables.h
+ * @brief   DW1000 range correction tables
+ *
+ * @attention
+ *
+ * Copyright 2015 (c) DecaWave Ltd, Dublin, Ireland.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef _DECA_RANGE_TABLES_H_
+#define _DECA_RANGE_TABLES_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias()
+ *
+ * Returns the range bias correction (in meters) for a TWR range measured on the given channel and PRF.
+ *
+ * param  chan   operating channel (1, 2, 3, 4, 5 or 7)
+ * param  range  the calculated distance before correction, in meters
+ * param  prf    DWT_PRF_16M or DWT_PRF_64M
+ */
+double dwt_getrangebias(uint8 chan, float range, uint8 prf);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebiascm()
+ *
+ * Integer only version of dwt_getrangebias(). The first call for a channel/PRF inverts the table into a 256 entry LUT
+ * of the selected device, after that each lookup is a single indexed read. Tasks of different devices may call it
+ * concurrently; tasks of one device must agree on its channel and PRF.
+ *
+ * param  chan      operating channel (1, 2, 3, 4, 5 or 7)
+ * param  range_mm  the calculated distance before correction, in millimetres
+ * param  prf       DWT_PRF_16M or DWT_PRF_64M
+ *
+ * returns the correction in centimetres
+ */
+int dwt_getrangebiascm(uint8 chan, int32 range_mm, uint8 prf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_RANGE_TABLES_H_ */
@@ -14,67 +14,477 @@
 #include "deca_spi.h"
 
 #include "deca_device_api.h"
+#include "deca_port.h"
+#include "freertos.h"
 #include "gd32f4xx.h"
+#include "semphr.h"
+#include "task.h"
 
+#define DECA_SPI_DMA_TIMEOUT pdMS_TO_TICKS(10)
 
-extern spi_parameter_struct spi_init_struct;
-#define DW1000_SPI_Handle SPI1
+// spisetrate() 调用之前使用的保守建立时间 (约为原延时循环的长度)
+#define DECA_SPI_CS_SETUP_DEFAULT 500
 
-// 初始化在main中执行，此处留空
-int openspi(/*SPI_TypeDef* SPIx*/) { return 0; }
+// 每条总线的运行状态, 同一总线上的设备共享总线锁和 DMA 通道
+typedef struct {
+    const deca_bus_config_t *hw;
+    SemaphoreHandle_t lock;        // 总线所有权 (递归互斥量)
+    SemaphoreHandle_t dma_done;    // 批量传输完成信号
+
+    // 正在进行的批量传输 (由 DMA 中断推进)
+    const deca_port_config_t *q_dev;    // 批量传输的目标设备 (片选)
+    dwt_spixfer_t *q_xfers;
+    uint16_t q_count;
+    uint16_t q_index;
+    uint8_t q_body;    // 0: 正在发送头部, 1: 正在传输数据体
+    uint8_t q_exti;    // 批量开始前 DW1000 中断线是否使能
+    volatile uint8_t q_busy;
+    dwt_spidone_t q_done;
+    void *q_arg;
+
+    uint32_t cs_setup;    // 内核周期
+    deca_spi_stats_t stats;
+} spi_bus_t;
+
+static spi_bus_t spi_buses[DECA_NUM_BUS];
+static uint8_t spi_dma_dummy;             // 写操作时接收数据的丢弃地址
+static const uint8_t spi_dma_zero = 0;    // 读操作时发送的填充字节
+
+// 调用任务当前选择的设备所在的总线
+static spi_bus_t *spi_bus_current(void) {
+    return &spi_buses[decaportconfig()->bus];
+}
+
+// 使能 DWT 周期计数器, 用于片选时序和访问耗时统计
+static void spi_cyccnt_init(void) {
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+
+void spisetrate(uint32_t prescale) {
+    spi_bus_t *bus = spi_bus_current();
+    uint32_t div = 2U << ((prescale & SPI_CTL0_PSC) >> 3);
+    uint32_t pclk = rcu_clock_freq_get(CK_APB2);
+    uint32_t hclk = SystemCoreClock;
+
+    spi_cyccnt_init();
+    // 建立时间 = 固定的 DW1000 建立时间 + 半个 SCLK 周期, 均换算为内核周期
+    bus->cs_setup = (uint32_t)(((uint64_t)hclk * DECA_SPI_CS_SETUP_NS +
+                               999999999U) /
+                              1000000000U) +
+                   (uint32_t)(((uint64_t)hclk * div + 2 * pclk - 1) /
+                              (2 * pclk));
+}
+
+void spigetstats(deca_spi_stats_t *stats, int reset) {
+    spi_bus_t *bus = spi_bus_current();
+
+    taskENTER_CRITICAL();
+    *stats = bus->stats;
+    stats->setup = bus->cs_setup;
+    if (reset) {
+        bus->stats.count = 0;
+        bus->stats.total = 0;
+        bus->stats.max = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+// 连续读取 DEV_ID 并统计每次调用的内核周期
+static void spi_bench_run(spi_bus_t *bus, uint32_t reads, uint32_t setup,
+                          deca_spi_bench_t *res) {
+    uint32_t saved = bus->cs_setup;
+    uint32_t total = 0;
+    uint32_t start;
+    uint32_t cycles;
+
+    bus->cs_setup = setup;
+    res->reads = reads;
+    res->setup = setup;
+    res->min = 0xFFFFFFFFU;
+    res->max = 0;
+    for (uint32_t i = 0; i < reads; i++) {
+        start = DWT->CYCCNT;
+        (void)dwt_read32bitreg(0x00);    // DEV_ID
+        cycles = DWT->CYCCNT - start;
+        total += cycles;
+        if (cycles < res->min) {
+            res->min = cycles;
+        }
+        if (cycles > res->max) {
+            res->max = cycles;
+        }
+    }
+    res->avg = (reads > 0) ? total / reads : 0;
+    bus->cs_setup = saved;
+}
+
+void spibench(uint32_t reads, deca_spi_bench_t *now,
+              deca_spi_bench_t *before) {
+    spi_bus_t *bus = spi_bus_current();
+    int locked = spibuslock();
+    uint32_t start;
+
+    spi_cyccnt_init();
+    spi_bench_run(bus, reads, bus->cs_setup, now);
+    if (before != NULL) {
+        // 片选原先的延时方式, 计时一次后作为建立时间使用
+        start = DWT->CYCCNT;
+        for (volatile int delay = 0; delay < 100; delay++);
+        spi_bench_run(bus, reads, DWT->CYCCNT - start, before);
+    }
+    spibusunlock(locked);
+}
+
+static void spi_dma_channel_init(const deca_bus_config_t *hw,
+                                 dma_channel_enum ch, uint32_t dir) {
+    dma_single_data_parameter_struct dma_init_struct;
+
+    dma_deinit(hw->dma, ch);
+    dma_single_data_para_struct_init(&dma_init_struct);
+    dma_init_struct.periph_addr = (uint32_t)&SPI_DATA(hw->spi);
+    dma_init_struct.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
+    dma_init_struct.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
+    dma_init_struct.periph_memory_width = DMA_PERIPH_WIDTH_8BIT;
+    dma_init_struct.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
+    dma_init_struct.direction = dir;
+    dma_init_struct.priority = DMA_PRIORITY_HIGH;
+    dma_single_data_mode_init(hw->dma, ch, &dma_init_struct);
+    dma_channel_subperipheral_select(hw->dma, ch, hw->dma_subperi);
+}
+
+// SPI 硬件初始化在 main 中执行，此处准备所有总线的 DMA 通道、同步对象
+// 以及所有设备的片选引脚
+int openspi(/*SPI_TypeDef* SPIx*/) {
+    int ret = 0;
+
+    spi_cyccnt_init();
+
+    for (int i = 0; i < DECA_NUM_BUS; i++) {
+        spi_bus_t *bus = &spi_buses[i];
+        const deca_bus_config_t *hw = &deca_bus_configs[i];
+
+        bus->hw = hw;
+        if (bus->cs_setup == 0) {
+            bus->cs_setup = DECA_SPI_CS_SETUP_DEFAULT;
+        }
+        rcu_periph_clock_enable(hw->dma_rcu);
+        spi_dma_channel_init(hw, hw->dma_rx_ch, DMA_PERIPH_TO_MEMORY);
+        spi_dma_channel_init(hw, hw->dma_tx_ch, DMA_MEMORY_TO_PERIPH);
+        dma_interrupt_enable(hw->dma, hw->dma_rx_ch, DMA_INT_FTF);
+        nvic_irq_enable(hw->dma_irqn, 6, 0);
+
+        if (bus->lock == NULL) {
+            bus->lock = xSemaphoreCreateRecursiveMutex();
+        }
+        if (bus->dma_done == NULL) {
+            bus->dma_done = xSemaphoreCreateBinary();
+        }
+        if (bus->lock == NULL || bus->dma_done == NULL) {
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; i < DWT_NUM_DW_DEV; i++) {
+        const deca_port_config_t *dev = &deca_port_configs[i];
+
+        rcu_periph_clock_enable(dev->cs_rcu);
+        gpio_bit_set(dev->cs_port, dev->cs_pin);
+        gpio_mode_set(dev->cs_port, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+                      dev->cs_pin);
+        gpio_output_options_set(dev->cs_port, GPIO_OTYPE_PP,
+                                GPIO_OSPEED_50MHZ, dev->cs_pin);
+    }
+    return ret;
+}
 
 int closespi(void) { return 0; }
 
+int spicanblock(void) {
+    return (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) &&
+           (__get_IPSR() == 0) && (__get_BASEPRI() == 0) &&
+           (__get_PRIMASK() == 0);
+}
+
+int spibuslock(void) {
+    spi_bus_t *bus = spi_bus_current();
+
+    if (bus->lock == NULL || !spicanblock()) {
+        return 0;
+    }
+    xSemaphoreTakeRecursive(bus->lock, portMAX_DELAY);
+    return 1;
+}
+
+void spibusunlock(int locked) {
+    if (locked) {
+        xSemaphoreGiveRecursive(spi_bus_current()->lock);
+    }
+}
+
+static void spi_cs_select(spi_bus_t *bus, const deca_port_config_t *dev) {
+    uint32_t start;
+
+    while (spi_i2s_flag_get(bus->hw->spi, SPI_FLAG_TRANS) == SET);
+    gpio_bit_reset(dev->cs_port, dev->cs_pin);
+    start = DWT->CYCCNT;
+    while ((DWT->CYCCNT - start) < bus->cs_setup);
+}
+
+static void spi_cs_release(spi_bus_t *bus, const deca_port_config_t *dev) {
+    while (spi_i2s_flag_get(bus->hw->spi, SPI_FLAG_TRANS) == SET);
+    gpio_bit_set(dev->cs_port, dev->cs_pin);
+}
+
 #pragma GCC optimize("O3")
-int writetospi(uint16_t headerLength, const uint8_t *headerBuffer,
-               uint32_t bodyLength, const uint8_t *bodyBuffer) {
-    decaIrqStatus_t stat;
-    stat = decamutexon();
+static void spi_pio_transfer(uint32_t spi, uint32_t length,
+                             const uint8_t *txBuffer, uint8_t *rxBuffer) {
+    uint8_t rx;
 
-    while (spi_i2s_flag_get(SPI3, SPI_FLAG_TRANS) == SET);
-    gpio_bit_reset(GPIOE, GPIO_PIN_4);
-    for (volatile int delay = 0; delay < 100; delay++);    // 粗略延迟几个微秒
+    for (uint32_t i = 0; i < length; i++) {
+        while (spi_i2s_flag_get(spi, SPI_FLAG_TBE) == RESET);
+        spi_i2s_data_transmit(spi, txBuffer ? txBuffer[i] : 0x00);
+        while (spi_i2s_flag_get(spi, SPI_FLAG_RBNE) == RESET);
+        rx = spi_i2s_data_receive(spi);
+        if (rxBuffer) {
+            rxBuffer[i] = rx;
+        }
+    }
+}
 
-    for (uint16_t i = 0; i < headerLength; i++) {
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_TBE) == RESET);
-        spi_i2s_data_transmit(SPI3, headerBuffer[i]);
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_RBNE) == RESET);
-        (void)spi_i2s_data_receive(SPI3);
-    }
-    for (uint32_t i = 0; i < bodyLength; i++) {
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_TBE) == RESET);
-        spi_i2s_data_transmit(SPI3, bodyBuffer[i]);
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_RBNE) == RESET);
-        (void)spi_i2s_data_receive(SPI3);
-    }
-    gpio_bit_set(GPIOE, GPIO_PIN_4);
+// 按顺序以查询方式执行一批传输, 整批只取得一次总线并屏蔽一次 DW1000 中断线
+static int spi_pio_batch(spi_bus_t *bus, const deca_port_config_t *dev,
+                         dwt_spixfer_t *xfers, uint16_t count) {
+    decaIrqStatus_t stat = decamutexon();
+
+    for (uint16_t i = 0; i < count; i++) {
+        spi_cs_select(bus, dev);
+        spi_pio_transfer(bus->hw->spi, xfers[i].headerLength,
+                         xfers[i].header, NULL);
+        spi_pio_transfer(bus->hw->spi, xfers[i].length, xfers[i].txBuffer,
+                         xfers[i].rxBuffer);
+        spi_cs_release(bus, dev);
+    }
     decamutexoff(stat);
     return 0;
 }
 
-#pragma GCC optimize("O3")
+/* 启动一段全双工 DMA 传输. txBuffer 为 NULL 时发送 0x00, rxBuffer 为 NULL
+ * 时丢弃接收数据. DMA 不能访问 TCM, 缓冲区须位于普通 SRAM. */
+static void spi_dma_start(const deca_bus_config_t *hw, const uint8_t *txBuffer,
+                          uint8_t *rxBuffer, uint32_t length) {
+    dma_flag_clear(hw->dma, hw->dma_rx_ch, DMA_FLAG_FTF);
+    dma_flag_clear(hw->dma, hw->dma_tx_ch, DMA_FLAG_FTF);
+
+    dma_memory_address_config(hw->dma, hw->dma_rx_ch, DMA_MEMORY_0,
+                              rxBuffer ? (uint32_t)rxBuffer
+                                       : (uint32_t)&spi_dma_dummy);
+    dma_memory_address_generation_config(
+        hw->dma, hw->dma_rx_ch,
+        rxBuffer ? DMA_MEMORY_INCREASE_ENABLE : DMA_MEMORY_INCREASE_DISABLE);
+    dma_transfer_number_config(hw->dma, hw->dma_rx_ch, length);
+
+    dma_memory_address_config(hw->dma, hw->dma_tx_ch, DMA_MEMORY_0,
+                              txBuffer ? (uint32_t)txBuffer
+                                       : (uint32_t)&spi_dma_zero);
+    dma_memory_address_generation_config(
+        hw->dma, hw->dma_tx_ch,
+        txBuffer ? DMA_MEMORY_INCREASE_ENABLE : DMA_MEMORY_INCREASE_DISABLE);
+    dma_transfer_number_config(hw->dma, hw->dma_tx_ch, length);
+
+    // 先使能接收通道，避免第一个字节溢出
+    dma_channel_enable(hw->dma, hw->dma_rx_ch);
+    dma_channel_enable(hw->dma, hw->dma_tx_ch);
+}
+
+static void spi_q_finish(spi_bus_t *bus) {
+    spi_dma_disable(bus->hw->spi, SPI_DMA_TRANSMIT);
+    spi_dma_disable(bus->hw->spi, SPI_DMA_RECEIVE);
+    if (bus->q_exti) {
+        decairqline(bus->q_dev->exti_line, 1);
+    }
+    bus->q_busy = 0;
+}
+
+static void spi_q_start(spi_bus_t *bus) {
+    dwt_spixfer_t *x = &bus->q_xfers[bus->q_index];
+
+    spi_cs_select(bus, bus->q_dev);
+    bus->q_body = 0;
+    spi_dma_start(bus->hw, x->header, NULL, x->headerLength);
+}
+
+// 在 DMA 接收完成中断中推进批量传输, 整批完成时返回 1
+static int spi_q_step(spi_bus_t *bus) {
+    dwt_spixfer_t *x = &bus->q_xfers[bus->q_index];
+
+    if (!bus->q_body && x->length > 0) {
+        bus->q_body = 1;
+        spi_dma_start(bus->hw, x->txBuffer, x->rxBuffer, x->length);
+        return 0;
+    }
+    spi_cs_release(bus, bus->q_dev);
+
+    if (++bus->q_index < bus->q_count) {
+        spi_q_start(bus);
+        return 0;
+    }
+    spi_q_finish(bus);
+    return 1;
+}
+
+static void spi_q_abort(spi_bus_t *bus) {
+    taskENTER_CRITICAL();
+    if (bus->q_busy) {
+        dma_channel_disable(bus->hw->dma, bus->hw->dma_tx_ch);
+        dma_channel_disable(bus->hw->dma, bus->hw->dma_rx_ch);
+        spi_cs_release(bus, bus->q_dev);
+        spi_q_finish(bus);
+    }
+    taskEXIT_CRITICAL();
+}
+
+// 完成回调参数为总线, 由中断处理直接识别, 以便传入任务切换标志
+static void spi_dma_give(void *arg) {
+    xSemaphoreGiveFromISR(((spi_bus_t *)arg)->dma_done, NULL);
+}
+
+static void spi_bus_irq(spi_bus_t *bus) {
+    BaseType_t woken = pdFALSE;
+    const deca_bus_config_t *hw = bus->hw;
+
+    if (hw != NULL &&
+        dma_interrupt_flag_get(hw->dma, hw->dma_rx_ch, DMA_INT_FLAG_FTF)) {
+        dma_interrupt_flag_clear(hw->dma, hw->dma_rx_ch, DMA_INT_FLAG_FTF);
+        if (bus->q_busy && spi_q_step(bus)) {
+            if (bus->q_done == spi_dma_give) {
+                xSemaphoreGiveFromISR(bus->dma_done, &woken);
+            } else if (bus->q_done != NULL) {
+                bus->q_done(bus->q_arg);
+            }
+        }
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// 中断向量与 deca_bus_configs 中各总线的接收通道一一对应
+void DMA1_Channel0_IRQHandler(void) { spi_bus_irq(&spi_buses[0]); }
+
+#if DECA_NUM_BUS > 1
+void DMA1_Channel3_IRQHandler(void) { spi_bus_irq(&spi_buses[1]); }
+#endif
+
+static int spi_queue(spi_bus_t *bus, const deca_port_config_t *dev,
+                     dwt_spixfer_t *xfers, uint16_t count, dwt_spidone_t done,
+                     void *arg) {
+    if (count == 0) {
+        if (done != NULL) {
+            done(arg);
+        }
+        return 0;
+    }
+    if (bus->dma_done == NULL) {
+        spi_pio_batch(bus, dev, xfers, count);
+        if (done != NULL) {
+            done(arg);
+        }
+        return 0;
+    }
+    if (bus->q_busy) {
+        return -1;
+    }
+
+    bus->q_dev = dev;
+    bus->q_xfers = xfers;
+    bus->q_count = count;
+    bus->q_index = 0;
+    bus->q_done = done;
+    bus->q_arg = arg;
+    bus->q_busy = 1;
+
+    // 只屏蔽目标 DW1000 的中断线, 其它中断照常响应
+    bus->q_exti = decairqline(dev->exti_line, 0);
+
+    spi_dma_enable(bus->hw->spi, SPI_DMA_RECEIVE);
+    spi_dma_enable(bus->hw->spi, SPI_DMA_TRANSMIT);
+    spi_q_start(bus);
+    return 0;
+}
+
+int queuespi(dwt_spixfer_t *xfers, uint16_t count, dwt_spidone_t done,
+             void *arg) {
+    const deca_port_config_t *dev = decaportconfig();
+
+    return spi_queue(&spi_buses[dev->bus], dev, xfers, count, done, arg);
+}
+
+/* 执行一批传输并等待完成. 数据量较大且调用者可以阻塞时交给 DMA,
+ * 调用任务在完成信号量上阻塞期间 CPU 可以运行其他任务;
+ * 否则整批以查询方式完成, 期间只屏蔽 DW1000 中断线. */
+static void spi_stats_add(spi_bus_t *bus, uint32_t cycles) {
+    bus->stats.count++;
+    bus->stats.total += cycles;
+    if (cycles > bus->stats.max) {
+        bus->stats.max = cycles;
+    }
+}
+
+int transferspi(dwt_spixfer_t *xfers, uint16_t count) {
+    const deca_port_config_t *dev = decaportconfig();
+    spi_bus_t *bus = &spi_buses[dev->bus];
+    uint32_t start = DWT->CYCCNT;
+    uint32_t body = 0;
+    int locked = spibuslock();
+    int ret;
+
+    for (uint16_t i = 0; i < count; i++) {
+        body += xfers[i].length;
+    }
+
+    if (!locked || bus->dma_done == NULL || body < DECA_SPI_DMA_MIN_LENGTH) {
+        ret = spi_pio_batch(bus, dev, xfers, count);
+    } else {
+        xSemaphoreTake(bus->dma_done, 0);
+        ret = spi_queue(bus, dev, xfers, count, spi_dma_give, bus);
+        if (ret == 0 &&
+            xSemaphoreTake(bus->dma_done, DECA_SPI_DMA_TIMEOUT) != pdTRUE) {
+            spi_q_abort(bus);
+            ret = -1;
+        }
+    }
+    // 持有总线时统计, 未持有时 (中断或调度器未启动) 计数可能略有偏差
+    spi_stats_add(bus, DWT->CYCCNT - start);
+    spibusunlock(locked);
+    return ret;
+}
+
+int writetospi(uint16_t headerLength, const uint8_t *headerBuffer,
+               uint32_t bodyLength, const uint8_t *bodyBuffer) {
+    dwt_spixfer_t xfer;
+
+    xfer.headerLength = headerLength;
+    for (uint16_t i = 0; i < headerLength; i++) {
+        xfer.header[i] = headerBuffer[i];
+    }
+    xfer.length = (uint16_t)bodyLength;
+    xfer.txBuffer = bodyBuffer;
+    xfer.rxBuffer = NULL;
+    return transferspi(&xfer, 1);
+}
+
 int readfromspi(uint16_t headerLength, const uint8_t *headerBuffer,
                 uint32_t readlength, uint8_t *readBuffer) {
-    decaIrqStatus_t stat;
-    stat = decamutexon();
-
-    while (spi_i2s_flag_get(SPI3, SPI_FLAG_TRANS) == SET);
-    gpio_bit_reset(GPIOE, GPIO_PIN_4);
-    for (volatile int delay = 0; delay < 100; delay++);    // 粗略延迟几个微秒
+    dwt_spixfer_t xfer;
 
+    xfer.headerLength = headerLength;
     for (uint16_t i = 0; i < headerLength; i++) {
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_TBE) == RESET);
-        spi_i2s_data_transmit(SPI3, headerBuffer[i]);
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_RBNE) == RESET);
-        spi_i2s_data_receive(SPI3);
-    }
-    while (readlength-- > 0) {
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_TBE) == RESET);
-        spi_i2s_data_transmit(SPI3, 0x00);
-        while (spi_i2s_flag_get(SPI3, SPI_FLAG_RBNE) == RESET);
-        *readBuffer++ = spi_i2s_data_receive(SPI3);
-    }
-    gpio_bit_set(GPIOE, GPIO_PIN_4);
-    decamutexoff(stat);
-    return 0;
+        xfer.header[i] = headerBuffer[i];
+    }
+    xfer.length = (uint16_t)readlength;
+    xfer.txBuffer = NULL;
+    xfer.rxBuffer = readBuffer;
+    return transferspi(&xfer, 1);
 }
@@ -18,14 +18,37 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #include "deca_types.h"
 
 #define DECA_MAX_SPI_HEADER_LENGTH      (3)                     // max number of bytes in header (for formating & sizing)
+#define DECA_SPI_DMA_MIN_LENGTH         (16)                    // bodies shorter than this stay on the polled path
+#define DECA_SPI_CS_SETUP_NS            (50)                    // CS low to first SCLK edge, on top of half an SCLK period
+
+typedef struct
+{
+    uint32_t count;                 // number of transfers timed
+    uint32_t total;                 // sum of core cycles spent in transferspi()
+    uint32_t max;                   // longest single transfer in core cycles
+    uint32_t setup;                 // current CS setup time in core cycles
+} deca_spi_stats_t;
+
+typedef struct
+{
+    uint32_t reads;                 // dwt_read32bitreg() calls timed
+    uint32_t setup;                 // CS setup time used in core cycles
+    uint32_t min;                   // core cycles per call
+    uint32_t avg;
+    uint32_t max;
+} deca_spi_bench_t;
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * Function: openspi()
  *
- * Low level abstract function to open and initialise access to the SPI device.
+ * Low level abstract function to open and initialise access to the SPI device. Prepares the DMA channels of every bus
+ * and the chip selects of every device listed in deca_port.c; the SPI peripherals themselves are set up by the caller.
+ * The other functions below act on the bus of the device selected by the calling task (see decaselectdevice()).
  * returns 0 for success, or -1 for error
  */
 int openspi(void) ;
@@ -38,6 +61,60 @@ int openspi(void) ;
  */
 int closespi(void) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spicanblock()
+ *
+ * Returns 1 if the caller may block on the SPI bus, i.e. it is a task running with the scheduler started and
+ * interrupts are not masked. Transfers made from any other context stay on the polled path.
+ */
+int spicanblock(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spibuslock()
+ *
+ * Takes ownership of the SPI bus of the selected DW1000 (recursive). Does nothing if the caller cannot block (see spicanblock).
+ * returns a token to pass to spibusunlock()
+ */
+int spibuslock(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spibusunlock()
+ *
+ * Releases the bus ownership taken by spibuslock().
+ * @param locked - the value returned by the matching spibuslock() call
+ */
+void spibusunlock(int locked) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spisetrate()
+ *
+ * Recomputes the chip select setup time for a new SPI prescaler. Must be called whenever the SPI clock changes.
+ * @param prescale - the SPI_PSC_x value the bus of the selected device has been configured with
+ */
+void spisetrate(uint32_t prescale) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spigetstats()
+ *
+ * Copies the per-access timing counters (core cycles, measured with the DWT cycle counter).
+ * @param stats - destination
+ * @param reset - non-zero to clear the counters after reading
+ */
+void spigetstats(deca_spi_stats_t *stats, int reset) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: spibench()
+ *
+ * Times reads calls of dwt_read32bitreg(DEV_ID) on the selected device with the DWT cycle counter, at the SPI rate
+ * the bus currently runs at. The first run uses the CS setup computed by spisetrate(), the second one the delay loop
+ * the chip select used to wait in (timed once on the spot), so the two show the gain of the computed setup.
+ * The caller must own the device (no other task using it, DW1000 interrupt handling idle).
+ * @param reads  - number of calls timed per run
+ * @param now    - result with the computed CS setup
+ * @param before - result with the old delay loop, may be NULL
+ */
+void spibench(uint32_t reads, deca_spi_bench_t *now, deca_spi_bench_t *before) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,288 @@
+/* Host harness for the DW1000 SPI port (HAL/DW1000/platform): deca_port.c,
+ * deca_spi.c and deca_mutex.c run unchanged against the models in
+ * host_port.c, with two devices on two buses and pthreads as tasks.
+ *
+ *   cc -O2 -no-pie -pthread -DDWT_NUM_DW_DEV=2 -Ishim \
+ *      -I../../HAL/DW1000/decadriver -I../../HAL/DW1000/platform \
+ *      -o deca_spi_host deca_spi_host.c host_port.c \
+ *      ../../HAL/DW1000/platform/deca_port.c \
+ *      ../../HAL/DW1000/platform/deca_spi.c \
+ *      ../../HAL/DW1000/platform/deca_mutex.c
+ *   ./deca_spi_host [iterations per task]
+ *
+ * -no-pie and the task stacks below 4 GB keep every buffer address within
+ * the 32 bits the DMA registers take.
+ *
+ * Each task selects its device through the TLS slot and runs a random mix
+ * of short (polled) and long (DMA) reads and writes, three transfer batches
+ * and nested decamutexon() sections. The models check that only one chip
+ * select per bus is low at a time, that each transaction reaches the device
+ * its task selected and is not interleaved, that the device IRQ line is
+ * masked while it is accessed and that every read returns that device's
+ * bytes. The harness then checks that batches and mutex sections were not
+ * split by other tasks and that no IRQ mask update was lost.
+ * Exits with 1 on any failure.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_irq.h"
+#include "deca_port.h"
+#include "deca_spi.h"
+#include "host_port.h"
+
+#define TASKS_PER_DEV 3
+#define TASKS         (TASKS_PER_DEV * DWT_NUM_DW_DEV)
+#define STACK_SIZE    (256 * 1024)
+
+/* second byte of the transactions that must stay together */
+#define MARK_BATCH    0xE0    // 0xE0..0xE2, one transferspi() batch
+#define MARK_MUTEX    0xD0    // 0xD0..0xD1, inside one decamutexon() section
+
+typedef struct {
+    int task;
+    int dev;
+    unsigned iterations;
+    unsigned ops[5];
+    unsigned errors;
+} task_t;
+
+/* deca_spi.c uses it for spibench(); a register read as the driver does it */
+uint32_t dwt_read32bitoffsetreg(int regFileID, int regOffset) {
+    uint8 header = (uint8)regFileID;
+    uint8 buf[4];
+
+    (void)regOffset;
+    readfromspi(1, &header, 4, buf);
+    return (uint32)buf[0] | ((uint32)buf[1] << 8) | ((uint32)buf[2] << 16) |
+           ((uint32)buf[3] << 24);
+}
+
+static int check_read(task_t *t, const uint8_t *buf, uint16_t len,
+                      uint32_t header_len) {
+    for (uint16_t i = 0; i < len; i++) {
+        if (buf[i] != host_resp(t->dev, header_len + i)) {
+            host_fail("task %d: byte %u read from device %d is 0x%02x", t->task,
+                      i, t->dev, buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void read_one(task_t *t, uint8_t mark, uint16_t len) {
+    uint8_t header[2] = {HOST_TAG(t->dev, t->task), mark};
+    uint8_t buf[96];
+
+    if (readfromspi(mark ? 2 : 1, header, len, buf) != 0) {
+        host_fail("task %d: readfromspi() of %u bytes failed", t->task, len);
+    }
+    check_read(t, buf, len, mark ? 2 : 1);
+}
+
+static void write_one(task_t *t, uint16_t len) {
+    uint8_t header = HOST_TAG(t->dev, t->task);
+    uint8_t buf[96];
+
+    for (uint16_t i = 0; i < len; i++) {
+        buf[i] = header;
+    }
+    if (writetospi(1, &header, len, buf) != 0) {
+        host_fail("task %d: writetospi() of %u bytes failed", t->task, len);
+    }
+}
+
+static void batch(task_t *t, int small) {
+    uint8_t tag = HOST_TAG(t->dev, t->task);
+    uint8_t rx0[32];
+    uint8_t rx2[32];
+    uint8_t tx1[32];
+    dwt_spixfer_t x[3];
+    uint16_t len = small ? 2 : 24;    // polled batch or DMA batch
+
+    for (int i = 0; i < 32; i++) {
+        tx1[i] = tag;
+    }
+    for (int i = 0; i < 3; i++) {
+        x[i].headerLength = 2;
+        x[i].header[0] = tag;
+        x[i].header[1] = (uint8_t)(MARK_BATCH + i);
+        x[i].length = len;
+        x[i].txBuffer = NULL;
+        x[i].rxBuffer = NULL;
+    }
+    x[0].rxBuffer = rx0;
+    x[1].txBuffer = tx1;
+    x[2].rxBuffer = rx2;
+    if (transferspi(x, 3) != 0) {
+        host_fail("task %d: transferspi() batch failed", t->task);
+    }
+    check_read(t, rx0, len, 2);
+    check_read(t, rx2, len, 2);
+}
+
+static void mutex_section(task_t *t) {
+    decaIrqStatus_t s = decamutexon();
+    decaIrqStatus_t inner;
+
+    read_one(t, MARK_MUTEX, 40);
+    inner = decamutexon();    // nests, as in the driver
+    read_one(t, MARK_MUTEX + 1, 4);
+    decamutexoff(inner);
+    decamutexoff(s);
+}
+
+static void *task_main(void *arg) {
+    task_t *t = arg;
+    unsigned seed = (unsigned)t->task * 2654435761U;
+
+    decaselectdevice((unsigned)t->dev);
+    for (unsigned i = 0; i < t->iterations; i++) {
+        unsigned op = (seed = seed * 1103515245U + 12345U) >> 16;
+
+        op %= 5;
+        t->ops[op]++;
+        switch (op) {
+        case 0:
+            read_one(t, 0, 1 + (i % (DECA_SPI_DMA_MIN_LENGTH - 1)));
+            break;
+        case 1:
+            read_one(t, 0, DECA_SPI_DMA_MIN_LENGTH + (i % 80));
+            break;
+        case 2:
+            write_one(t, (i & 1) ? 4 : 64);
+            break;
+        case 3:
+            batch(t, i & 1);
+            break;
+        default:
+            mutex_section(t);
+            break;
+        }
+        if (decadeviceindex() != t->dev) {
+            host_fail("task %d: selection changed to %d", t->task,
+                      decadeviceindex());
+        }
+    }
+    return NULL;
+}
+
+/* transactions marked as a group must follow each other on the wire */
+static void check_groups(int bus) {
+    const host_seg_log_t *log = &host_seg_log[bus];
+    uint32_t switches = 0;
+
+    for (uint32_t i = 0; i < log->count; i++) {
+        const host_seg_t *s = &log->seg[i];
+        int first = -1;
+        int n = 0;
+
+        if (i > 0 && s->tag != log->seg[i - 1].tag) {
+            switches++;
+        }
+        if (s->b1 == MARK_BATCH) {
+            first = MARK_BATCH;
+            n = 3;
+        } else if (s->b1 == MARK_MUTEX) {
+            first = MARK_MUTEX;
+            n = 2;
+        }
+        for (int k = 1; k < n; k++) {
+            if (i + k >= log->count || log->seg[i + k].tag != s->tag ||
+                log->seg[i + k].b1 != first + k) {
+                host_fail("bus %d: group 0x%02x of 0x%02x split at %u", bus,
+                          first, s->tag, i);
+                break;
+            }
+        }
+    }
+    printf("bus %d: %u transactions, %u task switches on the wire\n", bus,
+           log->count, switches);
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    static task_t tasks[TASKS];
+    pthread_t threads[TASKS];
+    uint32_t armed = 0;
+    deca_spi_stats_t stats;
+    deca_mutex_stats_t mstats;
+    unsigned iterations = (argc > 1) ? (unsigned)atoi(argv[1]) : 20000;
+    double t;
+
+    for (int i = 0; i < DWT_NUM_DW_DEV; i++) {
+        armed |= deca_port_configs[i].exti_line;
+    }
+    host_start(armed);
+
+    // before the scheduler runs the selection is global
+    decaselectdevice(1);
+    if (decadeviceindex() != 1) {
+        host_fail("default selection not kept");
+    }
+    decaselectdevice(0);
+    if (openspi() != 0) {
+        host_fail("openspi() failed");
+    }
+    host_scheduler_start();
+
+    t = now();
+    for (int i = 0; i < TASKS; i++) {
+        pthread_attr_t attr;
+        // DMA addresses are 32 bits, so are the stacks the buffers live on
+        void *stack = mmap(NULL, STACK_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+        if (stack == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        tasks[i].task = i;
+        tasks[i].dev = i % DWT_NUM_DW_DEV;
+        tasks[i].iterations = iterations;
+        pthread_attr_init(&attr);
+        pthread_attr_setstack(&attr, stack, STACK_SIZE);
+        pthread_create(&threads[i], &attr, task_main, &tasks[i]);
+    }
+    for (int i = 0; i < TASKS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    t = now() - t;
+    host_stop_all();
+
+    for (int bus = 0; bus < DECA_NUM_BUS; bus++) {
+        check_groups(bus);
+    }
+    if (host_exti_inten != armed) {
+        host_fail("IRQ lines enabled 0x%05x after the run, expected 0x%05x",
+                  host_exti_inten, armed);
+    }
+    for (int i = 0; i < DWT_NUM_DW_DEV; i++) {
+        decaselectdevice((unsigned)i);
+        spigetstats(&stats, 0);
+        printf("device %d: %u transfers\n", i, stats.count);
+    }
+    decamutexgetstats(&mstats, 0);
+
+    printf("%d tasks x %u iterations in %.2f s\n", TASKS, iterations, t);
+    printf("%llu transactions, %llu polled bytes, %llu DMA bytes in %llu DMA "
+           "transfers, %u mutex sections\n",
+           (unsigned long long)host_counters.segments,
+           (unsigned long long)host_counters.pio_bytes,
+           (unsigned long long)host_counters.dma_bytes,
+           (unsigned long long)host_counters.dma_transfers,
+           mstats.masked_count);
+    printf("%u failures\n", host_counters.errors);
+    return host_counters.errors != 0;
+}
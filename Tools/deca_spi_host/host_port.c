@@ -0,0 +1,585 @@
+/* Peripheral and RTOS models behind the shim headers.
+ *
+ * SPI buses: a byte written to the data register is exchanged at once with
+ * the device whose chip select is low on that bus. The device answers with
+ * host_resp(dev, k) for the k-th byte of the transaction and checks what it
+ * is sent (see host_port.h). DMA: one engine thread per bus runs a transfer
+ * once both channels and the SPI DMA requests are enabled, then raises the
+ * RX channel interrupt: it calls the handler from deca_spi.c with the
+ * interrupt flag set and the critical section taken, as the NVIC would.
+ * DWT->CYCCNT follows the host clock.
+ * EXTI_INTEN read-modify-writes yield in the middle, where a task or an
+ * interrupt could preempt them on the target. */
+#define _GNU_SOURCE
+#include "host_port.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deca_port.h"
+#include "freertos.h"
+#include "gd32f4xx.h"
+
+#define HOST_BUSES 2
+#define HOST_GPIO_PORTS 8
+#define HOST_TICK_MS 100
+
+void DMA1_Channel0_IRQHandler(void);
+void DMA1_Channel3_IRQHandler(void);
+
+volatile uint32_t host_spi_data[2];
+volatile uint32_t host_exti_inten;
+static host_dwt_t host_dwt;
+host_coredebug_t host_coredebug;
+uint32_t SystemCoreClock = 240000000U;
+
+host_counters_t host_counters;
+uint32_t host_exti_armed;
+host_seg_log_t host_seg_log[HOST_BUSES];
+
+static volatile int host_sched = taskSCHEDULER_NOT_STARTED;
+static volatile int host_stop;
+static __thread int host_in_isr;
+static __thread void *host_tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+
+static pthread_mutex_t host_critical;
+static pthread_mutex_t host_model = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t host_gpio_out[HOST_GPIO_PORTS];
+
+/* ------------------------------------------------------------ errors */
+
+void host_fail(const char *fmt, ...) {
+    va_list ap;
+
+    if (__atomic_fetch_add(&host_counters.errors, 1, __ATOMIC_RELAXED) < 20) {
+        va_start(ap, fmt);
+        fprintf(stderr, "FAIL ");
+        vfprintf(stderr, fmt, ap);
+        fprintf(stderr, "\n");
+        va_end(ap);
+    }
+}
+
+/* ------------------------------------------------------------ RTOS */
+
+struct host_sem {
+    pthread_mutex_t m;
+    pthread_cond_t c;
+    int recursive;
+    int count;    // binary: 0/1; mutex: 1 when free
+    pthread_t owner;
+    int depth;
+};
+
+void host_critical_enter(void) { pthread_mutex_lock(&host_critical); }
+
+void host_critical_exit(void) { pthread_mutex_unlock(&host_critical); }
+
+BaseType_t xTaskGetSchedulerState(void) { return host_sched; }
+
+void host_scheduler_start(void) { host_sched = taskSCHEDULER_RUNNING; }
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index,
+                                       void *value) {
+    (void)task;
+    host_tls[index] = value;
+}
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index) {
+    (void)task;
+    return host_tls[index];
+}
+
+static SemaphoreHandle_t host_sem_new(int recursive, int count) {
+    struct host_sem *s = calloc(1, sizeof(*s));
+
+    pthread_mutex_init(&s->m, NULL);
+    pthread_cond_init(&s->c, NULL);
+    s->recursive = recursive;
+    s->count = count;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return host_sem_new(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return host_sem_new(0, 1); }
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return host_sem_new(0, 0); }
+
+static int host_sem_wait(struct host_sem *s, TickType_t ticks) {
+    struct timespec until;
+
+    if (ticks == portMAX_DELAY) {
+        return pthread_cond_wait(&s->c, &s->m);
+    }
+    // a tick lasts HOST_TICK_MS: threads of a loaded host get descheduled
+    // for far longer than tasks on the target
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ((long)ticks * HOST_TICK_MS) / 1000;
+    until.tv_nsec += (((long)ticks * HOST_TICK_MS) % 1000) * 1000000L;
+    until.tv_sec += until.tv_nsec / 1000000000L;
+    until.tv_nsec %= 1000000000L;
+    return pthread_cond_timedwait(&s->c, &s->m, &until);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    BaseType_t ret = pdTRUE;
+
+    if (host_in_isr) {
+        host_fail("xSemaphoreTake() from an interrupt");
+    }
+    pthread_mutex_lock(&s->m);
+    while (s->count == 0) {
+        if (ticks == 0 || host_sem_wait(s, ticks) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (s->count > 0) {
+        s->count--;
+    } else {
+        ret = pdFALSE;
+    }
+    pthread_mutex_unlock(&s->m);
+    return ret;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    pthread_mutex_lock(&s->m);
+    s->count = 1;
+    pthread_cond_signal(&s->c);
+    pthread_mutex_unlock(&s->m);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *woken) {
+    if (!host_in_isr) {
+        host_fail("xSemaphoreGiveFromISR() outside an interrupt");
+    }
+    if (woken != NULL) {
+        *woken = pdTRUE;
+    }
+    return xSemaphoreGive(s);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t ticks) {
+    pthread_t self = pthread_self();
+
+    pthread_mutex_lock(&s->m);
+    if (s->depth > 0 && pthread_equal(s->owner, self)) {
+        s->depth++;
+    } else {
+        while (s->depth > 0) {
+            host_sem_wait(s, ticks);
+        }
+        s->owner = self;
+        s->depth = 1;
+    }
+    pthread_mutex_unlock(&s->m);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) {
+    pthread_mutex_lock(&s->m);
+    if (s->depth == 0 || !pthread_equal(s->owner, pthread_self())) {
+        host_fail("bus lock given back by a task not holding it");
+    } else if (--s->depth == 0) {
+        pthread_cond_signal(&s->c);
+    }
+    pthread_mutex_unlock(&s->m);
+    return pdTRUE;
+}
+
+/* ------------------------------------------------------------ core */
+
+uint32_t __get_IPSR(void) { return host_in_isr ? 56U : 0U; }
+
+uint32_t __get_BASEPRI(void) { return 0; }
+
+uint32_t __get_PRIMASK(void) { return 0; }
+
+host_dwt_t *host_dwt_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    host_dwt.CYCCNT = (uint32_t)(((uint64_t)ts.tv_sec * 1000000000U +
+                                  (uint64_t)ts.tv_nsec) *
+                                 (SystemCoreClock / 1000000U) / 1000U);
+    return &host_dwt;
+}
+
+void rcu_periph_clock_enable(rcu_periph_enum periph) { (void)periph; }
+
+uint32_t rcu_clock_freq_get(rcu_clock_freq_enum clock) {
+    (void)clock;
+    return 120000000U;
+}
+
+void nvic_irq_enable(IRQn_Type irq, uint8_t pre, uint8_t sub) {
+    (void)irq;
+    (void)pre;
+    (void)sub;
+}
+
+/* ------------------------------------------------------------ EXTI */
+
+void exti_interrupt_enable(exti_line_enum line) {
+    uint32_t v = host_exti_inten;
+
+    sched_yield();
+    host_exti_inten = v | line;
+}
+
+void exti_interrupt_disable(exti_line_enum line) {
+    uint32_t v = host_exti_inten;
+
+    sched_yield();
+    host_exti_inten = v & ~(uint32_t)line;
+}
+
+/* ------------------------------------------------------------ devices */
+
+typedef struct {
+    int selected;    // device with its chip select low, -1 for none
+    uint32_t k;      // byte index in the transaction
+    uint8_t tag;     // first byte of the transaction
+    uint8_t b1;
+    uint8_t rx;      // data register read back
+    int dma_active;
+} host_bus_t;
+
+static host_bus_t host_bus[HOST_BUSES] = {{-1}, {-1}};
+
+static int host_cs_device(uint32_t port, uint32_t pin) {
+    for (int i = 0; i < DWT_NUM_DW_DEV; i++) {
+        if (deca_port_configs[i].cs_port == port &&
+            deca_port_configs[i].cs_pin == pin) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void host_cs(int dev, int low) {
+    host_bus_t *b = &host_bus[deca_port_configs[dev].bus];
+    host_seg_log_t *log = &host_seg_log[deca_port_configs[dev].bus];
+
+    pthread_mutex_lock(&host_model);
+    if (low) {
+        if (b->selected >= 0) {
+            host_fail("bus %u: CS of device %d low while device %d selected",
+                      deca_port_configs[dev].bus, dev, b->selected);
+        }
+        b->selected = dev;
+        b->k = 0;
+    } else if (b->selected == dev) {
+        if (log->count < HOST_SEG_LOG_LEN) {
+            log->seg[log->count].tag = b->tag;
+            log->seg[log->count].b1 = b->b1;
+            log->count++;
+        }
+        host_counters.segments++;
+        b->selected = -1;
+    }
+    pthread_mutex_unlock(&host_model);
+}
+
+/* one byte on the wire of bus, the model lock held */
+static uint8_t host_exchange(uint32_t bus, uint8_t tx) {
+    host_bus_t *b = &host_bus[bus];
+    int dev = b->selected;
+
+    if (dev < 0) {
+        host_fail("bus %u: byte 0x%02x clocked with no chip select", bus, tx);
+        return 0xFF;
+    }
+    if (host_exti_armed & deca_port_configs[dev].exti_line &
+        host_exti_inten) {
+        host_fail("device %d: IRQ line not masked during an access", dev);
+    }
+    if (b->k == 0) {
+        b->tag = tx;
+        b->b1 = 0;
+        if (HOST_TAG_DEV(tx) != dev) {
+            host_fail("device %d addressed by a task that selected %d", dev,
+                      HOST_TAG_DEV(tx));
+        }
+    } else if (b->k == 1) {
+        b->b1 = tx;
+    } else if (tx != b->tag && tx != 0) {
+        host_fail("bus %u: byte 0x%02x inside a transaction of 0x%02x", bus,
+                  tx, b->tag);
+    }
+    return host_resp(dev, b->k++);
+}
+
+void gpio_bit_set(uint32_t port, uint32_t pin) {
+    int dev = host_cs_device(port, pin);
+
+    host_gpio_out[port] |= pin;
+    if (dev >= 0) {
+        host_cs(dev, 0);
+    }
+}
+
+void gpio_bit_reset(uint32_t port, uint32_t pin) {
+    int dev = host_cs_device(port, pin);
+
+    host_gpio_out[port] &= ~pin;
+    if (dev >= 0) {
+        host_cs(dev, 1);
+    }
+}
+
+void gpio_mode_set(uint32_t port, uint32_t mode, uint32_t pull, uint32_t pin) {
+    (void)port;
+    (void)mode;
+    (void)pull;
+    (void)pin;
+}
+
+void gpio_output_options_set(uint32_t port, uint8_t otype, uint32_t speed,
+                             uint32_t pin) {
+    (void)port;
+    (void)otype;
+    (void)speed;
+    (void)pin;
+}
+
+/* ------------------------------------------------------------ SPI */
+
+static uint8_t host_spi_dma[HOST_BUSES];
+
+FlagStatus spi_i2s_flag_get(uint32_t spi, uint32_t flag) {
+    (void)spi;
+    // bytes are exchanged as they are written
+    return (flag == SPI_FLAG_TRANS) ? RESET : SET;
+}
+
+void spi_i2s_data_transmit(uint32_t spi, uint16_t data) {
+    pthread_mutex_lock(&host_model);
+    if (host_bus[spi].dma_active) {
+        host_fail("bus %u: polled byte during a DMA transfer", spi);
+    }
+    host_bus[spi].rx = host_exchange(spi, (uint8_t)data);
+    host_counters.pio_bytes++;
+    pthread_mutex_unlock(&host_model);
+}
+
+uint16_t spi_i2s_data_receive(uint32_t spi) { return host_bus[spi].rx; }
+
+/* ------------------------------------------------------------ DMA */
+
+typedef struct {
+    uint32_t addr;
+    uint8_t inc;
+    uint32_t number;
+    uint8_t enabled;
+    uint8_t flags;
+    uint8_t irq;
+} host_dma_ch_t;
+
+typedef struct {
+    uint32_t spi;
+    dma_channel_enum rx;
+    dma_channel_enum tx;
+    void (*handler)(void);
+    pthread_t thread;
+} host_dma_bus_t;
+
+static host_dma_ch_t host_dma_ch[8];
+static pthread_cond_t host_dma_kick = PTHREAD_COND_INITIALIZER;
+static host_dma_bus_t host_dma_bus[HOST_BUSES] = {
+    {SPI3, DMA_CH0, DMA_CH1, DMA1_Channel0_IRQHandler},
+#if DWT_NUM_DW_DEV > 1
+    {SPI4, DMA_CH3, DMA_CH4, DMA1_Channel3_IRQHandler},
+#endif
+};
+
+void spi_dma_enable(uint32_t spi, uint8_t dir) {
+    pthread_mutex_lock(&host_model);
+    host_spi_dma[spi] |= 1U << dir;
+    pthread_cond_broadcast(&host_dma_kick);
+    pthread_mutex_unlock(&host_model);
+}
+
+void spi_dma_disable(uint32_t spi, uint8_t dir) {
+    pthread_mutex_lock(&host_model);
+    host_spi_dma[spi] &= ~(1U << dir);
+    pthread_mutex_unlock(&host_model);
+}
+
+void dma_deinit(uint32_t dma, dma_channel_enum ch) {
+    (void)dma;
+    memset(&host_dma_ch[ch], 0, sizeof(host_dma_ch[ch]));
+}
+
+void dma_single_data_para_struct_init(dma_single_data_parameter_struct *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+void dma_single_data_mode_init(uint32_t dma, dma_channel_enum ch,
+                               dma_single_data_parameter_struct *p) {
+    (void)dma;
+    host_dma_ch[ch].inc = (uint8_t)p->memory_inc;
+}
+
+void dma_channel_subperipheral_select(uint32_t dma, dma_channel_enum ch,
+                                      dma_subperipheral_enum sub) {
+    (void)dma;
+    (void)ch;
+    (void)sub;
+}
+
+void dma_interrupt_enable(uint32_t dma, dma_channel_enum ch, uint32_t source) {
+    (void)dma;
+    (void)source;
+    host_dma_ch[ch].irq = 1;
+}
+
+void dma_flag_clear(uint32_t dma, dma_channel_enum ch, uint32_t flag) {
+    (void)dma;
+    pthread_mutex_lock(&host_model);
+    host_dma_ch[ch].flags &= (uint8_t)~flag;
+    pthread_mutex_unlock(&host_model);
+}
+
+void dma_memory_address_config(uint32_t dma, dma_channel_enum ch,
+                               uint8_t memory, uint32_t address) {
+    (void)dma;
+    (void)memory;
+    host_dma_ch[ch].addr = address;
+}
+
+void dma_memory_address_generation_config(uint32_t dma, dma_channel_enum ch,
+                                          uint8_t generation) {
+    (void)dma;
+    host_dma_ch[ch].inc = generation;
+}
+
+void dma_transfer_number_config(uint32_t dma, dma_channel_enum ch,
+                                uint32_t number) {
+    (void)dma;
+    host_dma_ch[ch].number = number;
+}
+
+void dma_channel_enable(uint32_t dma, dma_channel_enum ch) {
+    (void)dma;
+    pthread_mutex_lock(&host_model);
+    host_dma_ch[ch].enabled = 1;
+    pthread_cond_broadcast(&host_dma_kick);
+    pthread_mutex_unlock(&host_model);
+}
+
+void dma_channel_disable(uint32_t dma, dma_channel_enum ch) {
+    (void)dma;
+    pthread_mutex_lock(&host_model);
+    host_dma_ch[ch].enabled = 0;
+    pthread_mutex_unlock(&host_model);
+}
+
+FlagStatus dma_interrupt_flag_get(uint32_t dma, dma_channel_enum ch,
+                                  uint32_t flag) {
+    (void)dma;
+    return (host_dma_ch[ch].flags & flag) ? SET : RESET;
+}
+
+void dma_interrupt_flag_clear(uint32_t dma, dma_channel_enum ch,
+                              uint32_t flag) {
+    dma_flag_clear(dma, ch, flag);
+}
+
+static int host_dma_ready(const host_dma_bus_t *d) {
+    return host_dma_ch[d->rx].enabled && host_dma_ch[d->tx].enabled &&
+           host_spi_dma[d->spi] == 3;
+}
+
+static void *host_dma_engine(void *arg) {
+    host_dma_bus_t *d = arg;
+    host_dma_ch_t *rx = &host_dma_ch[d->rx];
+    host_dma_ch_t *tx = &host_dma_ch[d->tx];
+
+    pthread_mutex_lock(&host_model);
+    while (!host_stop) {
+        if (!host_dma_ready(d)) {
+            pthread_cond_wait(&host_dma_kick, &host_model);
+            continue;
+        }
+        if (rx->number != tx->number) {
+            host_fail("bus %u: DMA RX %u bytes, TX %u bytes", d->spi,
+                      rx->number, tx->number);
+        }
+        host_bus[d->spi].dma_active = 1;
+        for (uint32_t i = 0; i < tx->number && host_dma_ready(d); i++) {
+            const uint8_t *src =
+                (const uint8_t *)(uintptr_t)tx->addr + (tx->inc ? i : 0);
+            uint8_t *dst = (uint8_t *)(uintptr_t)rx->addr + (rx->inc ? i : 0);
+
+            *dst = host_exchange(d->spi, *src);
+            host_counters.dma_bytes++;
+            if ((i & 7) == 7) {
+                // let the tasks run, as the CPU does while the DMA works
+                pthread_mutex_unlock(&host_model);
+                sched_yield();
+                pthread_mutex_lock(&host_model);
+            }
+        }
+        host_bus[d->spi].dma_active = 0;
+        if (!host_dma_ready(d)) {
+            continue;    // aborted
+        }
+        rx->enabled = 0;
+        tx->enabled = 0;
+        rx->flags |= DMA_INT_FLAG_FTF;
+        tx->flags |= DMA_INT_FLAG_FTF;
+        host_counters.dma_transfers++;
+        pthread_mutex_unlock(&host_model);
+
+        if (rx->irq) {
+            // held off by critical sections like a priority 6 interrupt
+            host_critical_enter();
+            host_in_isr = 1;
+            d->handler();
+            host_in_isr = 0;
+            host_critical_exit();
+        }
+        pthread_mutex_lock(&host_model);
+    }
+    pthread_mutex_unlock(&host_model);
+    return NULL;
+}
+
+/* ------------------------------------------------------------ set up */
+
+
+void host_start(uint32_t exti_armed) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&host_critical, &attr);
+
+    host_exti_armed = exti_armed;
+    host_exti_inten = exti_armed;
+    for (int i = 0; i < DECA_NUM_BUS; i++) {
+        pthread_create(&host_dma_bus[i].thread, NULL, host_dma_engine,
+                       &host_dma_bus[i]);
+    }
+}
+
+void host_stop_all(void) {
+    host_stop = 1;
+    pthread_mutex_lock(&host_model);
+    pthread_cond_broadcast(&host_dma_kick);
+    pthread_mutex_unlock(&host_model);
+    for (int i = 0; i < DECA_NUM_BUS; i++) {
+        pthread_join(host_dma_bus[i].thread, NULL);
+    }
+}
@@ -0,0 +1,53 @@
+/* Host models of the GD32 SPI/DMA/GPIO/EXTI peripherals and of the
+ * FreeRTOS calls used by deca_port.c, deca_spi.c and deca_mutex.c. */
+#ifndef HOST_PORT_H
+#define HOST_PORT_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/* The first byte of every transaction is a tag: the device the sending task
+ * selected in bit 7, the task in the low bits. The other bytes written are
+ * the tag or 0, except the second one, which is free (batch markers). */
+#define HOST_TAG(dev, task) ((uint8_t)(((dev) << 7) | ((task) + 1)))
+#define HOST_TAG_DEV(tag)   ((tag) >> 7)
+
+/* Byte a device clocks out as byte k of a transaction. */
+static inline uint8_t host_resp(int dev, uint32_t k) {
+    return (uint8_t)(0x5A ^ (dev * 0x33) ^ (k * 7));
+}
+
+#define HOST_SEG_LOG_LEN (1 << 20)
+
+typedef struct {
+    uint8_t tag;
+    uint8_t b1;
+} host_seg_t;
+
+/* transactions in wire order, per bus */
+typedef struct {
+    uint32_t count;
+    host_seg_t seg[HOST_SEG_LOG_LEN];
+} host_seg_log_t;
+
+typedef struct {
+    uint32_t errors;
+    uint64_t segments;
+    uint64_t pio_bytes;
+    uint64_t dma_bytes;
+    uint64_t dma_transfers;
+} host_counters_t;
+
+extern host_counters_t host_counters;
+extern host_seg_log_t host_seg_log[2];
+extern uint32_t host_exti_armed;
+
+void host_fail(const char *fmt, ...);
+
+/* Start the cycle counter and the DMA engines; exti_armed are the DW1000 IRQ
+ * lines enabled, as deca_irq_init() would leave them. */
+void host_start(uint32_t exti_armed);
+void host_scheduler_start(void);
+void host_stop_all(void);
+
+#endif /* HOST_PORT_H */
@@ -0,0 +1,53 @@
+/* Host stand-in for the FreeRTOS API used by the DW1000 platform layer.
+ * Tasks are pthreads, semaphores are mutex/condition pairs and the critical
+ * section is one recursive mutex that the simulated interrupts also take,
+ * as interrupts at or below configMAX_SYSCALL_INTERRUPT_PRIORITY would be
+ * held off. Implemented in host_port.c. */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct host_sem *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  1
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFFU)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define configMAX_PRIORITIES 8
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 2
+
+#define taskSCHEDULER_SUSPENDED   0
+#define taskSCHEDULER_NOT_STARTED 1
+#define taskSCHEDULER_RUNNING     2
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define taskENTER_CRITICAL()           host_critical_enter()
+#define taskEXIT_CRITICAL()            host_critical_exit()
+#define taskENTER_CRITICAL_FROM_ISR()  (host_critical_enter(), (UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(x)  ((void)(x), host_critical_exit())
+#define portYIELD_FROM_ISR(x)          ((void)(x))
+
+BaseType_t xTaskGetSchedulerState(void);
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index,
+                                       void *value);
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index);
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken);
+
+#endif /* FREERTOS_H */
@@ -0,0 +1,174 @@
+/* Host stand-in for the GD32F4xx device header: just what deca_port.c,
+ * deca_spi.c and deca_mutex.c use. The peripherals are modelled in
+ * host_port.c. */
+#ifndef GD32F4XX_H
+#define GD32F4XX_H
+
+#include <stdint.h>
+
+typedef enum { RESET = 0, SET = 1 } FlagStatus;
+
+typedef enum {
+    DMA1_Channel0_IRQn = 56,
+    DMA1_Channel3_IRQn = 59,
+} IRQn_Type;
+
+typedef enum {
+    RCU_GPIOE,
+    RCU_GPIOF,
+    RCU_DMA1,
+} rcu_periph_enum;
+
+typedef enum { CK_APB2 } rcu_clock_freq_enum;
+
+typedef enum {
+    DMA_CH0,
+    DMA_CH1,
+    DMA_CH2,
+    DMA_CH3,
+    DMA_CH4,
+    DMA_CH5,
+    DMA_CH6,
+    DMA_CH7,
+} dma_channel_enum;
+
+typedef enum {
+    DMA_SUBPERI0,
+    DMA_SUBPERI1,
+    DMA_SUBPERI2,
+    DMA_SUBPERI3,
+    DMA_SUBPERI4,
+} dma_subperipheral_enum;
+
+typedef enum {
+    EXTI_10 = 1 << 10,
+    EXTI_15 = 1 << 15,
+} exti_line_enum;
+
+typedef struct {
+    uint32_t periph_addr;
+    uint32_t periph_inc;
+    uint32_t memory0_addr;
+    uint32_t memory_inc;
+    uint32_t periph_memory_width;
+    uint32_t number;
+    uint32_t circular_mode;
+    uint32_t direction;
+    uint32_t priority;
+} dma_single_data_parameter_struct;
+
+/* peripheral "addresses" are indexes into the models */
+#define SPI3  0U
+#define SPI4  1U
+#define DMA1  1U
+#define GPIOE 4U
+#define GPIOF 5U
+
+#define GPIO_PIN_4  (1U << 4)
+#define GPIO_PIN_6  (1U << 6)
+#define GPIO_PIN_10 (1U << 10)
+#define GPIO_PIN_15 (1U << 15)
+
+#define GPIO_MODE_OUTPUT  1U
+#define GPIO_PUPD_NONE    0U
+#define GPIO_OTYPE_PP     0U
+#define GPIO_OSPEED_50MHZ 2U
+
+#define EXTI_SOURCE_GPIOE 4U
+#define EXTI_SOURCE_GPIOF 5U
+#define EXTI_SOURCE_PIN10 10U
+#define EXTI_SOURCE_PIN15 15U
+
+#define SPI_CTL0_PSC      (7U << 3)
+#define SPI_PSC_32        (4U << 3)
+#define SPI_PSC_128       (6U << 3)
+#define SPI_FLAG_RBNE     (1U << 0)
+#define SPI_FLAG_TBE      (1U << 1)
+#define SPI_FLAG_TRANS    (1U << 7)
+#define SPI_DMA_TRANSMIT  0U
+#define SPI_DMA_RECEIVE   1U
+
+#define DMA_PERIPH_TO_MEMORY        0U
+#define DMA_MEMORY_TO_PERIPH        1U
+#define DMA_PERIPH_INCREASE_DISABLE 0U
+#define DMA_MEMORY_INCREASE_ENABLE  1U
+#define DMA_MEMORY_INCREASE_DISABLE 0U
+#define DMA_PERIPH_WIDTH_8BIT       0U
+#define DMA_CIRCULAR_MODE_DISABLE   0U
+#define DMA_PRIORITY_HIGH           2U
+#define DMA_MEMORY_0                0U
+#define DMA_INT_FTF                 (1U << 4)
+#define DMA_FLAG_FTF                (1U << 5)
+#define DMA_INT_FLAG_FTF            (1U << 5)
+
+extern volatile uint32_t host_spi_data[2];
+#define SPI_DATA(spi) (host_spi_data[(spi)])
+
+extern volatile uint32_t host_exti_inten;
+#define EXTI_INTEN host_exti_inten
+
+/* DWT cycle counter: every access through DWT reloads CYCCNT from the host
+ * clock, at SystemCoreClock */
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} host_dwt_t;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} host_coredebug_t;
+
+extern host_coredebug_t host_coredebug;
+host_dwt_t *host_dwt_now(void);
+#define DWT       (host_dwt_now())
+#define CoreDebug (&host_coredebug)
+#define DWT_CTRL_CYCCNTENA_Msk      1U
+#define CoreDebug_DEMCR_TRCENA_Msk  (1U << 24)
+
+extern uint32_t SystemCoreClock;
+
+uint32_t __get_IPSR(void);
+uint32_t __get_BASEPRI(void);
+uint32_t __get_PRIMASK(void);
+
+void rcu_periph_clock_enable(rcu_periph_enum periph);
+uint32_t rcu_clock_freq_get(rcu_clock_freq_enum clock);
+void nvic_irq_enable(IRQn_Type irq, uint8_t pre, uint8_t sub);
+
+void gpio_bit_set(uint32_t port, uint32_t pin);
+void gpio_bit_reset(uint32_t port, uint32_t pin);
+void gpio_mode_set(uint32_t port, uint32_t mode, uint32_t pull, uint32_t pin);
+void gpio_output_options_set(uint32_t port, uint8_t otype, uint32_t speed,
+                             uint32_t pin);
+
+void exti_interrupt_enable(exti_line_enum line);
+void exti_interrupt_disable(exti_line_enum line);
+
+FlagStatus spi_i2s_flag_get(uint32_t spi, uint32_t flag);
+void spi_i2s_data_transmit(uint32_t spi, uint16_t data);
+uint16_t spi_i2s_data_receive(uint32_t spi);
+void spi_dma_enable(uint32_t spi, uint8_t dir);
+void spi_dma_disable(uint32_t spi, uint8_t dir);
+
+void dma_deinit(uint32_t dma, dma_channel_enum ch);
+void dma_single_data_para_struct_init(dma_single_data_parameter_struct *p);
+void dma_single_data_mode_init(uint32_t dma, dma_channel_enum ch,
+                               dma_single_data_parameter_struct *p);
+void dma_channel_subperipheral_select(uint32_t dma, dma_channel_enum ch,
+                                      dma_subperipheral_enum sub);
+void dma_interrupt_enable(uint32_t dma, dma_channel_enum ch, uint32_t source);
+void dma_flag_clear(uint32_t dma, dma_channel_enum ch, uint32_t flag);
+void dma_memory_address_config(uint32_t dma, dma_channel_enum ch,
+                               uint8_t memory, uint32_t address);
+void dma_memory_address_generation_config(uint32_t dma, dma_channel_enum ch,
+                                          uint8_t generation);
+void dma_transfer_number_config(uint32_t dma, dma_channel_enum ch,
+                                uint32_t number);
+void dma_channel_enable(uint32_t dma, dma_channel_enum ch);
+void dma_channel_disable(uint32_t dma, dma_channel_enum ch);
+FlagStatus dma_interrupt_flag_get(uint32_t dma, dma_channel_enum ch,
+                                  uint32_t flag);
+void dma_interrupt_flag_clear(uint32_t dma, dma_channel_enum ch,
+                              uint32_t flag);
+
+#endif /* GD32F4XX_H */
@@ -0,0 +1,2 @@
+/* Host stand-in, see freertos.h. */
+#include "freertos.h"
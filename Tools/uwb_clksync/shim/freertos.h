@@ -0,0 +1,22 @@
+/* Host stand-in for FreeRTOS: single threaded, critical sections are no-ops,
+ * one tick per millisecond. */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef unsigned long UBaseType_t;
+typedef long BaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE                  1
+#define pdPASS                  1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif /* FREERTOS_H */
@@ -0,0 +1,15 @@
+/* Host stand-in for the FreeRTOS task API used by the sync engine. The tick
+ * count is the simulated time; the rest is only needed to link. */
+#ifndef TASK_H
+#define TASK_H
+
+#include "freertos.h"
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint16_t stack,
+                       void *arg, UBaseType_t priority, TaskHandle_t *task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+void vTaskDelayUntil(TickType_t *last, TickType_t increment);
+
+#endif /* TASK_H */
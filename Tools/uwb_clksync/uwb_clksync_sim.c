@@ -0,0 +1,238 @@
+/* Host simulation of the follower side of Application/uwb/uwb_clksync.c.
+ *
+ *   cc -O2 -Ishim -I../../Application/uwb -I../../HAL/DW1000/decadriver \
+ *      -I../../HAL/DW1000/platform -o uwb_clksync_sim uwb_clksync_sim.c \
+ *      ../../Application/uwb/uwb_clksync.c -lm
+ *   ./uwb_clksync_sim
+ *
+ * A reference sends a sync frame every SYNC_MS; the follower's clock runs
+ * at a fixed offset from it and stamps each arrival with Gaussian noise.
+ * The frames go through uwb_clksync_rx() as the receive engine would hand
+ * them over, with the 40-bit counters wrapping every 17.2 s. After each sync
+ * a noiseless local stamp CONVERT_MS later is converted and compared with
+ * the reference time it stands for. Errors are taken once the filter has
+ * settled (SETTLE_S). Besides the steady case, the reference reboots or
+ * sends a garbled timestamp between the first two syncs, and the offset is
+ * put just inside and beyond the 100 ppm the model accepts.
+ * Exits with 1 if any check failed.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task.h"
+#include "uwb_clksync.h"
+
+#define DTU_PER_S    63897600000.0    // 499.2 MHz * 128
+#define SYNC_MS      100
+#define CONVERT_MS   50
+#define SETTLE_S     30
+#define NOISE_DTU    6.0              // RX timestamp noise, one sigma
+#define TOF_DTU      2131             // 10 m
+
+// limits for the steady cases: the drift to 1 ppb, a conversion CONVERT_MS
+// after a sync to 20 dtu (0.31 ns)
+#define DRIFT_TOL_PPB  1
+#define CONVERT_TOL    20
+
+typedef struct {
+    const char *name;
+    double ppm;          // follower clock rate against the reference
+    double seconds;
+    int reboot_at;       // sync at which the reference timeline jumps, or -1
+    int garble_at;       // sync whose timestamp is corrupted, or -1
+    int lock;            // 1 if the model must lock, 0 if it must not
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"steady 12.3 ppm", 12.3, 300, -1, -1, 1},
+    {"steady -12.3 ppm", -12.3, 300, -1, -1, 1},
+    {"reboot at sync 1", 12.3, 60, 1, -1, 1},
+    {"garbled sync 1", 12.3, 60, -1, 1, 1},
+    {"90 ppm", 90, 60, -1, -1, 1},
+    {"150 ppm", 150, 10, -1, -1, 0},
+};
+
+static TickType_t sim_ticks;
+static unsigned long failures;
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+/* ---- FreeRTOS and driver stubs, the reference engine is not run ---- */
+
+TickType_t xTaskGetTickCount(void) { return sim_ticks; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return NULL; }
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint16_t stack,
+                       void *arg, UBaseType_t priority, TaskHandle_t *task) {
+    (void)fn; (void)name; (void)stack; (void)arg; (void)priority; (void)task;
+    return 0;
+}
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    (void)clear; (void)wait;
+    return 0;
+}
+void vTaskDelayUntil(TickType_t *last, TickType_t increment) {
+    (void)last; (void)increment;
+}
+uint32_t dwt_readsystimestamphi32(void) { return 0; }
+int dwt_writetxdata(uint16_t len, uint8_t *data, uint16_t offset) {
+    (void)len; (void)data; (void)offset;
+    return 0;
+}
+void dwt_writetxfctrl(uint16_t len, uint16_t offset, int ranging) {
+    (void)len; (void)offset; (void)ranging;
+}
+void dwt_setdelayedtrxtime(uint32_t starttime) { (void)starttime; }
+int dwt_starttx(uint8_t mode) { (void)mode; return DWT_ERROR; }
+void dwt_forcetrxoff(void) {}
+void dwt_isr(void) {}
+void dwt_settxantennadelay(uint16_t dly) { (void)dly; }
+void dwt_setcallbacks(dwt_cb_t tx, dwt_cb_t rx, dwt_cb_t to, dwt_cb_t err) {
+    (void)tx; (void)rx; (void)to; (void)err;
+}
+void dwt_setinterrupt(uint32_t mask, uint8_t op) { (void)mask; (void)op; }
+int decaselectdevice(unsigned int index) { (void)index; return 0; }
+int decadeviceindex(void) { return 0; }
+void deca_irq_init(TaskHandle_t task) { (void)task; }
+int deca_irq_active(void) { return 0; }
+int uwb_tempcomp_apply(void) { return 0; }
+
+/* ---- simulation ---- */
+
+static uint64_t rand64(void) {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double gauss(void) {
+    double u = ((rand64() >> 11) + 0.5) / 9007199254740992.0;
+    double v = ((rand64() >> 11) + 0.5) / 9007199254740992.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static uwb_ts_t ts_wrap(double dtu) {
+    return (uwb_ts_t)llround(fmod(dtu, 1099511627776.0));
+}
+
+static int send_sync(uint16_t ref, uwb_ts_t tx_ts, uwb_ts_t rx_stamp) {
+    uwb_frame_t f;
+
+    memset(&f, 0, sizeof(f));
+    f.length = UWB_CLKSYNC_FRAME_LEN;
+    f.data[0] = 0x41;
+    f.data[1] = 0x88;
+    f.data[5] = 0xFF;
+    f.data[6] = 0xFF;
+    f.data[7] = (uint8_t)ref;
+    f.data[8] = (uint8_t)(ref >> 8);
+    f.data[9] = UWB_CLKSYNC_FUNC;
+    uwb_ts_to_bytes(tx_ts, &f.data[10]);
+    uwb_ts_to_bytes(rx_stamp, f.rx_stamp);
+    return uwb_clksync_rx(&f);
+}
+
+static void run(const scenario_t *sc, uint16_t ref) {
+    // both clocks start anywhere in their 40-bit range; ref(t) = ref0 + t
+    double ref0 = (double)(rand64() >> 24);
+    double local0 = (double)(rand64() >> 24);
+    double rate = 1 + sc->ppm * 1e-6;
+    int32_t want_ppb = (int32_t)lround((1 / rate - 1) * 1e9);
+    TickType_t start = sim_ticks;
+    int syncs = (int)(sc->seconds * 1000 / SYNC_MS);
+    int64_t worst_conv = 0;
+    double sum_sq = 0;
+    long convs = 0;
+    int32_t worst_drift = 0;
+    int32_t peak_drift = 0;
+    int32_t final_drift = 0;
+    uwb_clksync_state_t st0;
+    uwb_clksync_state_t st;
+    uint32_t resets;
+    int ok;
+
+    uwb_clksync_follow(ref, TOF_DTU);
+    uwb_clksync_get_state(ref, &st0);
+    for (int k = 0; k < syncs; k++) {
+        double t = k * SYNC_MS / 1000.0;
+        double tx_dtu, t_rx, rx_dtu;
+        uwb_ts_t tx_ts, local, out;
+
+        if (k == sc->reboot_at) {
+            ref0 = (double)(rand64() >> 24);
+        }
+        // the frame carries the exact time it left at, in reference dtu
+        tx_dtu = floor(ref0 + t * DTU_PER_S);
+        t_rx = (tx_dtu - ref0 + TOF_DTU) / DTU_PER_S;
+        rx_dtu = local0 + t_rx * DTU_PER_S * rate + NOISE_DTU * gauss();
+        tx_ts = ts_wrap(tx_dtu);
+        if (k == sc->garble_at) {
+            tx_ts ^= 0xA5ULL << 24;
+        }
+        sim_ticks = start + (TickType_t)(k * SYNC_MS);
+        send_sync(ref, tx_ts, ts_wrap(rx_dtu));
+
+        uwb_clksync_get_state(ref, &st);
+        if (abs(st.drift_ppb) > peak_drift) {
+            peak_drift = abs(st.drift_ppb);
+        }
+        if (!st.locked || t < SETTLE_S) {
+            continue;
+        }
+        final_drift = st.drift_ppb - want_ppb;
+        if (abs(final_drift) > worst_drift) {
+            worst_drift = abs(final_drift);
+        }
+
+        t += CONVERT_MS / 1000.0;
+        sim_ticks = start + (TickType_t)(k * SYNC_MS + CONVERT_MS);
+        local = ts_wrap(local0 + t * DTU_PER_S * rate);
+        if (uwb_clksync_convert(ref, local, &out) == 0) {
+            int64_t e = uwb_ts_diff(out, ts_wrap(ref0 + t * DTU_PER_S));
+
+            sum_sq += (double)e * e;
+            convs++;
+            if (llabs(e) > worst_conv) {
+                worst_conv = llabs(e);
+            }
+        }
+    }
+    sim_ticks = start + (TickType_t)(syncs * SYNC_MS) + UWB_CLKSYNC_GAP_MS;
+
+    uwb_clksync_get_state(ref, &st);
+    // a model left by an earlier scenario restarts once at the first sync
+    resets = st.resets - st0.resets - (st0.updates != 0);
+    printf("%s: locked %d, resets %lu, outliers %lu, peak drift %ld ppb\n",
+           sc->name, st.locked, (unsigned long)resets,
+           (unsigned long)(st.outliers - st0.outliers), (long)peak_drift);
+    if (sc->lock) {
+        printf("  drift error worst %ld ppb, final %ld ppb; conversion error "
+               "worst %lld dtu, rms %.1f dtu over %ld\n",
+               (long)worst_drift, (long)final_drift, (long long)worst_conv,
+               convs ? sqrt(sum_sq / convs) : 0.0, convs);
+        ok = st.locked && convs > 0 && worst_drift <= DRIFT_TOL_PPB &&
+             worst_conv <= CONVERT_TOL;
+    } else {
+        // each pair is refused, the drift never reaches the clamp
+        ok = !st.locked && peak_drift == 0;
+    }
+    if (!ok) {
+        printf("  FAILED\n");
+        failures++;
+    }
+}
+
+int main(void) {
+    int n = sizeof(scenarios) / sizeof(scenarios[0]);
+
+    for (int i = 0; i < n; i++) {
+        // the follower tracks UWB_CLKSYNC_REF_MAX references at most, so
+        // scenarios reuse them; each starts after the last one timed out
+        run(&scenarios[i], (uint16_t)(0x100 + i % UWB_CLKSYNC_REF_MAX));
+    }
+    printf("%lu failed\n", failures);
+    return failures != 0;
+}
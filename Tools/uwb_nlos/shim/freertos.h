@@ -0,0 +1,8 @@
+/* Host stand-in for FreeRTOS: single threaded, critical sections are no-ops. */
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+#endif /* FREERTOS_H */
@@ -0,0 +1,16 @@
+/* Host stand-in for the GD32F4xx device header: just what uwb_nlos.c uses. */
+#ifndef GD32F4XX_H
+#define GD32F4XX_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t CYCCNT;
+} host_dwt_t;
+
+extern host_dwt_t host_dwt;
+#define DWT (&host_dwt)
+
+#define __CLZ(x) ((uint32_t)__builtin_clz(x))
+
+#endif /* GD32F4XX_H */
@@ -0,0 +1 @@
+#include "freertos.h"
@@ -0,0 +1,200 @@
+/* Host checks and timings for Application/uwb/uwb_nlos.c.
+ *
+ *   cc -O2 -Ishim -I../../Application/uwb -I../../HAL/DW1000/decadriver \
+ *      -o uwb_nlos_bench uwb_nlos_bench.c ../../Application/uwb/uwb_nlos.c -lm
+ *   ./uwb_nlos_bench         (checks, then ns per call)
+ *   ./uwb_nlos_bench -n      (checks only)
+ *
+ * Compares uwb_nlos_db100() with 1000 log10(x) over every x below 2^20 and
+ * random x up to 2^64, and uwb_nlos_estimate() with the same formulas in
+ * double precision over random diagnostics. The timings are host figures;
+ * on the target uwb_nlos_get_stats() reports the longest call in cycles.
+ * Exits with 1 if any check failed.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gd32f4xx.h"
+#include "uwb_nlos.h"
+
+#define RANDOM_RUNS 2000000
+#define TIMED_CALLS 20000000
+
+#define DB100_TOL    1    // 0.01 dB, as documented in uwb_nlos.h
+#define POWER_TOL    4    // 0.01 dB: three db100() terms plus rounding
+#define LIKELY_TOL   1    // percent, truncated like the firmware
+
+host_dwt_t host_dwt;
+
+static unsigned long failures;
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rand64(void) {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int32_t db100_err(uint64_t x) {
+    int32_t want = (int32_t)lround(1000.0 * log10((double)x));
+
+    return abs(uwb_nlos_db100(x) - want);
+}
+
+static void check_db100(void) {
+    int32_t worst = 0;
+    uint64_t worst_x = 0;
+
+    for (uint64_t x = 1; x < (1U << 20); x++) {
+        int32_t e = db100_err(x);
+
+        if (e > worst) {
+            worst = e;
+            worst_x = x;
+        }
+    }
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        // spread over every magnitude, not just the top bits
+        uint64_t x = rand64() >> (rand64() % 64);
+        int32_t e;
+
+        if (x == 0) {
+            continue;
+        }
+        e = db100_err(x);
+        if (e > worst) {
+            worst = e;
+            worst_x = x;
+        }
+    }
+    printf("db100: worst error %d (0.01 dB) at %llu\n", worst,
+           (unsigned long long)worst_x);
+    if (worst > DB100_TOL) {
+        failures++;
+    }
+}
+
+static void random_diag(dwt_rxdiag_t *d) {
+    memset(d, 0, sizeof(*d));
+    d->firstPathAmp1 = (uint16_t)(rand64() % 30000);
+    d->firstPathAmp2 = (uint16_t)(rand64() % 30000);
+    d->firstPathAmp3 = (uint16_t)(rand64() % 30000);
+    d->maxGrowthCIR = (uint16_t)(rand64() % 65536);
+    d->rxPreamCount = (uint16_t)(16 + rand64() % 4081);
+}
+
+static void check_estimate(void) {
+    int32_t worst_power = 0;
+    int32_t worst_likely = 0;
+    unsigned long unknown = 0;
+
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        dwt_rxdiag_t d;
+        uwb_nlos_t out;
+        uint8_t prf = (i & 1) ? DWT_PRF_64M : DWT_PRF_16M;
+        double a = (prf == DWT_PRF_16M) ? 11377 : 12174;
+        double f, n, fp_db, rx_db, gap, likely;
+
+        random_diag(&d);
+        uwb_nlos_estimate(&d, prf, &out);
+
+        f = (double)d.firstPathAmp1 * d.firstPathAmp1 +
+            (double)d.firstPathAmp2 * d.firstPathAmp2 +
+            (double)d.firstPathAmp3 * d.firstPathAmp3;
+        n = d.rxPreamCount;
+        if (f == 0 || d.maxGrowthCIR == 0) {
+            if (out.likelihood != UWB_NLOS_UNKNOWN) {
+                failures++;
+            }
+            unknown++;
+            continue;
+        }
+        fp_db = 1000.0 * log10(f / (n * n)) - a;
+        rx_db = 1000.0 * log10(d.maxGrowthCIR * 131072.0 / (n * n)) - a;
+        gap = rx_db - fp_db;
+        if (gap <= UWB_NLOS_LOS_DB100) {
+            likely = 0;
+        } else if (gap >= UWB_NLOS_NLOS_DB100) {
+            likely = 100;
+        } else {
+            likely = floor((gap - UWB_NLOS_LOS_DB100) * 100 /
+                           (UWB_NLOS_NLOS_DB100 - UWB_NLOS_LOS_DB100));
+        }
+
+        if (fabs(out.fp_power - fp_db) > worst_power) {
+            worst_power = (int32_t)ceil(fabs(out.fp_power - fp_db));
+        }
+        if (fabs(out.rx_power - rx_db) > worst_power) {
+            worst_power = (int32_t)ceil(fabs(out.rx_power - rx_db));
+        }
+        if (fabs(out.likelihood - likely) > worst_likely) {
+            worst_likely = (int32_t)ceil(fabs(out.likelihood - likely));
+        }
+    }
+    printf("estimate: worst power error %d (0.01 dB), likelihood %d %%, "
+           "%lu without diagnostics\n",
+           worst_power, worst_likely, unknown);
+    if (worst_power > POWER_TOL || worst_likely > LIKELY_TOL) {
+        failures++;
+    }
+}
+
+static void timings(void) {
+    static dwt_rxdiag_t diags[1024];
+    static uint64_t xs[1024];
+    volatile int32_t result;
+    int32_t sink = 0;
+    uwb_nlos_t out;
+    double t;
+
+    for (int i = 0; i < 1024; i++) {
+        random_diag(&diags[i]);
+        diags[i].firstPathAmp1 |= 1;    // keep every call on the full path
+        diags[i].maxGrowthCIR |= 1;
+        xs[i] = (rand64() >> (rand64() % 64)) | 1;
+    }
+
+    t = now();
+    for (uint32_t i = 0; i < TIMED_CALLS; i++) {
+        sink += uwb_nlos_db100(xs[i & 1023]);
+    }
+    t = now() - t;
+    printf("uwb_nlos_db100: %.2f ns per call\n", t * 1e9 / TIMED_CALLS);
+
+    t = now();
+    for (uint32_t i = 0; i < TIMED_CALLS; i++) {
+        uwb_nlos_estimate(&diags[i & 1023], (i & 1) ? DWT_PRF_64M : DWT_PRF_16M,
+                          &out);
+        sink += out.likelihood;
+    }
+    t = now() - t;
+    printf("uwb_nlos_estimate: %.2f ns per call\n", t * 1e9 / TIMED_CALLS);
+
+    result = sink;
+    (void)result;
+}
+
+int main(int argc, char **argv) {
+    check_db100();
+    check_estimate();
+    printf("%lu failed\n", failures);
+    if (failures != 0) {
+        return 1;
+    }
+    if (argc < 2 || strcmp(argv[1], "-n") != 0) {
+        timings();
+    }
+    return 0;
+}
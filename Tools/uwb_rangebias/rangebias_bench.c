@@ -0,0 +1,180 @@
+/* Host check and benchmark of the range bias LUT in
+ * HAL/DW1000/platform/deca_range_tables.c against the table walk it replaced.
+ *
+ *   cc -O2 -DDWT_NUM_DW_DEV=2 -I../../HAL/DW1000/decadriver \
+ *      -I../../HAL/DW1000/platform -o rangebias_bench rangebias_bench.c \
+ *      ../../HAL/DW1000/platform/deca_range_tables.c
+ *   ./rangebias_bench
+ *
+ * Sweeps channels 1/2/3/4/5/7 x 16/64 MHz PRF over -1 m .. 70 m in 1 mm
+ * steps, then times both versions. Exits with 1 on any mismatch.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_param_types.h"
+#include "deca_range_tables.h"
+
+#define SWEEP_MIN_MM  (-1000)
+#define SWEEP_MAX_MM  70000
+#define TIMED_CALLS   20000000
+
+/* the tables are defined in deca_range_tables.c */
+extern const uint8 chan_idxnb[NUM_CH_SUPPORTED];
+extern const uint8 chan_idxwb[NUM_CH_SUPPORTED];
+extern const uint8 range25cm16PRFnb[4][37];
+extern const uint8 range25cm16PRFwb[2][68];
+extern const uint8 range25cm64PRFnb[4][26];
+extern const uint8 range25cm64PRFwb[2][59];
+
+static const uint8 chans[] = {1, 2, 3, 4, 5, 7};
+static const uint8 prfs[] = {DWT_PRF_16M, DWT_PRF_64M};
+
+/* the device deca_range_tables.c sees as selected */
+static int device;
+
+int decadeviceindex(void) { return device; }
+
+/* dwt_getrangebias() before the LUT, returning cm instead of metres */
+static int walk_rangebias(uint8 chan, float range, uint8 prf) {
+    int i = 0;
+    int rangeint25cm = (int)(range * 4.00);
+
+    if (rangeint25cm > 255) rangeint25cm = 255;
+
+    if (prf == DWT_PRF_16M) {
+        if (chan == 4 || chan == 7) {
+            while (rangeint25cm > range25cm16PRFwb[chan_idxwb[chan]][i]) i++;
+            return i - 28;
+        }
+        while (rangeint25cm > range25cm16PRFnb[chan_idxnb[chan]][i]) i++;
+        return i - 23;
+    }
+    if (chan == 4 || chan == 7) {
+        while (rangeint25cm > range25cm64PRFwb[chan_idxwb[chan]][i]) i++;
+        return i - 30;
+    }
+    while (rangeint25cm > range25cm64PRFnb[chan_idxnb[chan]][i]) i++;
+    return i - 17;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long sweep(void) {
+    unsigned long bad = 0;
+
+    for (unsigned c = 0; c < sizeof(chans); c++) {
+        for (unsigned p = 0; p < sizeof(prfs); p++) {
+            int lo = 127;
+            int hi = -128;
+
+            for (int32 mm = SWEEP_MIN_MM; mm <= SWEEP_MAX_MM; mm++) {
+                int want = walk_rangebias(chans[c], mm / 1000.0f, prfs[p]);
+                int got = dwt_getrangebiascm(chans[c], mm, prfs[p]);
+                int got_m = (int)(dwt_getrangebias(chans[c], mm / 1000.0f,
+                                                   prfs[p]) * 100.0 +
+                                  (want < 0 ? -0.5 : 0.5));
+
+                if (got != want || got_m != want) {
+                    if (bad++ < 20) {
+                        printf("ch %u prf %u %d mm: walk %d cm, lut %d / %d\n",
+                               chans[c], prfs[p], (int)mm, want, got, got_m);
+                    }
+                }
+                lo = (want < lo) ? want : lo;
+                hi = (want > hi) ? want : hi;
+            }
+            printf("ch %u prf %2u: %d .. %d cm\n", chans[c],
+                   prfs[p] == DWT_PRF_16M ? 16 : 64, lo, hi);
+        }
+    }
+    return bad;
+}
+
+static void timings(void) {
+    static int32 ranges[1024];
+    static float ranges_m[1024];
+    volatile int result;
+    int sink = 0;
+    double t;
+
+    // ranges spread evenly over the sweep, so the walk sees every depth
+    for (int i = 0; i < 1024; i++) {
+        ranges[i] = SWEEP_MIN_MM +
+                    (int32)((long)(SWEEP_MAX_MM - SWEEP_MIN_MM) * i / 1024);
+        ranges_m[i] = ranges[i] / 1000.0f;
+    }
+
+    printf("%d calls each, ranges -1 m .. 70 m, ns per call:\n", TIMED_CALLS);
+    printf("%-6s %-4s %10s %10s %10s\n", "chan", "prf", "walk", "lut cm",
+           "lut m");
+    for (unsigned c = 0; c < sizeof(chans); c++) {
+        for (unsigned p = 0; p < sizeof(prfs); p++) {
+            double walk, lut, lut_m;
+
+            t = now();
+            for (uint32 i = 0; i < TIMED_CALLS; i++) {
+                sink += walk_rangebias(chans[c], ranges_m[i & 1023], prfs[p]);
+            }
+            walk = now() - t;
+
+            t = now();
+            for (uint32 i = 0; i < TIMED_CALLS; i++) {
+                sink += dwt_getrangebiascm(chans[c], ranges[i & 1023], prfs[p]);
+            }
+            lut = now() - t;
+
+            t = now();
+            for (uint32 i = 0; i < TIMED_CALLS; i++) {
+                sink += (int)(dwt_getrangebias(chans[c], ranges_m[i & 1023],
+                                               prfs[p]) * 100.0);
+            }
+            lut_m = now() - t;
+
+            printf("%-6u %-4u %10.2f %10.2f %10.2f\n", chans[c],
+                   prfs[p] == DWT_PRF_16M ? 16 : 64, walk * 1e9 / TIMED_CALLS,
+                   lut * 1e9 / TIMED_CALLS, lut_m * 1e9 / TIMED_CALLS);
+        }
+    }
+
+    // two devices on different channels used in turn: with one shared LUT
+    // every call rebuilt it
+    t = now();
+    for (uint32 i = 0; i < TIMED_CALLS; i++) {
+        device = i & 1;
+        sink += dwt_getrangebiascm(device ? 5 : 2, ranges[i & 1023],
+                                   DWT_PRF_64M);
+    }
+    t = now() - t;
+    device = 0;
+    printf("two devices, ch 2 and 5 in turn: %.2f ns per call\n",
+           t * 1e9 / TIMED_CALLS);
+
+    // a rebuild, as after a channel change
+    t = now();
+    for (uint32 i = 0; i < TIMED_CALLS / 256; i++) {
+        sink += dwt_getrangebiascm((i & 1) ? 5 : 2, 1000, DWT_PRF_64M);
+    }
+    t = now() - t;
+    printf("LUT rebuild: %.0f ns\n", t * 1e9 / (TIMED_CALLS / 256));
+
+    result = sink;
+    (void)result;
+}
+
+int main(void) {
+    unsigned long bad = sweep();
+
+    printf("%lu mismatches\n", bad);
+    if (bad != 0) {
+        return 1;
+    }
+    timings();
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "uwb_tlm.h"
+
+#include <string.h>
+
+static uint32_t crc_table[256];
+static int crc_table_ready;
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i << 24;
+        for (int b = 0; b < 8; b++) {
+            c = (c & 0x80000000U) ? (c << 1) ^ 0x04C11DB7U : (c << 1);
+        }
+        crc_table[i] = c;
+    }
+    crc_table_ready = 1;
+}
+
+uint32_t uwb_tlm_crc(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFU;
+
+    if (!crc_table_ready) {
+        crc_table_init();
+    }
+    for (size_t i = 0; i < len; i += 4) {
+        /* the unit takes little endian words, most significant byte first */
+        for (int b = 3; b >= 0; b--) {
+            uint8_t byte = (i + b < len) ? data[i + b] : 0;
+            crc = (crc << 8) ^ crc_table[(crc >> 24) ^ byte];
+        }
+    }
+    return crc;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static size_t record_len(const uint8_t *hdr) {
+    size_t len = get16(&hdr[4]);
+
+    return UWB_TLM_HEADER_LEN + ((len + 3) & ~(size_t)3) + UWB_TLM_CRC_LEN;
+}
+
+void uwb_tlm_init(uwb_tlm_parser_t *p) { memset(p, 0, sizeof(*p)); }
+
+/* Try to take one record from the start of the buffer. Returns the number of
+ * bytes consumed, 0 if more data is needed. */
+static size_t parse_one(uwb_tlm_parser_t *p, uwb_tlm_cb_t cb, void *arg) {
+    const uint8_t *b = p->buf;
+    size_t total;
+    uint32_t crc;
+    uwb_tlm_record_t rec;
+
+    if (p->fill < 2) {
+        return 0;
+    }
+    if (b[0] != UWB_TLM_SYNC0 || b[1] != UWB_TLM_SYNC1) {
+        p->skipped++;
+        return 1;
+    }
+    if (p->fill < UWB_TLM_HEADER_LEN) {
+        return 0;
+    }
+    if (get16(&b[4]) > UWB_TLM_PAYLOAD_MAX) {
+        p->skipped++;
+        return 1;
+    }
+    total = record_len(b);
+    if (p->fill < total) {
+        return 0;
+    }
+
+    crc = (uint32_t)b[total - 4] | ((uint32_t)b[total - 3] << 8) |
+          ((uint32_t)b[total - 2] << 16) | ((uint32_t)b[total - 1] << 24);
+    if (uwb_tlm_crc(b, total - UWB_TLM_CRC_LEN) != crc) {
+        /* false sync or corrupted record, resync one byte further */
+        p->crc_errors++;
+        p->skipped++;
+        return 1;
+    }
+
+    rec.type = b[2];
+    rec.seq = b[3];
+    rec.length = get16(&b[4]);
+    rec.rx_stamp = 0;
+    for (int i = 4; i >= 0; i--) {
+        rec.rx_stamp = (rec.rx_stamp << 8) | b[6 + i];
+    }
+    rec.nlos = b[11];
+    rec.fp_index = get16(&b[12]);
+    rec.fp_amp1 = get16(&b[14]);
+    rec.fp_amp2 = get16(&b[16]);
+    rec.fp_amp3 = get16(&b[18]);
+    rec.std_noise = get16(&b[20]);
+    rec.cir_power = get16(&b[22]);
+    rec.rx_pacc = get16(&b[24]);
+    rec.max_noise = get16(&b[26]);
+    rec.payload = &b[UWB_TLM_HEADER_LEN];
+
+    if (p->have_seq) {
+        p->seq_gaps += (uint8_t)(rec.seq - p->last_seq - 1);
+    }
+    p->have_seq = 1;
+    p->last_seq = rec.seq;
+    p->records++;
+
+    if (cb != NULL) {
+        cb(&rec, arg);
+    }
+    return total;
+}
+
+void uwb_tlm_feed(uwb_tlm_parser_t *p, const uint8_t *data, size_t len,
+                  uwb_tlm_cb_t cb, void *arg) {
+    while (len > 0) {
+        size_t n = sizeof(p->buf) - p->fill;
+        size_t used;
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&p->buf[p->fill], data, n);
+        p->fill += n;
+        data += n;
+        len -= n;
+
+        while ((used = parse_one(p, cb, arg)) > 0) {
+            memmove(p->buf, &p->buf[used], p->fill - used);
+            p->fill -= used;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/* Host side decoder for the receiver's binary telemetry stream.
+ * The record layout is documented in Application/uwb/uwb_telemetry.h. */
+#ifndef UWB_TLM_H
+#define UWB_TLM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UWB_TLM_SYNC0         0xA5
+#define UWB_TLM_SYNC1         0x5A
+#define UWB_TLM_HEADER_LEN    28
+#define UWB_TLM_CRC_LEN       4
+#define UWB_TLM_PAYLOAD_MAX   1023
+#define UWB_TLM_RECORD_MAX    (UWB_TLM_HEADER_LEN + UWB_TLM_PAYLOAD_MAX + 3 + UWB_TLM_CRC_LEN)
+#define UWB_TLM_NLOS_UNKNOWN  0xFF    /* nlos of a frame without diagnostics */
+#define UWB_TLM_TYPE_RX_FRAME 0x01
+#define UWB_TLM_TYPE_LOG      0x02    /* payload is text, rx_stamp is the core cycle count */
+#define UWB_TLM_TYPE_CIR      0x03    /* payload is a CIR window, header as the frame's */
+#define UWB_TLM_CIR_HEADER_LEN 8      /* cir_seq u32, first_tap u16, taps u16, then taps x (re, im) int16 */
+#define UWB_TLM_TYPE_TDOA     0x04    /* payload is a batch of tag blinks, header fields zero */
+#define UWB_TLM_TDOA_HEADER_LEN 8     /* batch_seq u16, count u8, rec_len u8, timebase u16, reserved u16 */
+#define UWB_TLM_TDOA_REC_LEN  16      /* tag_id u64, rx_stamp 40 bits, seq u8, nlos u8, rx_level u8 */
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t length;
+    uint64_t rx_stamp;    /* 40 bits */
+    uint8_t nlos;         /* NLOS likelihood 0..100 %, UWB_TLM_NLOS_UNKNOWN if unknown */
+    uint16_t fp_index;
+    uint16_t fp_amp1;
+    uint16_t fp_amp2;
+    uint16_t fp_amp3;
+    uint16_t std_noise;
+    uint16_t cir_power;
+    uint16_t rx_pacc;
+    uint16_t max_noise;
+    const uint8_t *payload;    /* valid during the callback only */
+} uwb_tlm_record_t;
+
+typedef void (*uwb_tlm_cb_t)(const uwb_tlm_record_t *rec, void *arg);
+
+typedef struct {
+    uint8_t buf[UWB_TLM_RECORD_MAX];
+    size_t fill;
+    uint64_t records;
+    uint64_t crc_errors;
+    uint64_t skipped;     /* bytes discarded while searching for sync */
+    uint64_t seq_gaps;    /* records missing according to seq */
+    int have_seq;
+    uint8_t last_seq;
+} uwb_tlm_parser_t;
+
+void uwb_tlm_init(uwb_tlm_parser_t *p);
+
+/* Feed any number of bytes. cb is called once per record with a valid CRC. */
+void uwb_tlm_feed(uwb_tlm_parser_t *p, const uint8_t *data, size_t len,
+                  uwb_tlm_cb_t cb, void *arg);
+
+/* CRC as computed by the GD32 CRC unit over len bytes (zero padded words). */
+uint32_t uwb_tlm_crc(const uint8_t *data, size_t len);
+
+#endif /* UWB_TLM_H */
@@ -0,0 +1,188 @@
+/* Decode a telemetry capture (file or serial device) and report rates.
+ *
+ *   cc -O2 -o uwb_tlm_dump uwb_tlm_dump.c uwb_tlm.c
+ *   ./uwb_tlm_dump /dev/ttyUSB0        (port set up with stty beforehand)
+ *   ./uwb_tlm_dump -q capture.bin      (summary only)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "uwb_tlm.h"
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+/* NLOS likelihood of an RX frame or CIR record, "?" without diagnostics */
+static const char *nlos_text(const uwb_tlm_record_t *rec, char buf[8]) {
+    if (rec->nlos == UWB_TLM_NLOS_UNKNOWN) {
+        return "?";
+    }
+    snprintf(buf, 8, "%u%%", rec->nlos);
+    return buf;
+}
+
+/* cir_seq, window and the strongest tap (squared magnitude) */
+static void print_cir(const uwb_tlm_record_t *rec) {
+    const uint8_t *p = rec->payload;
+    uint16_t first, taps;
+    uint32_t peak = 0;
+    unsigned peak_tap = 0;
+    char nlos[8];
+
+    if (rec->length < UWB_TLM_CIR_HEADER_LEN) {
+        printf("seq %3u cir  short payload %u\n", rec->seq, rec->length);
+        return;
+    }
+    first = get16(p + 4);
+    taps = get16(p + 6);
+    if (rec->length != UWB_TLM_CIR_HEADER_LEN + 4u * taps) {
+        printf("seq %3u cir  %u taps in a %u byte payload\n", rec->seq, taps,
+               rec->length);
+        return;
+    }
+    for (unsigned i = 0; i < taps; i++) {
+        const uint8_t *s = p + UWB_TLM_CIR_HEADER_LEN + 4 * i;
+        int32_t re = (int16_t)get16(s);
+        int32_t im = (int16_t)get16(s + 2);
+        uint32_t mag = (uint32_t)(re * re) + (uint32_t)(im * im);
+
+        if (mag > peak) {
+            peak = mag;
+            peak_tap = first + i;
+        }
+    }
+    printf("seq %3u cir  %10u ts %010llx fp %u.%02u nlos %s taps %u..%u "
+           "peak %u at %u\n",
+           rec->seq, get32(p), (unsigned long long)rec->rx_stamp,
+           rec->fp_index >> 6, (rec->fp_index & 0x3F) * 100 / 64,
+           nlos_text(rec, nlos), first, first + taps - 1, peak, peak_tap);
+}
+
+/* batch header, then one line per blink */
+static void print_tdoa(const uwb_tlm_record_t *rec) {
+    const uint8_t *p = rec->payload;
+    unsigned count, rec_len;
+    uint16_t timebase;
+
+    if (rec->length < UWB_TLM_TDOA_HEADER_LEN) {
+        printf("seq %3u tdoa short payload %u\n", rec->seq, rec->length);
+        return;
+    }
+    count = p[2];
+    rec_len = p[3];
+    timebase = get16(p + 4);
+    if (rec_len < UWB_TLM_TDOA_REC_LEN ||
+        rec->length != UWB_TLM_TDOA_HEADER_LEN + count * rec_len) {
+        printf("seq %3u tdoa %u records of %u bytes in a %u byte payload\n",
+               rec->seq, count, rec_len, rec->length);
+        return;
+    }
+    if (timebase == 0xFFFF) {
+        printf("seq %3u tdoa batch %5u, %u blinks, own clock\n", rec->seq,
+               get16(p), count);
+    } else {
+        printf("seq %3u tdoa batch %5u, %u blinks, timebase %04x\n", rec->seq,
+               get16(p), count, timebase);
+    }
+    // records longer than 16 bytes carry fields this decoder does not know
+    for (unsigned i = 0; i < count; i++) {
+        const uint8_t *b = p + UWB_TLM_TDOA_HEADER_LEN + i * rec_len;
+        uint64_t tag = (uint64_t)get32(b) | ((uint64_t)get32(b + 4) << 32);
+        uint64_t stamp = (uint64_t)get32(b + 8) | ((uint64_t)b[12] << 32);
+
+        printf("    tag %016llx ts %010llx seq %3u", (unsigned long long)tag,
+               (unsigned long long)stamp, b[13]);
+        if (b[14] != 0xFF) {
+            printf(" nlos %3u%%", b[14]);
+        }
+        if (b[15] != 0) {
+            printf(" rx -%u dBm", b[15]);
+        }
+        printf("\n");
+    }
+}
+
+static void print_record(const uwb_tlm_record_t *rec, void *arg) {
+    char nlos[8];
+
+    (void)arg;
+    if (rec->type == UWB_TLM_TYPE_LOG) {
+        printf("seq %3u log  cyc %10llu %.*s\n", rec->seq,
+               (unsigned long long)rec->rx_stamp, (int)rec->length,
+               (const char *)rec->payload);
+        return;
+    }
+    if (rec->type == UWB_TLM_TYPE_CIR) {
+        print_cir(rec);
+        return;
+    }
+    if (rec->type == UWB_TLM_TYPE_TDOA) {
+        print_tdoa(rec);
+        return;
+    }
+    printf("seq %3u type %u len %4u ts %010llx fp %u.%02u pacc %u nlos %s\n",
+           rec->seq, rec->type, rec->length,
+           (unsigned long long)rec->rx_stamp, rec->fp_index >> 6,
+           (rec->fp_index & 0x3F) * 100 / 64, rec->rx_pacc,
+           nlos_text(rec, nlos));
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    static uwb_tlm_parser_t parser;
+    static uint8_t buf[65536];
+    int quiet = 0;
+    const char *path;
+    FILE *f;
+    size_t n;
+    size_t bytes = 0;
+    double start, parse = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-q") == 0) {
+        quiet = 1;
+        argc--;
+        argv++;
+    }
+    path = (argc > 1) ? argv[1] : NULL;
+    f = path ? fopen(path, "rb") : stdin;
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    uwb_tlm_init(&parser);
+    start = now();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        double t = now();
+
+        uwb_tlm_feed(&parser, buf, n, quiet ? NULL : print_record, NULL);
+        parse += now() - t;
+        bytes += n;
+    }
+
+    fprintf(stderr,
+            "%llu records, %llu crc errors, %llu bytes skipped, %llu lost\n",
+            (unsigned long long)parser.records,
+            (unsigned long long)parser.crc_errors,
+            (unsigned long long)parser.skipped,
+            (unsigned long long)parser.seq_gaps);
+    fprintf(stderr, "%.1f records/s over %.2f s, parse %.1f MB/s\n",
+            parser.records / (now() - start), now() - start,
+            parse > 0 ? bytes / parse / 1e6 : 0.0);
+    if (path) {
+        fclose(f);
+    }
+    return 0;
+}
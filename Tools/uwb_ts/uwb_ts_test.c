@@ -0,0 +1,264 @@
+/* Host checks and timings for Application/uwb/uwb_timestamp.h.
+ *
+ *   cc -O2 -I../../Application/uwb -o uwb_ts_test uwb_ts_test.c
+ *   ./uwb_ts_test            (checks, then ns per call of each helper)
+ *   ./uwb_ts_test -n         (checks only)
+ *
+ * Exits with 1 if any check failed.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uwb_timestamp.h"
+
+#define RANDOM_RUNS 1000000
+#define TIMED_CALLS 20000000
+
+/* exact device time unit: 1 / (128 * 499.2 MHz) */
+#define PS_PER_DTU  (1e12L / (128.0L * 499.2e6L))
+#define MM_PER_DTU  (299702547.0L * 1e3L * PS_PER_DTU * 1e-12L)
+
+static unsigned long failures;
+static unsigned long checks;
+
+#define CHECK(cond, ...)                                                       \
+    do {                                                                       \
+        checks++;                                                              \
+        if (!(cond)) {                                                         \
+            if (failures++ < 20) {                                             \
+                printf("FAIL %s:%d: ", __func__, __LINE__);                    \
+                printf(__VA_ARGS__);                                           \
+                printf("\n");                                                  \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* signed value of up to bits bits, both signs */
+static int64_t rng_signed(int bits) {
+    return (int64_t)(rng() << (64 - bits)) >> (64 - bits);
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void test_pack(void) {
+    static const uint8_t bytes[UWB_TS_LEN] = {0x01, 0x23, 0x45, 0x67, 0x89};
+    uint8_t out[UWB_TS_LEN + 1];
+    uwb_ts_t ts;
+
+    ts = uwb_ts_from_bytes(bytes);
+    CHECK(ts == 0x8967452301ULL, "from_bytes %010llx",
+          (unsigned long long)ts);
+
+    // bits above the 40th never reach the bytes, the byte after is untouched
+    memset(out, 0xEE, sizeof(out));
+    uwb_ts_to_bytes(0xFF8967452301ULL, out);
+    CHECK(memcmp(out, bytes, UWB_TS_LEN) == 0 && out[UWB_TS_LEN] == 0xEE,
+          "to_bytes %02x %02x %02x %02x %02x %02x", out[0], out[1], out[2],
+          out[3], out[4], out[5]);
+
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        ts = rng() & UWB_TS_MASK;
+        uwb_ts_to_bytes(ts, out);
+        CHECK(uwb_ts_from_bytes(out) == ts, "round trip %010llx",
+              (unsigned long long)ts);
+        CHECK(uwb_ts_from_hi32(uwb_ts_dly_reg(ts)) == (ts & ~(uwb_ts_t)0xFF),
+              "hi32 %010llx", (unsigned long long)ts);
+        CHECK(uwb_ts_lo32(ts) == (uint32_t)(ts & 0xFFFFFFFFU), "lo32");
+    }
+}
+
+static void test_diff(void) {
+    const int64_t half = (int64_t)1 << (UWB_TS_BITS - 1);
+    uwb_ts_t a;
+    int64_t d;
+
+    // across the wrap, both ways
+    CHECK(uwb_ts_diff(5, UWB_TS_MASK - 4) == 10, "wrap +");
+    CHECK(uwb_ts_diff(UWB_TS_MASK - 4, 5) == -10, "wrap -");
+    CHECK(uwb_ts_add(3, -5) == UWB_TS_MASK - 1, "add below 0");
+    CHECK(uwb_ts_add(UWB_TS_MASK, 1) == 0, "add past the top");
+    // sign boundary: 2^39 - 1 ahead is positive, 2^39 is taken as behind
+    CHECK(uwb_ts_diff(half - 1, 0) == half - 1, "largest positive");
+    CHECK(uwb_ts_diff(half, 0) == -half, "half way");
+    CHECK(uwb_ts_diff(0, half) == -half, "half way back");
+    // garbage above bit 39 is ignored
+    CHECK(uwb_ts_diff(0xABCD0000000010ULL, 0x10) == 0, "high bits");
+
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        a = rng() & UWB_TS_MASK;
+        d = rng_signed(UWB_TS_BITS);
+        if (d == -half) {
+            continue;
+        }
+        CHECK(uwb_ts_diff(uwb_ts_add(a, d), a) == d, "diff %010llx %lld",
+              (unsigned long long)a, (long long)d);
+    }
+
+    CHECK(uwb_ts_diff32(5, 0xFFFFFFFBU) == 10, "diff32 wrap +");
+    CHECK(uwb_ts_diff32(0xFFFFFFFBU, 5) == -10, "diff32 wrap -");
+    CHECK(uwb_ts_diff32(0x7FFFFFFFU, 0) == 0x7FFFFFFF, "diff32 largest");
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        uint32_t b = (uint32_t)rng();
+
+        d = rng_signed(32);
+        if (d == INT32_MIN) {
+            continue;
+        }
+        CHECK(uwb_ts_diff32(b + (uint32_t)d, b) == d, "diff32 %08x %lld", b,
+              (long long)d);
+    }
+}
+
+/* The fixed point constants are rounded to the nearest 1/65536 (or finer)
+ * and the shifts floor, so a conversion of x may be off by |x| / 131072 plus
+ * one unit. */
+static int close_to(int64_t got, long double exact, int64_t x) {
+    long double err = fabsl((long double)got - exact);
+
+    return err <= fabsl((long double)x) / 131072.0L + 1.0L;
+}
+
+static void test_units(void) {
+    int64_t dtu;
+    int64_t ps;
+    int32_t mm;
+
+    CHECK(uwb_dtu_to_ps(0) == 0 && uwb_dtu_to_mm(0) == 0, "zero");
+    CHECK(uwb_dtu_to_ps(1) == 15, "1 dtu = %lld ps",
+          (long long)uwb_dtu_to_ps(1));
+    // 1 ms of device time is 63897600 dtu exactly
+    CHECK(uwb_ps_to_dtu(1000000000LL) == 63897600, "1 ms = %lld dtu",
+          (long long)uwb_ps_to_dtu(1000000000LL));
+    CHECK(uwb_uus_to_dtu(1000) == 65536000, "uus");
+    // flooring shifts round negative values down, not towards zero
+    CHECK(uwb_dtu_to_ps(-1) == -16, "-1 dtu = %lld ps",
+          (long long)uwb_dtu_to_ps(-1));
+    CHECK(uwb_dtu_to_mm(-1) == -5, "-1 dtu = %d mm", uwb_dtu_to_mm(-1));
+
+    // intervals up to ~8.6 s (the whole signed range of a diff)
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        dtu = rng_signed(UWB_TS_BITS - (int)(rng() % 32));
+        ps = uwb_dtu_to_ps(dtu);
+        CHECK(close_to(ps, dtu * PS_PER_DTU, dtu), "dtu_to_ps %lld -> %lld",
+              (long long)dtu, (long long)ps);
+        // the other way uses the exact ratio and truncates towards zero
+        CHECK(fabsl((long double)uwb_ps_to_dtu(ps) - ps / PS_PER_DTU) < 1.0L,
+              "ps_to_dtu %lld -> %lld", (long long)ps,
+              (long long)uwb_ps_to_dtu(ps));
+    }
+
+    // distances up to +-100 km, far beyond any range
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        mm = (int32_t)(rng() % 200000001) - 100000000;
+        dtu = uwb_mm_to_dtu(mm);
+        CHECK(close_to(dtu, mm / MM_PER_DTU, mm), "mm_to_dtu %d -> %lld", mm,
+              (long long)dtu);
+        CHECK(close_to(uwb_dtu_to_mm(dtu), dtu * MM_PER_DTU, dtu),
+              "dtu_to_mm %lld -> %d", (long long)dtu, uwb_dtu_to_mm(dtu));
+        // a round trip loses at most one dtu (4.7 mm) plus the rounding
+        CHECK(labs((long)(uwb_dtu_to_mm(dtu) - mm)) <= 6 + labs(mm) / 131072,
+              "mm round trip %d -> %d", mm, uwb_dtu_to_mm(dtu));
+    }
+}
+
+static void test_delayed(void) {
+    uwb_ts_t at;
+    uwb_ts_t exp;
+
+    CHECK(uwb_ts_delayed(0x12345678FFULL) == 0x1234567800ULL, "low 9 bits");
+    CHECK(uwb_ts_delayed(0x12345679FFULL) == 0x1234567800ULL, "bit 8 too");
+    CHECK(uwb_ts_delayed(0xFF12345679FFULL) == 0x1234567800ULL, "bit 40 up");
+    CHECK(uwb_ts_dly_reg(0x12345679FFULL) == 0x12345679U, "register");
+
+    for (int i = 0; i < RANDOM_RUNS; i++) {
+        at = rng();
+        exp = uwb_ts_from_hi32(uwb_ts_dly_reg(at)) & ~UWB_TX_DLY_MASK &
+              UWB_TS_MASK;
+        CHECK(uwb_ts_delayed(at) == exp, "delayed %016llx",
+              (unsigned long long)at);
+        CHECK((uwb_ts_delayed(at) & UWB_TX_DLY_MASK) == 0 &&
+                  (at & UWB_TS_MASK) - uwb_ts_delayed(at) <= UWB_TX_DLY_MASK,
+              "delayed range %016llx", (unsigned long long)at);
+    }
+
+    // the antenna delay is added after the truncation and wraps at 40 bits
+    CHECK(uwb_ts_delayed_tx_stamp(0x10000001FFULL, 16436) ==
+              0x1000000000ULL + 16436,
+          "tx stamp");
+    CHECK(uwb_ts_delayed_tx_stamp(UWB_TS_MASK - 100, 16436) ==
+              ((0xFFFFFFFE00ULL + 16436) & UWB_TS_MASK),
+          "tx stamp wrap %010llx",
+          (unsigned long long)uwb_ts_delayed_tx_stamp(UWB_TS_MASK - 100,
+                                                       16436));
+}
+
+/* ns per call, the loop and the sink included */
+#define TIME_OP(name, expr)                                                    \
+    do {                                                                       \
+        double t = now();                                                      \
+        for (uint32_t i = 0; i < TIMED_CALLS; i++) {                           \
+            uint64_t x = in[i & 1023];                                         \
+            sink += (uint64_t)(expr);                                          \
+        }                                                                      \
+        t = now() - t;                                                         \
+        printf("%-24s %6.2f ns\n", name, t * 1e9 / TIMED_CALLS);               \
+    } while (0)
+
+static void timings(void) {
+    static uint64_t in[1024];
+    static uint8_t bytes[1024 + UWB_TS_LEN];
+    volatile uint64_t result;
+    uint64_t sink = 0;
+
+    for (int i = 0; i < 1024; i++) {
+        in[i] = rng();
+        bytes[i] = (uint8_t)rng();
+    }
+
+    printf("%d calls each, inputs from a 1024 entry table\n", TIMED_CALLS);
+    TIME_OP("loop only", x);
+    TIME_OP("uwb_ts_from_bytes", uwb_ts_from_bytes(&bytes[x & 1023]));
+    TIME_OP("uwb_ts_to_bytes",
+            (uwb_ts_to_bytes(x, &bytes[x & 1023]), bytes[x & 1023]));
+    TIME_OP("uwb_ts_add", uwb_ts_add(x, (int64_t)sink));
+    TIME_OP("uwb_ts_diff", uwb_ts_diff(x, sink));
+    TIME_OP("uwb_ts_diff32", uwb_ts_diff32((uint32_t)x, (uint32_t)sink));
+    TIME_OP("uwb_dtu_to_ps", uwb_dtu_to_ps((int64_t)(x >> 24)));
+    TIME_OP("uwb_ps_to_dtu", uwb_ps_to_dtu((int64_t)(x >> 24)));
+    TIME_OP("uwb_dtu_to_mm", uwb_dtu_to_mm((int64_t)(x >> 24)));
+    TIME_OP("uwb_mm_to_dtu", uwb_mm_to_dtu((int32_t)x));
+    TIME_OP("uwb_ts_delayed", uwb_ts_delayed(x));
+    TIME_OP("uwb_ts_delayed_tx_stamp", uwb_ts_delayed_tx_stamp(x, 16436));
+    result = sink;
+    (void)result;
+}
+
+int main(int argc, char **argv) {
+    test_pack();
+    test_diff();
+    test_units();
+    test_delayed();
+    printf("%lu checks, %lu failed\n", checks, failures);
+
+    if (failures == 0 && !(argc > 1 && strcmp(argv[1], "-n") == 0)) {
+        timings();
+    }
+    return failures != 0;
+}